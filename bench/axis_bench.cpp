@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include "axis_bench.h"
+#include "bench.h"
+#include "fast_encoder_axis.h"
+#include "pins.h"
+
+#ifdef ENC_QUADRATURE
+static CEncoderAxis bench_runtime_axis(ENC_AZ, ENC_AZ_B, MOT_AZ_POS, MOT_AZ_NEG);
+static CFastEncoderAxis<ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG, ENC_AZ_B> bench_fast_axis;
+#else
+static CEncoderAxis bench_runtime_axis(ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG);
+static CFastEncoderAxis<ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG> bench_fast_axis;
+#endif
+
+// Handlers as attached with attachInterrupt(), called through a pointer
+static void INTERRUPT_FUNC runtime_enc_interrupt()
+{
+  bench_runtime_axis.enc_interrupt();
+}
+
+static void INTERRUPT_FUNC fast_enc_interrupt()
+{
+  bench_fast_axis.enc_interrupt();
+}
+
+static void (* volatile bench_runtime_isr)() = runtime_enc_interrupt;
+static void (* volatile bench_fast_isr)() = fast_enc_interrupt;
+
+void CAxisBench::run()
+{
+  bench_runtime_axis.begin();
+  bench_fast_axis.begin();
+
+  // An edge after the dead time takes the longest path, enc_reset() clears
+  // the dead time and costs the same in both
+  static const SBenchCase cases[] =
+  {
+    { "ISR edge, runtime pins", "", [](char* input, char* output) {
+        bench_runtime_axis.enc_reset();
+        bench_runtime_isr();
+        return true;
+      } },
+    { "ISR edge, fixed pins", "", [](char* input, char* output) {
+        bench_fast_axis.enc_reset();
+        bench_fast_isr();
+        return true;
+      } },
+    { "ISR bounce, runtime pins", "", [](char* input, char* output) {
+        bench_runtime_isr();
+        return true;
+      } },
+    { "ISR bounce, fixed pins", "", [](char* input, char* output) {
+        bench_fast_isr();
+        return true;
+      } },
+    { "relay on+off, runtime pin", "", [](char* input, char* output) {
+        digitalWrite(MOT_AZ_POS, HIGH);
+        digitalWrite(MOT_AZ_POS, LOW);
+        return true;
+      } },
+    { "relay on+off, fixed pin", "", [](char* input, char* output) {
+        CFastPin<MOT_AZ_POS>::write(HIGH);
+        CFastPin<MOT_AZ_POS>::write(LOW);
+        return true;
+      } },
+  };
+
+  CBench::print_header("Encoder axis");
+  CBench::run_cases(cases, sizeof(cases) / sizeof(cases[0]));
+}
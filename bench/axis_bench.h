@@ -0,0 +1,12 @@
+#pragma once
+
+// Benchmarks of the encoder interrupt handler and the relay writes, runtime
+// pins (CEncoderAxis) against compile time pins (CFastEncoderAxis)
+class CAxisBench
+{
+public:
+  static void run();
+
+private:
+  CAxisBench() {}
+};
@@ -0,0 +1,166 @@
+#include "bench.h"
+#include "string.h"
+
+#ifndef ARDUINO
+#include "sim_hal.h"
+#include <chrono>
+#endif
+
+#define BENCH_STACK_PATTERN 0xA5
+
+static uintptr_t stack_paint_area = 0;
+
+void CBench::begin()
+{
+  Serial.begin(115200);
+#ifndef ARDUINO
+  CSimHal::serial_set_echo(true);
+#endif
+}
+
+void CBench::print_header(const char* title)
+{
+  Serial.println();
+  Serial.println(title);
+  Serial.println("name                            ns/op     cycles/op  stack[B]  result");
+}
+
+void CBench::run_cases(const SBenchCase* cases, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    run_case(cases[i]);
+  }
+}
+
+void CBench::run_case(const SBenchCase& bench_case)
+{
+  static char output[BENCH_OUTPUT_SIZE];
+
+  capture_output(true);
+  // Measure the per-iteration input copy separately and subtract it
+  uint32_t baseline = time_iterations(bench_case, false);
+  uint32_t elapsed = time_iterations(bench_case, true);
+  size_t stack = measure_stack(bench_case, output);
+
+  char input[BENCH_INPUT_SIZE];
+  strncpy(input, bench_case.input, sizeof(input) - 1);
+  input[sizeof(input) - 1] = '\0';
+  bool ok = bench_case.run(input, output);
+  capture_output(false);
+
+  // Fixed point with one decimal so no float printf support is needed
+  uint32_t ns10 = static_cast<uint32_t>(ticks_to_ns(elapsed > baseline ? elapsed - baseline : 0) * 10.0f / BENCH_ITERATIONS);
+  char line[96];
+  snprintf(line, sizeof(line), "%-28s %8lu.%lu ",
+    bench_case.name, static_cast<unsigned long>(ns10 / 10), static_cast<unsigned long>(ns10 % 10));
+  Serial.print(line);
+
+#ifdef F_CPU
+  uint32_t cycles10 = static_cast<uint32_t>(ns10 * (F_CPU / 1000000L) / 1000L);
+  snprintf(line, sizeof(line), "%9lu.%lu ",
+    static_cast<unsigned long>(cycles10 / 10), static_cast<unsigned long>(cycles10 % 10));
+#else
+  snprintf(line, sizeof(line), "%11s ", "-");
+#endif
+  Serial.print(line);
+
+  snprintf(line, sizeof(line), "%9lu  ", static_cast<unsigned long>(stack));
+  Serial.print(line);
+  Serial.println(ok ? "ok" : "FAIL");
+}
+
+uint32_t CBench::time_iterations(const SBenchCase& bench_case, bool include_run)
+{
+  static char input[BENCH_INPUT_SIZE];
+  static char output[BENCH_OUTPUT_SIZE];
+
+  uint32_t start = now();
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+  {
+    strncpy(input, bench_case.input, sizeof(input) - 1);
+    if (include_run)
+    {
+      bench_case.run(input, output);
+    }
+    // Keep the copy from being optimized out of the baseline loop
+    __asm__ __volatile__("" : : "r"(input) : "memory");
+  }
+  return now() - start;
+}
+
+// Fill the stack area below the caller with a pattern. The measured function
+// is then called from the same frame, so the deepest overwritten byte shows
+// its stack usage.
+static void __attribute__((noinline)) paint_stack()
+{
+  volatile uint8_t area[BENCH_STACK_PAINT_SIZE];
+  for (size_t i = 0; i < sizeof(area); i++)
+  {
+    area[i] = BENCH_STACK_PATTERN;
+  }
+  stack_paint_area = reinterpret_cast<uintptr_t>(area);
+}
+
+static size_t __attribute__((noinline)) scan_stack()
+{
+  volatile uint8_t* area = reinterpret_cast<volatile uint8_t*>(stack_paint_area);
+  size_t untouched = 0;
+  while (untouched < BENCH_STACK_PAINT_SIZE && area[untouched] == BENCH_STACK_PATTERN)
+  {
+    untouched++;
+  }
+  return BENCH_STACK_PAINT_SIZE - untouched;
+}
+
+size_t CBench::measure_stack(const SBenchCase& bench_case, char* output)
+{
+  static char input[BENCH_INPUT_SIZE];
+  strncpy(input, bench_case.input, sizeof(input) - 1);
+
+  paint_stack();
+  bench_case.run(input, output);
+  return scan_stack();
+}
+
+void CBench::capture_output(bool capture)
+{
+#ifndef ARDUINO
+  // Drop what the code under test prints, keep the report on stdout
+  CSimHal::serial_set_echo(!capture);
+  CSimHal::serial_take_output();
+#endif
+}
+
+#if defined(ARDUINO_ARCH_ESP8266)
+uint32_t CBench::now()
+{
+  return ESP.getCycleCount();
+}
+
+float CBench::ticks_to_ns(uint32_t ticks)
+{
+  return ticks * (1000.0f / (F_CPU / 1000000L));
+}
+#elif defined(ARDUINO)
+uint32_t CBench::now()
+{
+  return micros();
+}
+
+float CBench::ticks_to_ns(uint32_t ticks)
+{
+  return ticks * 1000.0f;
+}
+#else
+uint32_t CBench::now()
+{
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+float CBench::ticks_to_ns(uint32_t ticks)
+{
+  return static_cast<float>(ticks);
+}
+#endif
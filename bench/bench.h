@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Timing and stack measurement helpers shared by the benchmarks. On target the
+// clock is micros() (AVR) or the CPU cycle counter (ESP8266), on the host
+// build it is the monotonic system clock.
+
+#if defined(ARDUINO_ARCH_AVR)
+#define BENCH_ITERATIONS 200
+#define BENCH_STACK_PAINT_SIZE 256
+#elif defined(ARDUINO)
+#define BENCH_ITERATIONS 2000
+#define BENCH_STACK_PAINT_SIZE 1024
+#else
+#define BENCH_ITERATIONS 200000
+#define BENCH_STACK_PAINT_SIZE 8192
+#endif
+
+#define BENCH_INPUT_SIZE 128
+#define BENCH_OUTPUT_SIZE 128
+
+struct SBenchCase
+{
+  const char* name;
+  const char* input;
+  // Returns whether the operation succeeded; input is a scratch copy that
+  // may be modified
+  bool (*run)(char* input, char* output);
+};
+
+class CBench
+{
+public:
+  static void begin();
+  static void print_header(const char* title);
+  static void run_cases(const SBenchCase* cases, size_t count);
+  static void run_case(const SBenchCase& bench_case);
+
+private:
+  CBench() {}
+  static uint32_t now();
+  static float ticks_to_ns(uint32_t ticks);
+  static uint32_t time_iterations(const SBenchCase& bench_case, bool include_run);
+  static size_t measure_stack(const SBenchCase& bench_case, char* output);
+  static void capture_output(bool capture);
+};
@@ -0,0 +1,28 @@
+// Benchmark firmware: runs all benchmark suites once at startup and prints
+// the results over serial. The host build runs them from main().
+
+#include <Arduino.h>
+#include "axis_bench.h"
+#include "bench.h"
+#include "easycomm_bench.h"
+#include "sgp4_bench.h"
+
+void setup()
+{
+  CBench::begin();
+  CEasyCommBench::run();
+  CSgp4Bench::run();
+  CAxisBench::run();
+}
+
+void loop()
+{
+}
+
+#ifndef ARDUINO
+int main()
+{
+  setup();
+  return 0;
+}
+#endif
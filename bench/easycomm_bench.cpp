@@ -0,0 +1,165 @@
+#include <Arduino.h>
+#include "easycomm_bench.h"
+#include "bench.h"
+#include "decimal_codec.h"
+#include "easycomm_handler.h"
+#include "pins.h"
+
+static CEncoderAxis   bench_azimuth_axis(ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG);
+static CEncoderAxis bench_elevation_axis(ENC_EL, MOT_EL_POS, MOT_EL_NEG);
+
+void CEasyCommBench::run()
+{
+  bench_azimuth_axis.begin();
+  bench_elevation_axis.begin();
+  bench_azimuth_axis.set_current_position(1234);
+  bench_elevation_axis.set_current_position(456);
+  CEasyCommHandler::begin(bench_azimuth_axis, bench_elevation_axis);
+
+  static const SBenchCase format_cases[] =
+  {
+    { "sscanf %*s %f %f", "P 123.4 45.6\n", [](char* input, char* output) {
+        float az = 0.0;
+        float el = 0.0;
+        return sscanf(input, "%*s %f %f", &az, &el) == 2;
+      } },
+    { "snprintf %.1f %.1f", "", [](char* input, char* output) {
+        return snprintf(output, RESP_BUF_SIZE, "%.1f\n%.1f\n", 1234/10.0, 456/10.0) > 0;
+      } },
+    { "CDecimalCodec::parse 123.4", "123.4", [](char* input, char* output) {
+        int32_t number = 0;
+        return CDecimalCodec::parse(input, 1, number) == CDecimalCodec::EResultOk;
+      } },
+    { "CDecimalCodec::format 1234", "", [](char* input, char* output) {
+        return CDecimalCodec::format(1234, 1, output, RESP_BUF_SIZE) > 0;
+      } },
+    // Cases from tests/test_number_parse.c
+    { "string_to_number -238.0", "-238.0", [](char* input, char* output) {
+        int32_t number = 0;
+        return CEasyCommHandler::string_to_number(input, number) && number == -2380;
+      } },
+    { "CDecimalCodec::format -35000", "", [](char* input, char* output) {
+        return CDecimalCodec::format(-35000, 1, output, RESP_BUF_SIZE) > 0 && strcmp(output, "-3500.0") == 0;
+      } },
+    { "handle_get_pos_command", "p\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_get_pos_command(input, output);
+        return true;
+      } },
+    // As every poll was before the position text was kept between polls
+    { "get_pos_command, uncached", "p\n", [](char* input, char* output) {
+        CEasyCommHandler::mAzimuthText.valid = false;
+        CEasyCommHandler::mElevationText.valid = false;
+        CEasyCommHandler::handle_get_pos_command(input, output);
+        return true;
+      } },
+    { "handle_set_pos_command", "P 123.4 45.6\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_set_pos_command(input, output);
+        return true;
+      } },
+  };
+
+  static const SBenchCase dispatch_cases[] =
+  {
+    { "handle_command p", "p\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_command(input, output);
+        return output[0] != '\0';
+      } },
+    { "handle_command P", "P 123.4 45.6\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_command(input, output);
+        return output[0] != '\0';
+      } },
+    { "handle_command AZ", "AZ\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_command(input, output);
+        return output[0] != '\0';
+      } },
+    { "handle_command AZ123.4", "AZ123.4\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_command(input, output);
+        return true;
+      } },
+    { "handle_command EL", "EL\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_command(input, output);
+        return output[0] != '\0';
+      } },
+    { "handle_command VE", "VE\n", [](char* input, char* output) {
+        CEasyCommHandler::handle_command(input, output);
+        return output[0] != '\0';
+      } },
+    // One line with several commands, responses appended as for a session
+    { "handle_next_command AZ EL GS", "AZ EL GS\n", [](char* input, char* output) {
+        char* it = input;
+        size_t len = 0;
+        while (CEasyCommHandler::handle_next_command(it, &(output[len])))
+          len += strlen(&(output[len]));
+        return len > 0;
+      } },
+  };
+
+  // The if-chain handle_command() had before the command table, as reference
+  static CEasyCommHandler::command_handler_t (*const find_if_chain)(const char*) =
+    [](const char* command) -> CEasyCommHandler::command_handler_t {
+      if (command[0] == 'p' || (command[0] == '\\' && command[1] == 'g'))
+        return CEasyCommHandler::handle_get_pos_command;
+      else if (command[0] == 'P' || (command[0] == '\\' && command[1] == 's'))
+        return CEasyCommHandler::handle_set_pos_command;
+      else if (command[0] == 'A' && command[1] == 'Z')
+        return CEasyCommHandler::handle_az_command;
+      else if (command[0] == 'E' && command[1] == 'L')
+        return CEasyCommHandler::handle_el_command;
+      else if (command[0] == 'G' && command[1] == 'S')
+        return CEasyCommHandler::handle_get_status_command;
+      else if (command[0] == 'G' && command[1] == 'C')
+        return CEasyCommHandler::handle_get_coast_command;
+      else if (command[0] == 'G' && command[1] == 'T')
+        return CEasyCommHandler::handle_get_tasks_command;
+      else if (command[0] == 'G' && command[1] == 'L')
+        return CEasyCommHandler::handle_get_log_command;
+      else if (command[0] == 'G' && command[1] == 'P')
+        return CEasyCommHandler::handle_get_perf_command;
+      else if (command[0] == 'D' && command[1] == 'T')
+        return CEasyCommHandler::handle_dump_trace_command;
+      else if (command[0] == 'T')
+        return CEasyCommHandler::handle_trajectory_command;
+      else if (command[0] == 'O')
+        return CEasyCommHandler::handle_orbit_command;
+      else if (command[0] == 'V' && command[1] == 'E')
+        return CEasyCommHandler::handle_version_command;
+      else if (command[0] == 'M')
+        return CEasyCommHandler::handle_move_command;
+      else if (command[0] == 'S')
+        return CEasyCommHandler::handle_stop_command;
+      return NULL;
+    };
+
+  // First, middle and last command of the if-chain
+  static const SBenchCase lookup_cases[] =
+  {
+    { "if-chain lookup p", "p\n", [](char* input, char* output) {
+        return find_if_chain(input) != NULL;
+      } },
+    { "table lookup p", "p\n", [](char* input, char* output) {
+        uint8_t flags = 0;
+        return CEasyCommHandler::find_command(input, flags) != NULL;
+      } },
+    { "if-chain lookup GP", "GP\n", [](char* input, char* output) {
+        return find_if_chain(input) != NULL;
+      } },
+    { "table lookup GP", "GP\n", [](char* input, char* output) {
+        uint8_t flags = 0;
+        return CEasyCommHandler::find_command(input, flags) != NULL;
+      } },
+    { "if-chain lookup SA", "SA\n", [](char* input, char* output) {
+        return find_if_chain(input) != NULL;
+      } },
+    { "table lookup SA", "SA\n", [](char* input, char* output) {
+        uint8_t flags = 0;
+        return CEasyCommHandler::find_command(input, flags) != NULL;
+      } },
+  };
+
+  CBench::print_header("EasyComm parse/format");
+  CBench::run_cases(format_cases, sizeof(format_cases) / sizeof(format_cases[0]));
+  CBench::print_header("EasyComm dispatch");
+  CBench::run_cases(dispatch_cases, sizeof(dispatch_cases) / sizeof(dispatch_cases[0]));
+  CBench::print_header("EasyComm command lookup");
+  CBench::run_cases(lookup_cases, sizeof(lookup_cases) / sizeof(lookup_cases[0]));
+}
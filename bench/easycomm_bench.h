@@ -0,0 +1,11 @@
+#pragma once
+
+// Benchmarks of the EasyComm parse/format hot path
+class CEasyCommBench
+{
+public:
+  static void run();
+
+private:
+  CEasyCommBench() {}
+};
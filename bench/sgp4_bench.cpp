@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include "sgp4_bench.h"
+#include "bench.h"
+#include "observer.h"
+#include "sgp4.h"
+#include "tle.h"
+
+// Spacetrack Report #3 test satellite
+static const char* BENCH_TLE_LINE1 = "1 88888U          80275.98708465  .00073094  13844-3  66816-4 0    87";
+static const char* BENCH_TLE_LINE2 = "2 88888  72.8435 115.9689 0086731  52.6988 110.5714 16.05824518  1058";
+
+static STleElements bench_elements;
+static CSgp4<float> bench_model;
+static CObserver<float> bench_observer;
+static float bench_tsince = 0.0f;
+
+void CSgp4Bench::run()
+{
+  uint32_t catalog = 0;
+  CTle::parse_line1(BENCH_TLE_LINE1, bench_elements, catalog);
+  CTle::parse_line2(BENCH_TLE_LINE2, bench_elements, catalog);
+  bench_model.init(bench_elements);
+  bench_observer.set(0.9076f, 0.0873f, 0.01f);
+
+  static const SBenchCase cases[] =
+  {
+    { "CTle::parse_line1", BENCH_TLE_LINE1, [](char* input, char* output) {
+        STleElements elements;
+        uint32_t catalog = 0;
+        return CTle::parse_line1(input, elements, catalog);
+      } },
+    { "CTle::parse_line2", BENCH_TLE_LINE2, [](char* input, char* output) {
+        STleElements elements;
+        uint32_t catalog = 0;
+        return CTle::parse_line2(input, elements, catalog);
+      } },
+    { "CSgp4<float>::init", "", [](char* input, char* output) {
+        CSgp4<float> model;
+        return model.init(bench_elements);
+      } },
+    // A different time every step, as when tracking
+    { "CSgp4<float>::propagate", "", [](char* input, char* output) {
+        float position[3];
+        float velocity[3];
+        bench_tsince += 0.5f;
+        if (bench_tsince > 1440.0f)
+          bench_tsince = 0.0f;
+        return bench_model.propagate(bench_tsince, position, velocity);
+      } },
+    { "CObserver::look_angles", "", [](char* input, char* output) {
+        float position[3] = { 2328.97f, -5995.22f, 1719.97f };
+        float az = 0.0f;
+        float el = 0.0f;
+        float range = 0.0f;
+        bench_observer.look_angles(position, bench_elements.epoch_time, 0, az, el, range);
+        return range > 0.0f;
+      } },
+  };
+
+  CBench::print_header("SGP4 tracking");
+  CBench::run_cases(cases, sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Benchmarks of the on-device orbit propagation, one tracking step is a
+// propagation plus the look angles
+class CSgp4Bench
+{
+public:
+  static void run();
+
+private:
+  CSgp4Bench() {}
+};
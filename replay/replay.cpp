@@ -0,0 +1,459 @@
+#include "replay.h"
+#include "easycomm_handler.h"
+#include "encoder_axis.h"
+#include "motion_trace.h"
+#include "pins.h"
+#include "sat_tracker.h"
+#include "sim_hal.h"
+#include "trajectory.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+// Task periods of rotator.cpp
+#define REPLAY_CONTROL_PERIOD 1000   // us
+#define REPLAY_TRACKING_PERIOD 50000 // us
+
+CEncoderAxis   azimuth_axis(ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG);
+CEncoderAxis elevation_axis(ENC_EL, MOT_EL_POS, MOT_EL_NEG);
+
+static CEncoderAxis* const axes[2] = { &azimuth_axis, &elevation_axis };
+static const uint8_t relay_pins[2][2] = { { MOT_AZ_POS, MOT_AZ_NEG }, { MOT_EL_POS, MOT_EL_NEG } };
+static const char* const axis_names[2] = { "az", "el" };
+
+std::vector<CReplay::SEvent> CReplay::mEvents;
+std::vector<CReplay::SEvent> CReplay::mRecordedMotor;
+std::vector<CReplay::SEvent> CReplay::mReplayedMotor;
+std::string CReplay::mLog;
+uint8_t CReplay::mRelays[2];
+uint32_t CReplay::mTransitions[2];
+CReplay::SRuntime CReplay::mControlRuntime;
+CReplay::SRuntime CReplay::mCommandRuntime;
+
+static uint64_t start_time = 0; // us, virtual time of script time 0
+static CEncoderAxis::SSnapshot snapshots[2];
+static CEncoderAxis::EMotorState motor_states[2];
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool parse_axis(const char* name, uint8_t& axis)
+{
+  for (axis = 0; axis < 2; axis++)
+  {
+    if (strcmp(name, axis_names[axis]) == 0)
+      return true;
+  }
+  return false;
+}
+
+static int32_t degrees_to_position(double degrees)
+{
+  return static_cast<int32_t>(lround(degrees * 10.0));
+}
+
+bool CReplay::parse_script_line(const char* line)
+{
+  char event[16];
+  char axis_name[8];
+  double time_ms = 0.0;
+  int offset = 0;
+  if (sscanf(line, "%lf %15s %n", &time_ms, event, &offset) < 2)
+    return false;
+
+  SEvent e;
+  e.time = static_cast<uint64_t>(llround(time_ms * 1000.0));
+  e.axis = 0;
+  e.value = 0;
+  const char* args = &(line[offset]);
+
+  if (strcmp(event, "cmd") == 0)
+  {
+    e.type = EEventCommand;
+    e.command = std::string(args, strcspn(args, "\r\n")) + "\n";
+  }
+  else if (strcmp(event, "pos") == 0)
+  {
+    double degrees = 0.0;
+    if (sscanf(args, "%7s %lf", axis_name, &degrees) != 2 || !parse_axis(axis_name, e.axis))
+      return false;
+    e.type = EEventPosition;
+    e.value = degrees_to_position(degrees);
+  }
+  else if (strcmp(event, "edge") == 0)
+  {
+    if (sscanf(args, "%7s", axis_name) != 1 || !parse_axis(axis_name, e.axis))
+      return false;
+    e.type = EEventEdge;
+  }
+  else if (strcmp(event, "edges") == 0)
+  {
+    long count = 0;
+    double interval_ms = 0.0;
+    if (sscanf(args, "%7s %ld %lf", axis_name, &count, &interval_ms) != 3 || !parse_axis(axis_name, e.axis))
+      return false;
+    e.type = EEventEdge;
+    for (long i = 0; i < count; i++)
+    {
+      mEvents.push_back(e);
+      e.time += static_cast<uint64_t>(llround(interval_ms * 1000.0));
+    }
+    return true;
+  }
+  else if (strcmp(event, "end") == 0)
+  {
+    e.type = EEventEnd;
+  }
+  else
+  {
+    return false;
+  }
+  mEvents.push_back(e);
+  return true;
+}
+
+// sequence,time_us,axis,event,value as written by tools/trace_decode.py
+bool CReplay::parse_csv_line(const char* line)
+{
+  static const char* const motor_states[] = { "stopped", "running_pos", "stopping_pos", "running_neg", "stopping_neg" };
+  static bool has_position[2] = { false, false };
+
+  unsigned long sequence = 0;
+  long long time_us = 0;
+  char axis_name[8] = "";
+  char event[16] = "";
+  char value[16] = "";
+  if (sscanf(line, "%lu,%lld,%7[^,],%15[^,],%15[^\r\n]", &sequence, &time_us, axis_name, event, value) < 4)
+  {
+    // Commands have no axis and only their first characters, they are left out
+    return sscanf(line, "%lu,%lld,,%15[^,]", &sequence, &time_us, event) == 3;
+  }
+
+  SEvent e;
+  e.time = time_us;
+  e.value = 0;
+  if (!parse_axis(axis_name, e.axis))
+    return false;
+
+  if (strncmp(event, "edge", 4) == 0)
+  {
+    // Unless it homes first, start from the recorded position one edge before
+    // the first one
+    if (!has_position[e.axis])
+    {
+      SEvent position = e;
+      position.time = 0;
+      position.type = EEventPosition;
+      position.value = degrees_to_position(atof(value)) - (event[4] == '+' ? 1 : event[4] == '-' ? -1 : 0);
+      mEvents.insert(mEvents.begin(), position);
+      has_position[e.axis] = true;
+    }
+    e.type = EEventEdge;
+    mEvents.push_back(e);
+  }
+  else if (strcmp(event, "homing") == 0)
+  {
+    has_position[e.axis] = true;
+    e.type = EEventHoming;
+    mEvents.push_back(e);
+  }
+  else if (strcmp(event, "setpoint") == 0)
+  {
+    e.type = EEventSetpoint;
+    e.value = degrees_to_position(atof(value));
+    mEvents.push_back(e);
+  }
+  else
+  {
+    for (int32_t state = 0; state < 5; state++)
+    {
+      if (strcmp(event, motor_states[state]) == 0)
+      {
+        e.type = EEventMotor;
+        e.value = state;
+        mRecordedMotor.push_back(e);
+      }
+    }
+  }
+  return true;
+}
+
+bool CReplay::load(FILE* file)
+{
+  char line[256];
+  bool csv = false;
+  unsigned long line_number = 0;
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    line_number++;
+    if (line_number == 1 && strncmp(line, "sequence,", 9) == 0)
+    {
+      csv = true;
+      continue;
+    }
+    const char* it = line;
+    while (*it == ' ' || *it == '\t')
+      it++;
+    if (*it == '#' || *it == '\n' || *it == '\r' || *it == '\0')
+      continue;
+
+    if (!(csv ? parse_csv_line(it) : parse_script_line(it)))
+    {
+      fprintf(stderr, "line %lu: can't parse: %s", line_number, line);
+      return false;
+    }
+  }
+
+  // Traced edges carry their interrupt time and may come after younger records
+  if (csv)
+  {
+    std::stable_sort(mEvents.begin(), mEvents.end(),
+      [](const SEvent& a, const SEvent& b) { return a.time < b.time; });
+  }
+  for (size_t i = 1; i < mEvents.size(); i++)
+  {
+    if (mEvents[i].time < mEvents[i - 1].time)
+    {
+      fprintf(stderr, "events are not in time order at %.3f ms\n", mEvents[i].time / 1000.0);
+      return false;
+    }
+  }
+  return true;
+}
+
+void CReplay::add_runtime(SRuntime& runtime, double ns)
+{
+  runtime.count++;
+  runtime.total += ns;
+  if (ns > runtime.max)
+    runtime.max = ns;
+}
+
+void CReplay::check_relays()
+{
+  char line[64];
+  for (uint8_t axis = 0; axis < 2; axis++)
+  {
+    uint8_t relays = CSimHal::get_output(relay_pins[axis][0]) | (CSimHal::get_output(relay_pins[axis][1]) << 1);
+    if (relays != mRelays[axis])
+    {
+      snprintf(line, sizeof(line), "relay %10.3f ms %s %s\n", (CSimHal::time_us() - start_time) / 1000.0, axis_names[axis],
+        relays == 0 ? "off" : relays == 1 ? "pos" : relays == 2 ? "neg" : "both");
+      mLog += line;
+      mRelays[axis] = relays;
+      mTransitions[axis]++;
+    }
+  }
+}
+
+// Same as control_task() in rotator.cpp
+void CReplay::control()
+{
+  auto start = std::chrono::steady_clock::now();
+  azimuth_axis.update();
+  elevation_axis.update();
+  azimuth_axis.get_snapshot(snapshots[0]);
+  elevation_axis.get_snapshot(snapshots[1]);
+  CEasyCommHandler::update(snapshots[0], snapshots[1]);
+  add_runtime(mControlRuntime, elapsed_ns(start));
+
+  for (uint8_t axis = 0; axis < 2; axis++)
+  {
+    if (snapshots[axis].motor_state != motor_states[axis])
+    {
+      SEvent e;
+      e.time = CSimHal::time_us() - start_time;
+      e.type = EEventMotor;
+      e.axis = axis;
+      e.value = snapshots[axis].motor_state;
+      mReplayedMotor.push_back(e);
+      motor_states[axis] = snapshots[axis].motor_state;
+    }
+  }
+  check_relays();
+}
+
+void CReplay::apply(const SEvent& event)
+{
+  char line[192];
+  switch (event.type)
+  {
+    case EEventPosition:
+      axes[event.axis]->set_current_position(event.value);
+      axes[event.axis]->move_to_position(event.value);
+      break;
+    case EEventSetpoint:
+      axes[event.axis]->move_to_position(event.value);
+      break;
+    case EEventHoming:
+      axes[event.axis]->start_homing();
+      break;
+    case EEventEdge:
+      axes[event.axis]->enc_interrupt();
+      break;
+    case EEventCommand:
+    {
+      char command[COMM_BUF_SIZE];
+      char response[RESP_BUF_SIZE];
+      strncpy(command, event.command.c_str(), sizeof(command) - 1);
+      command[sizeof(command) - 1] = '\0';
+
+      auto start = std::chrono::steady_clock::now();
+      CEasyCommHandler::handle_command(command, response);
+      add_runtime(mCommandRuntime, elapsed_ns(start));
+
+      // One line per command, response lines separated by |
+      std::string text = response;
+      while (!text.empty() && text[text.size() - 1] == '\n')
+        text.erase(text.size() - 1);
+      for (size_t i = 0; i < text.size(); i++)
+      {
+        if (text[i] == '\n')
+          text[i] = '|';
+      }
+      snprintf(line, sizeof(line), "cmd   %10.3f ms %.*s -> %s\n", (CSimHal::time_us() - start_time) / 1000.0,
+        static_cast<int>(event.command.size() - 1), event.command.c_str(), text.c_str());
+      mLog += line;
+      break;
+    }
+    case EEventMotor:
+    case EEventEnd:
+      break;
+  }
+  check_relays();
+}
+
+void CReplay::run(uint32_t settle_ms)
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  CEasyCommHandler::begin(azimuth_axis, elevation_axis);
+  CTrajectory::begin(azimuth_axis, elevation_axis);
+#ifdef USE_MOTION_TRACE
+  CMotionTrace::begin(azimuth_axis, elevation_axis);
+#endif
+  for (uint8_t axis = 0; axis < 2; axis++)
+  {
+    mRelays[axis] = 0;
+    mTransitions[axis] = 0;
+    motor_states[axis] = CEncoderAxis::EMotorStateStopped;
+  }
+
+  // Edges of the first moment must not fall in the dead time of the start
+  uint64_t base = CSimHal::time_us() + REPLAY_CONTROL_PERIOD;
+  CSimHal::advance_us(REPLAY_CONTROL_PERIOD);
+  start_time = base;
+  uint64_t next_control = base;
+  uint64_t next_tracking = base;
+  uint64_t end = (mEvents.empty() ? base : base + mEvents.back().time) + settle_ms * 1000ULL;
+
+  size_t next_event = 0;
+  while (true)
+  {
+    bool has_event = next_event < mEvents.size();
+    uint64_t event_time = has_event ? base + mEvents[next_event].time : end;
+    uint64_t next = has_event && event_time < next_control ? event_time : next_control;
+    if (next > end)
+      break;
+    if (next > CSimHal::time_us())
+      CSimHal::advance_us(static_cast<uint32_t>(next - CSimHal::time_us()));
+
+    // Edges of a moment come before the control step of the same moment, like
+    // an interrupt that fires just before the task runs. Commands come after
+    // it, the comms task has a lower priority.
+    if (has_event && next == event_time &&
+        (event_time < next_control || mEvents[next_event].type == EEventEdge))
+    {
+      apply(mEvents[next_event]);
+      next_event++;
+      continue;
+    }
+
+    control();
+    if (next_control >= next_tracking)
+    {
+      CSatTracker::update();
+      CTrajectory::update();
+      next_tracking += REPLAY_TRACKING_PERIOD;
+    }
+    next_control += REPLAY_CONTROL_PERIOD;
+  }
+}
+
+#ifdef USE_MOTION_TRACE
+// Same format as the DT responses, for tools/trace_decode.py
+void CReplay::write_trace(FILE* file)
+{
+  uint32_t sequence = 0;
+  char records[2 * 8 * TRACE_DUMP_RECORDS + 1];
+  while (CMotionTrace::dump(sequence, TRACE_DUMP_RECORDS, records, sizeof(records)) > 0)
+  {
+    fprintf(file, "DT%lu %s\n", static_cast<unsigned long>(sequence), records);
+    sequence += strlen(records) / 16;
+  }
+}
+#endif
+
+void CReplay::report(std::string& output)
+{
+  char line[128];
+  output = mLog;
+  for (uint8_t axis = 0; axis < 2; axis++)
+  {
+    int32_t position = axes[axis]->get_current_position();
+    int32_t setpoint = axes[axis]->get_position_setpoint();
+    snprintf(line, sizeof(line), "final %s position %.1f setpoint %.1f error %.1f relay transitions %lu\n",
+      axis_names[axis], position / 10.0, setpoint / 10.0, (position - setpoint) / 10.0,
+      static_cast<unsigned long>(mTransitions[axis]));
+    output += line;
+  }
+}
+
+void CReplay::report_metrics(FILE* file)
+{
+  fprintf(file, "timing control  %lu runs, mean %.0f ns, max %.0f ns\n",
+    static_cast<unsigned long>(mControlRuntime.count),
+    mControlRuntime.count > 0 ? mControlRuntime.total / mControlRuntime.count : 0.0, mControlRuntime.max);
+  fprintf(file, "timing command  %lu runs, mean %.0f ns, max %.0f ns\n",
+    static_cast<unsigned long>(mCommandRuntime.count),
+    mCommandRuntime.count > 0 ? mCommandRuntime.total / mCommandRuntime.count : 0.0, mCommandRuntime.max);
+
+  if (mRecordedMotor.empty())
+    return;
+
+  // Motor state changes of the recording against the replay, in order per axis
+  for (uint8_t axis = 0; axis < 2; axis++)
+  {
+    std::vector<const SEvent*> recorded;
+    std::vector<const SEvent*> replayed;
+    for (size_t i = 0; i < mRecordedMotor.size(); i++)
+    {
+      if (mRecordedMotor[i].axis == axis)
+        recorded.push_back(&mRecordedMotor[i]);
+    }
+    for (size_t i = 0; i < mReplayedMotor.size(); i++)
+    {
+      if (mReplayedMotor[i].axis == axis)
+        replayed.push_back(&mReplayedMotor[i]);
+    }
+
+    size_t matching = 0;
+    double total_shift = 0.0;
+    double max_shift = 0.0;
+    while (matching < recorded.size() && matching < replayed.size() &&
+           recorded[matching]->value == replayed[matching]->value)
+    {
+      double shift = fabs(static_cast<double>(replayed[matching]->time) - static_cast<double>(recorded[matching]->time));
+      total_shift += shift;
+      if (shift > max_shift)
+        max_shift = shift;
+      matching++;
+    }
+    fprintf(file, "motor %s recorded %lu, replayed %lu, first %lu match, shift mean %.0f us, max %.0f us\n",
+      axis_names[axis], static_cast<unsigned long>(recorded.size()), static_cast<unsigned long>(replayed.size()),
+      static_cast<unsigned long>(matching), matching > 0 ? total_shift / matching : 0.0, max_shift);
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Replays encoder edges and commands through the axes and the EasyComm handler
+// on the virtual clock of the native HAL, without the motor model: edges come
+// from the script, so recorded field data gives the same input the firmware
+// saw. The control, tracking and command paths run as in rotator.cpp.
+//
+// Script lines are "<time in ms> <event> [arguments]", in time order:
+//   pos az|el <deg>                        set the position, skips homing
+//   cmd <command>                          handle an EasyComm command
+//   edge az|el                             one encoder edge
+//   edges az|el <count> <interval in ms>   a series of edges
+//   end                                    keep running until this time
+// A CSV from tools/trace_decode.py can be replayed as well: its edges,
+// setpoints and homing starts are fed, its motor state changes are compared to
+// the replayed ones. The trace should start before the first move in it.
+class CReplay
+{
+public:
+  static bool load(FILE* file);
+  static void run(uint32_t settle_ms);
+
+  // Deterministic part: relay timeline, command responses and final state
+  static void report(std::string& output);
+
+  // Wall clock runtime of the control and command paths, and the comparison
+  // with a recorded trace
+  static void report_metrics(FILE* file);
+
+#ifdef USE_MOTION_TRACE
+  // Motion trace of the replay, to compare with the recorded one
+  static void write_trace(FILE* file);
+#endif
+
+private:
+  enum EEventType
+  {
+    EEventPosition,
+    EEventCommand,
+    EEventEdge,
+    EEventSetpoint,
+    EEventHoming,
+    EEventMotor,
+    EEventEnd,
+  };
+
+  struct SEvent
+  {
+    uint64_t time; // us
+    EEventType type;
+    uint8_t axis;  // 0 azimuth, 1 elevation
+    int32_t value; // 1e-1 deg, or motor state
+    std::string command;
+  };
+
+  struct SRuntime
+  {
+    uint32_t count;
+    double total; // ns
+    double max;   // ns
+  };
+
+  CReplay() {}
+  static bool parse_script_line(const char* line);
+  static bool parse_csv_line(const char* line);
+  static void control();
+  static void apply(const SEvent& event);
+  static void check_relays();
+  static void add_runtime(SRuntime& runtime, double ns);
+
+  static std::vector<SEvent> mEvents;
+  static std::vector<SEvent> mRecordedMotor;
+  static std::vector<SEvent> mReplayedMotor;
+  static std::string mLog;
+  static uint8_t mRelays[2];
+  static uint32_t mTransitions[2];
+  static SRuntime mControlRuntime;
+  static SRuntime mCommandRuntime;
+};
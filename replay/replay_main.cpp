@@ -0,0 +1,121 @@
+// Replay of encoder edges and commands through the control code on a virtual
+// clock, see replay.h for the script format. Prints the relay timeline, the
+// command responses and the final state, followed by timing metrics.
+//
+// Usage: replay [-s settle_ms] [-e expected] [-t trace] [-q] script
+//   -e  compare the output, without the metrics, to a file; exits with 1 on a
+//       difference. Used for the regression cases in tests/replay/.
+//   -t  write the motion trace of the replay, as DT responses
+//   -q  only print the metrics
+
+#include "replay.h"
+#include "log.h"
+#include <unistd.h>
+
+static bool log_sink(const char* line, size_t len)
+{
+  fwrite(line, 1, len, stderr);
+  return true;
+}
+
+static bool compare(const std::string& output, const char* path)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  std::string expected;
+  char buffer[256];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    expected.append(buffer, n);
+  fclose(file);
+
+  if (output == expected)
+    return true;
+
+  // Report the first line that differs
+  size_t line_start = 0;
+  size_t i = 0;
+  while (i < output.size() && i < expected.size() && output[i] == expected[i])
+  {
+    if (output[i] == '\n')
+      line_start = i + 1;
+    i++;
+  }
+  fprintf(stderr, "%s: differs\n  expected: %s\n  got:      %s\n", path,
+    expected.substr(line_start, expected.find('\n', line_start) - line_start).c_str(),
+    output.substr(line_start, output.find('\n', line_start) - line_start).c_str());
+  return false;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t settle_ms = 2000;
+  const char* expected_path = NULL;
+  const char* trace_path = NULL;
+  bool quiet = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:e:t:q")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': settle_ms = atol(optarg); break;
+      case 'e': expected_path = optarg; break;
+      case 't': trace_path = optarg; break;
+      case 'q': quiet = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-s settle_ms] [-e expected] [-t trace] [-q] script\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    fprintf(stderr, "usage: %s [-s settle_ms] [-e expected] [-t trace] [-q] script\n", argv[0]);
+    return 2;
+  }
+
+  FILE* file = fopen(argv[optind], "r");
+  if (file == NULL)
+  {
+    perror(argv[optind]);
+    return 2;
+  }
+  bool loaded = CReplay::load(file);
+  fclose(file);
+  if (!loaded)
+    return 2;
+
+  CLog::set_sink(log_sink);
+  CReplay::run(settle_ms);
+  CLog::drain();
+
+  std::string output;
+  CReplay::report(output);
+  if (!quiet)
+    fputs(output.c_str(), stdout);
+  CReplay::report_metrics(stdout);
+
+  if (trace_path != NULL)
+  {
+#ifdef USE_MOTION_TRACE
+    FILE* trace = fopen(trace_path, "w");
+    if (trace == NULL)
+    {
+      perror(trace_path);
+      return 2;
+    }
+    CReplay::write_trace(trace);
+    fclose(trace);
+#else
+    fprintf(stderr, "built without USE_MOTION_TRACE, no trace written\n");
+#endif
+  }
+
+  if (expected_path != NULL && !compare(output, expected_path))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// Minimal Arduino API for the native (host) build. Time is virtual: it only
+// advances in delay()/delayMicroseconds(), which step the registered
+// simulation models and fire attached pin interrupts on the way.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW  0
+#define HIGH 1
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define NUM_DIGITAL_PINS 32
+
+#define digitalPinToInterrupt(pin) (pin)
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write(reinterpret_cast<const uint8_t*>(buffer), size); }
+  virtual int availableForWrite() { return 0; }
+
+  size_t print(const char* str) { return write(str); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int n) { return print(static_cast<long>(n)); }
+  size_t print(unsigned int n) { return print(static_cast<unsigned long>(n)); }
+  size_t print(long n);
+  size_t print(unsigned long n);
+  size_t print(double n, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template<class T>
+  size_t println(T value) { size_t n = print(value); return n + println(); }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+struct SSimSerialState;
+
+// Copies share their buffers, so the serial port can be passed by value like
+// the real HardwareSerial.
+class HardwareSerial : public Stream
+{
+public:
+  HardwareSerial();
+  void begin(unsigned long baud);
+  int available();
+  int read();
+  int peek();
+  int availableForWrite();
+  using Print::write;
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buffer, size_t size);
+  operator bool() { return true; }
+
+private:
+  SSimSerialState* mState;
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,66 @@
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass() :
+  mWriteBudget(-1)
+{
+  sim_erase();
+}
+
+void EEPROMClass::begin(size_t size)
+{
+}
+
+bool EEPROMClass::commit()
+{
+  return true;
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+  return (address >= 0 && address < SIM_EEPROM_SIZE) ? mData[address] : 0xFF;
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+  if (address < 0 || address >= SIM_EEPROM_SIZE || mWriteBudget == 0)
+  {
+    return;
+  }
+  if (mWriteBudget > 0)
+  {
+    mWriteBudget--;
+  }
+  mData[address] = value;
+  mWriteCount[address]++;
+}
+
+void EEPROMClass::update(int address, uint8_t value)
+{
+  if (read(address) != value)
+  {
+    write(address, value);
+  }
+}
+
+uint16_t EEPROMClass::length()
+{
+  return SIM_EEPROM_SIZE;
+}
+
+void EEPROMClass::sim_erase()
+{
+  memset(mData, 0xFF, sizeof(mData));
+  memset(mWriteCount, 0, sizeof(mWriteCount));
+}
+
+void EEPROMClass::sim_set_write_budget(int32_t budget)
+{
+  mWriteBudget = budget;
+}
+
+uint32_t EEPROMClass::sim_get_write_count(int address)
+{
+  return (address >= 0 && address < SIM_EEPROM_SIZE) ? mWriteCount[address] : 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define SIM_EEPROM_SIZE 1024
+
+// EEPROM emulation for the native build. Writes can be limited to simulate
+// losing power in the middle of a write sequence.
+class EEPROMClass
+{
+public:
+  EEPROMClass();
+  void begin(size_t size);
+  bool commit();
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  void update(int address, uint8_t value);
+  uint16_t length();
+
+  // Simulation control: erase to 0xFF, and allow only this many more byte
+  // writes (negative for unlimited)
+  void sim_erase();
+  void sim_set_write_budget(int32_t budget);
+  uint32_t sim_get_write_count(int address);
+
+private:
+  uint8_t mData[SIM_EEPROM_SIZE];
+  uint32_t mWriteCount[SIM_EEPROM_SIZE];
+  int32_t mWriteBudget;
+};
+
+extern EEPROMClass EEPROM;
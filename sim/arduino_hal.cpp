@@ -0,0 +1,262 @@
+#include "Arduino.h"
+#include "sim_hal.h"
+#include <deque>
+
+#define SIM_MAX_MODELS 8
+
+struct SSimSerialState
+{
+  std::deque<char> rx;
+  std::string tx;
+  bool echo;
+};
+
+struct SSimModel
+{
+  CSimHal::model_step_t step;
+  void* context;
+};
+
+static uint64_t sim_time_us = 0;
+static uint8_t pin_levels[NUM_DIGITAL_PINS];
+static void (*pin_isrs[NUM_DIGITAL_PINS])(void);
+static int pin_isr_modes[NUM_DIGITAL_PINS];
+static SSimModel sim_models[SIM_MAX_MODELS];
+static size_t sim_model_count = 0;
+static SSimSerialState serial_state;
+
+HardwareSerial Serial;
+
+uint32_t millis()
+{
+  return static_cast<uint32_t>(sim_time_us / 1000);
+}
+
+uint32_t micros()
+{
+  return static_cast<uint32_t>(sim_time_us);
+}
+
+void delay(uint32_t ms)
+{
+  CSimHal::advance_us(ms * 1000UL);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  CSimHal::advance_us(us);
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < NUM_DIGITAL_PINS && mode == INPUT_PULLUP)
+  {
+    pin_levels[pin] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin < NUM_DIGITAL_PINS)
+  {
+    pin_levels[pin] = value ? HIGH : LOW;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < NUM_DIGITAL_PINS ? pin_levels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode)
+{
+  if (interrupt < NUM_DIGITAL_PINS)
+  {
+    pin_isrs[interrupt] = isr;
+    pin_isr_modes[interrupt] = mode;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+  if (interrupt < NUM_DIGITAL_PINS)
+  {
+    pin_isrs[interrupt] = NULL;
+  }
+}
+
+// Interrupts are only raised from within CSimHal::advance_us, never
+// concurrently with the firmware, so there is nothing to mask
+void noInterrupts()
+{
+}
+
+void interrupts()
+{
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long n)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", n);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long n)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", n);
+  return write(buf);
+}
+
+size_t Print::print(double n, int digits)
+{
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+HardwareSerial::HardwareSerial() :
+  mState(&serial_state)
+{
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+}
+
+int HardwareSerial::available()
+{
+  return static_cast<int>(mState->rx.size());
+}
+
+int HardwareSerial::read()
+{
+  if (mState->rx.empty())
+  {
+    return -1;
+  }
+  char c = mState->rx.front();
+  mState->rx.pop_front();
+  return static_cast<uint8_t>(c);
+}
+
+int HardwareSerial::peek()
+{
+  return mState->rx.empty() ? -1 : static_cast<uint8_t>(mState->rx.front());
+}
+
+int HardwareSerial::availableForWrite()
+{
+  return 64;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+  if (mState->echo)
+  {
+    fwrite(buffer, 1, size, stdout);
+  }
+  else
+  {
+    mState->tx.append(reinterpret_cast<const char*>(buffer), size);
+  }
+  return size;
+}
+
+void CSimHal::add_model(model_step_t step, void* context)
+{
+  if (sim_model_count < SIM_MAX_MODELS)
+  {
+    sim_models[sim_model_count].step = step;
+    sim_models[sim_model_count].context = context;
+    sim_model_count++;
+  }
+}
+
+void CSimHal::advance_us(uint32_t us)
+{
+  while (us > 0)
+  {
+    uint32_t dt = us < SIM_STEP_US ? us : SIM_STEP_US;
+    sim_time_us += dt;
+    for (size_t i = 0; i < sim_model_count; i++)
+    {
+      sim_models[i].step(sim_models[i].context, dt);
+    }
+    us -= dt;
+  }
+}
+
+uint64_t CSimHal::time_us()
+{
+  return sim_time_us;
+}
+
+void CSimHal::set_input(uint8_t pin, uint8_t level)
+{
+  if (pin >= NUM_DIGITAL_PINS)
+  {
+    return;
+  }
+
+  uint8_t prev_level = pin_levels[pin];
+  pin_levels[pin] = level ? HIGH : LOW;
+
+  if (pin_isrs[pin] == NULL || prev_level == pin_levels[pin])
+  {
+    return;
+  }
+
+  int mode = pin_isr_modes[pin];
+  if (mode == CHANGE ||
+      (mode == RISING && pin_levels[pin] == HIGH) ||
+      (mode == FALLING && pin_levels[pin] == LOW))
+  {
+    pin_isrs[pin]();
+  }
+}
+
+uint8_t CSimHal::get_output(uint8_t pin)
+{
+  return pin < NUM_DIGITAL_PINS ? pin_levels[pin] : LOW;
+}
+
+void CSimHal::serial_inject(const char* data)
+{
+  while (*data)
+  {
+    serial_state.rx.push_back(*data++);
+  }
+}
+
+std::string CSimHal::serial_take_output()
+{
+  std::string output;
+  output.swap(serial_state.tx);
+  return output;
+}
+
+void CSimHal::serial_set_echo(bool echo)
+{
+  serial_state.echo = echo;
+}
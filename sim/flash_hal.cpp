@@ -0,0 +1,69 @@
+#include "flash_hal.h"
+
+static uint8_t flash[FS_PHYS_SIZE];
+static bool flash_erased = false;
+static int32_t write_budget = -1;
+static uint32_t erase_count = 0;
+static uint32_t write_count = 0;
+
+static bool in_range(uint32_t address, uint32_t size)
+{
+  if (!flash_erased)
+    CSimFlash::erase_all();
+  return address >= FS_PHYS_ADDR && address + size <= FS_PHYS_ADDR + FS_PHYS_SIZE;
+}
+
+uint32_t flash_hal_read(uint32_t address, uint32_t size, uint8_t* dst)
+{
+  if (!in_range(address, size))
+    return FLASH_HAL_READ_ERROR;
+  memcpy(dst, &(flash[address - FS_PHYS_ADDR]), size);
+  return FLASH_HAL_OK;
+}
+
+uint32_t flash_hal_write(uint32_t address, uint32_t size, const uint8_t* src)
+{
+  if (!in_range(address, size))
+    return FLASH_HAL_WRITE_ERROR;
+  for (uint32_t i = 0; i < size && write_budget != 0; i++)
+  {
+    if (write_budget > 0)
+      write_budget--;
+    flash[address - FS_PHYS_ADDR + i] &= src[i];
+    write_count++;
+  }
+  return FLASH_HAL_OK;
+}
+
+uint32_t flash_hal_erase(uint32_t address, uint32_t size)
+{
+  if (!in_range(address, size) || (address - FS_PHYS_ADDR) % SIM_FLASH_SECTOR_SIZE != 0 ||
+      size % SIM_FLASH_SECTOR_SIZE != 0)
+    return FLASH_HAL_ERASE_ERROR;
+  memset(&(flash[address - FS_PHYS_ADDR]), 0xFF, size);
+  erase_count += size / SIM_FLASH_SECTOR_SIZE;
+  return FLASH_HAL_OK;
+}
+
+void CSimFlash::erase_all()
+{
+  memset(flash, 0xFF, sizeof(flash));
+  flash_erased = true;
+  erase_count = 0;
+  write_count = 0;
+}
+
+void CSimFlash::set_write_budget(int32_t budget)
+{
+  write_budget = budget;
+}
+
+uint32_t CSimFlash::get_erase_count()
+{
+  return erase_count;
+}
+
+uint32_t CSimFlash::get_write_count()
+{
+  return write_count;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Raw flash of the esp8266 core (flash_hal.h) for the native build: erased
+// bytes read 0xFF, programming only clears bits. Writes can be limited to
+// simulate losing power in the middle of a write, and erases are counted.
+#define SIM_FLASH_SECTOR_SIZE 4096
+#define SIM_FLASH_SECTORS 4
+
+#define FS_PHYS_ADDR 0x100000
+#define FS_PHYS_SIZE (SIM_FLASH_SECTORS * SIM_FLASH_SECTOR_SIZE)
+
+#define FLASH_HAL_OK 0
+#define FLASH_HAL_READ_ERROR (-1)
+#define FLASH_HAL_ERASE_ERROR (-2)
+#define FLASH_HAL_WRITE_ERROR (-3)
+
+uint32_t flash_hal_read(uint32_t address, uint32_t size, uint8_t* dst);
+uint32_t flash_hal_write(uint32_t address, uint32_t size, const uint8_t* src);
+uint32_t flash_hal_erase(uint32_t address, uint32_t size);
+
+class CSimFlash
+{
+public:
+  // Erase everything and reset the counters
+  static void erase_all();
+  // Allow only this many more bytes to be programmed, negative for unlimited
+  static void set_write_budget(int32_t budget);
+  static uint32_t get_erase_count();
+  static uint32_t get_write_count();
+
+private:
+  CSimFlash() {}
+};
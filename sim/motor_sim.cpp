@@ -0,0 +1,143 @@
+#include "motor_sim.h"
+#include "sim_hal.h"
+#include <math.h>
+
+#ifdef ENC_QUADRATURE
+CMotorSim::CMotorSim(uint8_t enc_pin_a, uint8_t enc_pin_b, uint8_t mot_pos_pin, uint8_t mot_neg_pin, const SMotorSimParams& params) :
+#else
+CMotorSim::CMotorSim(uint8_t enc_pin, uint8_t mot_pos_pin, uint8_t mot_neg_pin, const SMotorSimParams& params) :
+#endif
+  mParams(params),
+  mAngle(params.start_angle),
+  mSpeed(0.0),
+  mEdgeIndex(static_cast<int32_t>(floor(params.start_angle / params.deg_per_edge))),
+  mEdgeCount(0),
+#ifdef ENC_QUADRATURE
+  mEncPin(enc_pin_a),
+#else
+  mEncPin(enc_pin),
+#endif
+  mMotPosPin(mot_pos_pin),
+  mMotNegPin(mot_neg_pin),
+  mEncLevel(LOW)
+#ifdef ENC_QUADRATURE
+  , mEncPinB(enc_pin_b)
+#endif
+{
+}
+
+SMotorSimParams CMotorSim::default_params()
+{
+  SMotorSimParams params;
+  params.max_speed    = 7.5f;
+  params.spin_up_time = 0.2f;
+  params.coast_decel  = 20.0f;
+  params.min_angle    = 0.0f;
+  params.max_angle    = 360.0f;
+#ifdef ENC_QUADRATURE
+  params.deg_per_edge = 0.01875f;
+#else
+  params.deg_per_edge = 0.0375f;
+#endif
+  params.start_angle  = 180.0f;
+  return params;
+}
+
+void CMotorSim::begin()
+{
+  set_encoder();
+  CSimHal::add_model(CMotorSim::step_model, this);
+}
+
+void CMotorSim::step_model(void* context, uint32_t dt_us)
+{
+  static_cast<CMotorSim*>(context)->step(dt_us);
+}
+
+void CMotorSim::step(uint32_t dt_us)
+{
+  double dt = dt_us * 1e-6;
+  bool pos_on = CSimHal::get_output(mMotPosPin) == HIGH;
+  bool neg_on = CSimHal::get_output(mMotNegPin) == HIGH;
+
+  if (pos_on != neg_on)
+  {
+    // Spinning up (or reversing) towards full speed
+    double target_speed = pos_on ? mParams.max_speed : -mParams.max_speed;
+    double alpha = dt / mParams.spin_up_time;
+    mSpeed += (target_speed - mSpeed) * (alpha < 1.0 ? alpha : 1.0);
+  }
+  else
+  {
+    // Coasting, friction brings the mast to a halt
+    double decel = mParams.coast_decel * dt;
+    if (fabs(mSpeed) <= decel)
+      mSpeed = 0.0;
+    else
+      mSpeed -= mSpeed > 0.0 ? decel : -decel;
+  }
+
+  mAngle += mSpeed * dt;
+
+  // End stops only block motion towards them
+  if (mAngle <= mParams.min_angle)
+  {
+    mAngle = mParams.min_angle;
+    if (mSpeed < 0.0)
+      mSpeed = 0.0;
+  }
+  if (mAngle >= mParams.max_angle)
+  {
+    mAngle = mParams.max_angle;
+    if (mSpeed > 0.0)
+      mSpeed = 0.0;
+  }
+
+  // Every passed encoder slot produces one edge on the encoder input
+  int32_t edge_index = static_cast<int32_t>(floor(mAngle / mParams.deg_per_edge));
+  while (edge_index != mEdgeIndex)
+  {
+    mEdgeIndex += edge_index > mEdgeIndex ? 1 : -1;
+    mEdgeCount++;
+    set_encoder();
+  }
+}
+
+#ifdef ENC_QUADRATURE
+// Gray code of the edge index, 00 -> 01 -> 11 -> 10 going positive. Only one
+// channel changes per edge.
+void CMotorSim::set_encoder()
+{
+  static const uint8_t GRAY[4] = { 0, 1, 3, 2 };
+  uint8_t state = GRAY[mEdgeIndex & 3];
+  CSimHal::set_input(mEncPin, state >> 1);
+  CSimHal::set_input(mEncPinB, state & 1);
+}
+#else
+// The encoder input toggles on every edge
+void CMotorSim::set_encoder()
+{
+  mEncLevel = mEdgeIndex & 1 ? HIGH : LOW;
+  CSimHal::set_input(mEncPin, mEncLevel);
+}
+#endif
+
+float CMotorSim::get_angle()
+{
+  return mAngle;
+}
+
+float CMotorSim::get_speed()
+{
+  return mSpeed;
+}
+
+bool CMotorSim::is_at_rest()
+{
+  return mSpeed == 0.0;
+}
+
+uint32_t CMotorSim::get_edge_count()
+{
+  return mEdgeCount;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+struct SMotorSimParams
+{
+  float max_speed;     // deg/s when fully spun up
+  float spin_up_time;  // s, first order time constant of spin-up
+  float coast_decel;   // deg/s^2 when both relays are off
+  float min_angle;     // deg, negative end stop
+  float max_angle;     // deg, positive end stop
+  float deg_per_edge;  // deg of travel between two encoder edges
+  float start_angle;   // deg
+};
+
+// Motor, mast and encoder model of one axis: reads the relay outputs and
+// drives the encoder input of the firmware, or both channels in quadrature
+// with -DENC_QUADRATURE
+class CMotorSim
+{
+public:
+#ifdef ENC_QUADRATURE
+  CMotorSim(uint8_t enc_pin_a, uint8_t enc_pin_b, uint8_t mot_pos_pin, uint8_t mot_neg_pin, const SMotorSimParams& params);
+#else
+  CMotorSim(uint8_t enc_pin, uint8_t mot_pos_pin, uint8_t mot_neg_pin, const SMotorSimParams& params);
+#endif
+  void begin();
+  void step(uint32_t dt_us);
+  float get_angle();
+  float get_speed();
+  bool is_at_rest();
+  uint32_t get_edge_count();
+
+  static SMotorSimParams default_params();
+
+private:
+  static void step_model(void* context, uint32_t dt_us);
+  void set_encoder();
+
+  SMotorSimParams mParams;
+  double mAngle;
+  double mSpeed;
+  int32_t mEdgeIndex;
+  uint32_t mEdgeCount;
+  uint8_t mEncPin;
+  uint8_t mMotPosPin;
+  uint8_t mMotNegPin;
+  uint8_t mEncLevel;
+#ifdef ENC_QUADRATURE
+  uint8_t mEncPinB;
+#endif
+};
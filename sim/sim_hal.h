@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+
+// Virtual time step with which the simulation models are advanced
+#define SIM_STEP_US 100
+
+// Simulation side of the native Arduino HAL
+class CSimHal
+{
+public:
+  typedef void (*model_step_t)(void* context, uint32_t dt_us);
+
+  // Register a model that is stepped whenever virtual time advances
+  static void add_model(model_step_t step, void* context);
+
+  // Advance virtual time, stepping models and firing pin interrupts
+  static void advance_us(uint32_t us);
+  static uint64_t time_us();
+
+  // Drive an input pin, firing its interrupt handler on a matching edge
+  static void set_input(uint8_t pin, uint8_t level);
+  static uint8_t get_output(uint8_t pin);
+
+  // Serial port contents; received data is consumed by the firmware, transmitted
+  // data is collected until taken (and optionally echoed to stdout)
+  static void serial_inject(const char* data);
+  static std::string serial_take_output();
+  static void serial_set_echo(bool echo);
+
+private:
+  CSimHal() {}
+};
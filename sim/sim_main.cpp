@@ -0,0 +1,288 @@
+// Time-accelerated rotator simulation: runs the firmware (setup()/loop() from
+// rotator.cpp) against simulated motors and encoders on a virtual clock and
+// reports time-to-target and overshoot statistics for a series of random moves.
+//
+// Usage: program [-n moves] [-s seed] [-m max_speed] [-c coast_decel] [-x] [-v] [-t file]
+//   -x  disable coast compensation, for comparison
+//   -t  dump the motion trace over the serial port into file at the end, for
+//       tools/trace_decode.py
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "perf_counters.h"
+#include "pins.h"
+#include "rotator_axes.h"
+#include "sim_hal.h"
+#include "motor_sim.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
+
+#define SIM_MOVE_TIMEOUT 180000UL // ms
+#define SIM_AZ_RANGE 3600 // 1e-1 deg
+#define SIM_EL_RANGE 900 // 1e-1 deg
+
+void setup();
+void loop();
+
+struct SAxisResult
+{
+  float overshoot; // deg, travel beyond the setpoint
+  float error;     // deg, final distance to the setpoint
+};
+
+struct SMoveResult
+{
+  float time_to_target; // s
+  SAxisResult az;
+  SAxisResult el;
+};
+
+class CAxisTracker
+{
+public:
+  CAxisTracker(CMotorSim& motor) :
+    mMotor(motor), mTarget(0.0f), mDirection(0.0f), mOvershoot(0.0f)
+  {
+  }
+
+  void start(int32_t target)
+  {
+    mTarget = target / 10.0f;
+    float distance = mTarget - mMotor.get_angle();
+    mDirection = distance > 0.0f ? 1.0f : -1.0f;
+    mOvershoot = 0.0f;
+  }
+
+  void sample()
+  {
+    float overshoot = (mMotor.get_angle() - mTarget) * mDirection;
+    if (overshoot > mOvershoot)
+      mOvershoot = overshoot;
+  }
+
+  SAxisResult result()
+  {
+    SAxisResult result;
+    result.overshoot = mOvershoot;
+    result.error = fabsf(mMotor.get_angle() - mTarget);
+    return result;
+  }
+
+private:
+  CMotorSim& mMotor;
+  float mTarget;
+  float mDirection;
+  float mOvershoot;
+};
+
+static float percentile(std::vector<float> values, float fraction)
+{
+  if (values.empty())
+    return 0.0f;
+  std::sort(values.begin(), values.end());
+  size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5f);
+  return values[index];
+}
+
+static void print_stats(const char* name, const std::vector<float>& values, const char* unit)
+{
+  float sum = 0.0f;
+  for (size_t i = 0; i < values.size(); i++)
+    sum += values[i];
+  printf("%-16s mean %8.2f  p50 %8.2f  p95 %8.2f  max %8.2f %s\n",
+    name,
+    values.empty() ? 0.0f : sum / values.size(),
+    percentile(values, 0.50f),
+    percentile(values, 0.95f),
+    percentile(values, 1.00f),
+    unit);
+}
+
+#ifdef USE_MOTION_TRACE
+// Fetch the trace with DT commands like a host would, while the firmware runs
+static void dump_trace(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (file == NULL)
+  {
+    perror(path);
+    return;
+  }
+
+  unsigned long sequence = 0;
+  while (true)
+  {
+    char command[24];
+    snprintf(command, sizeof(command), "DT%lu\n", sequence);
+    CSimHal::serial_inject(command);
+
+    std::string response;
+    while (response.find('\n') == std::string::npos)
+    {
+      loop();
+      response += CSimHal::serial_take_output();
+    }
+    fputs(response.c_str(), file);
+
+    unsigned long first = 0;
+    const char* records = strchr(response.c_str(), ' ');
+    size_t count = records != NULL ? strcspn(records + 1, "\r\n") / 16 : 0;
+    if (sscanf(response.c_str(), "DT%lu", &first) != 1 || count == 0)
+      break;
+    sequence = first + count;
+  }
+  fclose(file);
+}
+#endif
+
+static bool is_settled(CMotorSim& az_motor, CMotorSim& el_motor)
+{
+  return Serial.available() == 0 &&
+         azimuth_axis.is_stopped() && elevation_axis.is_stopped() &&
+         az_motor.is_at_rest() && el_motor.is_at_rest();
+}
+
+int main(int argc, char** argv)
+{
+  long move_count = 1000;
+  unsigned int seed = 1;
+  bool verbose = false;
+  bool coast_compensation = true;
+  const char* trace_path = NULL;
+  SMotorSimParams az_params = CMotorSim::default_params();
+  SMotorSimParams el_params = CMotorSim::default_params();
+  el_params.max_angle = 95.0f;
+  el_params.start_angle = 45.0f;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:m:c:xvt:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': move_count = atol(optarg); break;
+      case 's': seed = static_cast<unsigned int>(atol(optarg)); break;
+      case 'm': az_params.max_speed = el_params.max_speed = atof(optarg); break;
+      case 'c': az_params.coast_decel = el_params.coast_decel = atof(optarg); break;
+      case 'x': coast_compensation = false; break;
+      case 'v': verbose = true; break;
+      case 't': trace_path = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-n moves] [-s seed] [-m max_speed] [-c coast_decel] [-x] [-v] [-t file]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  srand(seed);
+  CSimHal::serial_set_echo(verbose);
+
+#ifdef ENC_QUADRATURE
+  CMotorSim az_motor(ENC_AZ, ENC_AZ_B, MOT_AZ_POS, MOT_AZ_NEG, az_params);
+  CMotorSim el_motor(ENC_EL, ENC_EL_B, MOT_EL_POS, MOT_EL_NEG, el_params);
+#else
+  CMotorSim az_motor(ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG, az_params);
+  CMotorSim el_motor(ENC_EL, MOT_EL_POS, MOT_EL_NEG, el_params);
+#endif
+  az_motor.begin();
+  el_motor.begin();
+
+  CAxisTracker az_tracker(az_motor);
+  CAxisTracker el_tracker(el_motor);
+
+  auto wall_start = std::chrono::steady_clock::now();
+  uint64_t sim_start = CSimHal::time_us();
+
+  azimuth_axis.set_coast_compensation(coast_compensation);
+  elevation_axis.set_coast_compensation(coast_compensation);
+
+  setup();
+  while (azimuth_axis.is_homing() || elevation_axis.is_homing())
+  {
+    loop();
+    CSimHal::serial_take_output();
+  }
+
+  std::vector<SMoveResult> results;
+  long timeouts = 0;
+
+  for (long move = 0; move < move_count; move++)
+  {
+    int32_t az_target = rand() % SIM_AZ_RANGE;
+    int32_t el_target = rand() % SIM_EL_RANGE;
+
+    char command[32];
+    snprintf(command, sizeof(command), "AZ%ld.%ld\nEL%ld.%ld\n",
+      static_cast<long>(az_target / 10), static_cast<long>(az_target % 10),
+      static_cast<long>(el_target / 10), static_cast<long>(el_target % 10));
+    CSimHal::serial_inject(command);
+
+    az_tracker.start(az_target);
+    el_tracker.start(el_target);
+    uint32_t start_time = millis();
+
+    do
+    {
+      loop();
+      az_tracker.sample();
+      el_tracker.sample();
+      CSimHal::serial_take_output();
+    }
+    while (!is_settled(az_motor, el_motor) && millis() - start_time < SIM_MOVE_TIMEOUT);
+
+    if (!is_settled(az_motor, el_motor))
+    {
+      timeouts++;
+      continue;
+    }
+
+    SMoveResult result;
+    result.time_to_target = (millis() - start_time) / 1000.0f;
+    result.az = az_tracker.result();
+    result.el = el_tracker.result();
+    results.push_back(result);
+  }
+
+  if (trace_path != NULL)
+  {
+#ifdef USE_MOTION_TRACE
+    dump_trace(trace_path);
+#else
+    fprintf(stderr, "built without USE_MOTION_TRACE, no trace written\n");
+#endif
+  }
+
+  double wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+  double sim_time = (CSimHal::time_us() - sim_start) * 1e-6;
+
+  std::vector<float> time_to_target, az_overshoot, el_overshoot, az_error, el_error;
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    time_to_target.push_back(results[i].time_to_target);
+    az_overshoot.push_back(results[i].az.overshoot);
+    el_overshoot.push_back(results[i].el.overshoot);
+    az_error.push_back(results[i].az.error);
+    el_error.push_back(results[i].el.error);
+  }
+
+  printf("moves %ld, timeouts %ld, simulated %.0f s in %.2f s wall time (%.0fx)\n",
+    move_count, timeouts, sim_time, wall_time, wall_time > 0.0 ? sim_time / wall_time : 0.0);
+  print_stats("time to target", time_to_target, "s");
+  print_stats("az overshoot", az_overshoot, "deg");
+  print_stats("el overshoot", el_overshoot, "deg");
+  print_stats("az final error", az_error, "deg");
+  print_stats("el final error", el_error, "deg");
+  printf("learned coast    az %.1f/%.1f  el %.1f/%.1f deg (positive/negative)\n",
+    azimuth_axis.get_coast(1) / 10.0f, azimuth_axis.get_coast(-1) / 10.0f,
+    elevation_axis.get_coast(1) / 10.0f, elevation_axis.get_coast(-1) / 10.0f);
+#ifdef USE_PERF_COUNTERS
+  char perf[128];
+  CPerfCounters::format_section('L', perf, sizeof(perf));
+  printf("control periods  %s (bins from 256 us, doubling)\n", perf);
+  CPerfCounters::format_section('A', perf, sizeof(perf));
+  printf("encoder          %s (interrupts/rejected/relay transitions)\n", perf);
+#endif
+
+  return timeouts == 0 ? 0 : 2;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef ARDUINO_ARCH_AVR
+#include <avr/pgmspace.h>
+#endif
+
+// Storage of a command table, flash on the AVR
+#ifdef ARDUINO_ARCH_AVR
+#define COMMAND_TABLE_STORAGE PROGMEM
+#else
+#define COMMAND_TABLE_STORAGE
+#endif
+
+// Slots of a command table, a power of two
+#define COMMAND_TABLE_SIZE 32
+
+// Perfect hash of a mnemonic into the table. The constants were searched for
+// the commands in easycomm_handler.cpp; when a new command collides the table
+// doesn't compile, pick other ones.
+#define COMMAND_HASH_FIRST  172
+#define COMMAND_HASH_SECOND 87
+#define COMMAND_HASH_SHIFT  5
+
+// A command handled by its first letter only, the second is its argument
+#define COMMAND_ANY 0
+
+// Command entry: the mnemonic, e.g. 'A', 'Z', or a first letter with
+// COMMAND_ANY for commands that take the second letter as argument
+template<class H>
+struct SCommandEntry
+{
+  char first;
+  char second;
+  H handler;
+  uint8_t flags;
+};
+
+// C++11 has no std::index_sequence, and the AVR toolchain no <utility>
+template<uint8_t... I>
+struct SCommandIndices {};
+
+template<uint8_t N, uint8_t... I>
+struct SMakeCommandIndices : SMakeCommandIndices<N - 1, N - 1, I...> {};
+
+template<uint8_t... I>
+struct SMakeCommandIndices<0, I...>
+{
+  typedef SCommandIndices<I...> type;
+};
+
+constexpr uint8_t command_slot(char first, char second)
+{
+  return static_cast<uint16_t>(static_cast<uint8_t>(first) * COMMAND_HASH_FIRST +
+                               static_cast<uint8_t>(second) * COMMAND_HASH_SECOND) >> COMMAND_HASH_SHIFT &
+         (COMMAND_TABLE_SIZE - 1);
+}
+
+// Dispatch table built at compile time from a list of entries, each in the
+// slot of its mnemonic. A lookup is one probe for the mnemonic and one for
+// its first letter, however many commands there are. On the AVR the table
+// belongs in flash (declare it COMMAND_TABLE_STORAGE); find() reads it
+// from there.
+template<class H>
+class CCommandTable
+{
+public:
+  typedef SCommandEntry<H> SEntry;
+
+  template<size_t N>
+  constexpr CCommandTable(const SEntry (&list)[N]) :
+    CCommandTable(list, typename SMakeCommandIndices<COMMAND_TABLE_SIZE>::type())
+  {
+  }
+
+  // Whether every entry of the list got a slot of its own
+  template<size_t N>
+  static constexpr bool is_perfect(const SEntry (&list)[N], size_t i = 0, size_t j = 1)
+  {
+    return i + 1 >= N ? true :
+           j >= N ? is_perfect(list, i + 1, i + 2) :
+           command_slot(list[i].first, list[i].second) != command_slot(list[j].first, list[j].second) &&
+           is_perfect(list, i, j + 1);
+  }
+
+  // Returns false when there is no such command
+  bool find(char first, char second, SEntry& entry) const
+  {
+    read_slot(command_slot(first, second), entry);
+    if (entry.handler != NULL && entry.first == first && entry.second == second)
+      return true;
+    read_slot(command_slot(first, COMMAND_ANY), entry);
+    return entry.handler != NULL && entry.first == first && entry.second == COMMAND_ANY;
+  }
+
+private:
+  template<size_t N, uint8_t... I>
+  constexpr CCommandTable(const SEntry (&list)[N], SCommandIndices<I...>) :
+    mSlots{ entry_for_slot(list, I)... }
+  {
+  }
+
+  template<size_t N>
+  static constexpr SEntry entry_for_slot(const SEntry (&list)[N], uint8_t slot, size_t i = 0)
+  {
+    return i >= N ? SEntry{ 0, 0, NULL, 0 } :
+           command_slot(list[i].first, list[i].second) == slot ? list[i] :
+           entry_for_slot(list, slot, i + 1);
+  }
+
+  void read_slot(uint8_t slot, SEntry& entry) const
+  {
+#ifdef ARDUINO_ARCH_AVR
+    memcpy_P(&entry, &(mSlots[slot]), sizeof(entry));
+#else
+    entry = mSlots[slot];
+#endif
+  }
+
+  SEntry mSlots[COMMAND_TABLE_SIZE];
+};
@@ -0,0 +1,160 @@
+#include "decimal_codec.h"
+
+// A 32 bit value has at most 10 digits
+#define MAX_DECIMALS 9
+
+CDecimalCodec::EResult CDecimalCodec::parse(const char* string, uint8_t decimals, int32_t& value, const char** end)
+{
+  const char* it = string;
+  bool negative = false;
+
+  if (*it == '-' || *it == '+')
+  {
+    negative = (*it == '-');
+    it++;
+  }
+
+  // Accumulate the magnitude, limited to 2^31 so the negative range fits
+  const uint32_t limit = negative ? 0x80000000UL : 0x7FFFFFFFUL;
+  uint32_t magnitude = 0;
+  uint8_t frac_digits = 0;
+  bool seen_dot = false;
+  bool seen_digit = false;
+  bool round_up = false;
+  bool overflow = false;
+
+  for (;; it++)
+  {
+    char c = *it;
+    if (c == '.' && !seen_dot)
+    {
+      seen_dot = true;
+      continue;
+    }
+    if (c < '0' || c > '9')
+    {
+      break;
+    }
+
+    seen_digit = true;
+    if (seen_dot && frac_digits >= decimals)
+    {
+      // Only the first dropped digit decides the rounding
+      if (frac_digits == decimals)
+      {
+        round_up = (c >= '5');
+        frac_digits++;
+      }
+      continue;
+    }
+    if (seen_dot)
+    {
+      frac_digits++;
+    }
+
+    uint8_t digit = c - '0';
+    if (magnitude > (limit - digit) / 10)
+    {
+      overflow = true;
+    }
+    else
+    {
+      magnitude = magnitude * 10 + digit;
+    }
+  }
+
+  if (end)
+  {
+    *end = it;
+  }
+
+  if (!seen_digit)
+  {
+    return CDecimalCodec::EResultNoDigits;
+  }
+
+  // Scale up when fewer decimals were given than requested
+  for (; frac_digits < decimals; frac_digits++)
+  {
+    if (magnitude > limit / 10)
+    {
+      overflow = true;
+    }
+    else
+    {
+      magnitude *= 10;
+    }
+  }
+
+  if (round_up)
+  {
+    if (magnitude == limit)
+    {
+      overflow = true;
+    }
+    else
+    {
+      magnitude++;
+    }
+  }
+
+  if (overflow)
+  {
+    return CDecimalCodec::EResultOverflow;
+  }
+
+  value = negative ? static_cast<int32_t>(0U - magnitude) : static_cast<int32_t>(magnitude);
+  return CDecimalCodec::EResultOk;
+}
+
+size_t CDecimalCodec::format(int32_t value, uint8_t decimals, char* string, size_t size)
+{
+  if (decimals > MAX_DECIMALS)
+  {
+    if (size > 0)
+    {
+      string[0] = '\0';
+    }
+    return 0;
+  }
+
+  // Build the string backwards, starting at the least significant digit
+  char buf[DECIMAL_STRING_SIZE - 1];
+  char* it = buf + sizeof(buf);
+  uint32_t magnitude = value < 0 ? 0U - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+  uint8_t digits = 0;
+
+  do
+  {
+    if (decimals > 0 && digits == decimals)
+    {
+      *--it = '.';
+    }
+    *--it = '0' + (magnitude % 10);
+    magnitude /= 10;
+    digits++;
+  }
+  while (magnitude > 0 || digits <= decimals);
+
+  if (value < 0)
+  {
+    *--it = '-';
+  }
+
+  size_t len = buf + sizeof(buf) - it;
+  if (len + 1 > size)
+  {
+    if (size > 0)
+    {
+      string[0] = '\0';
+    }
+    return 0;
+  }
+
+  for (size_t i = 0; i < len; i++)
+  {
+    string[i] = it[i];
+  }
+  string[len] = '\0';
+  return len;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fits any formatted 32 bit value: sign, 10 digits, dot and terminator
+#define DECIMAL_STRING_SIZE 13
+
+// Integer fixed-point decimal codec. Values are scaled by 10^decimals, so with
+// one decimal "123.4" <-> 1234. No floating point is involved.
+class CDecimalCodec
+{
+public:
+  enum EResult
+  {
+    EResultOk       = 0,
+    EResultNoDigits = 1,
+    EResultOverflow = 2,
+  };
+
+  // Parse an optionally signed decimal number with any number of decimals,
+  // rounding half away from zero to the requested number of decimals. Parsing
+  // stops at the first character that is not part of the number; its position
+  // is stored in end when given.
+  static EResult parse(const char* string, uint8_t decimals, int32_t& value, const char** end = NULL);
+
+  // Format a value with the given number of decimals. Returns the string
+  // length, or 0 if the buffer is too small.
+  static size_t format(int32_t value, uint8_t decimals, char* string, size_t size);
+
+private:
+  CDecimalCodec() {}
+};
@@ -1,16 +1,170 @@
 #include "Arduino.h"
 #include "easycomm_handler.h"
+#include "command_table.h"
+#include "decimal_codec.h"
+#include "log.h"
+#include "motion_trace.h"
+#include "perf_counters.h"
+#include "sat_tracker.h"
+#include "scheduler.h"
+#include "trajectory.h"
+#include "wall_clock.h"
 #include "string.h"
 
-#define MAX_NUMBER_STRING_SIZE 6
+// External positions are in 1e-1 deg
+#define POSITION_DECIMALS 1
+
+// Status bits as in Easycomm III, homing is an extension
+#define STATUS_IDLE   1
+#define STATUS_MOVING 2
+#define STATUS_HOMING 16
+
+// Waypoint times are in seconds with ms resolution
+#define TIME_DECIMALS 3
+
+// Station latitude and longitude in 1e-4 deg
+#define STATION_DECIMALS 4
+
+// hamlib RIG_EINVAL
+#define RPRT_INVALID -1
+
+// hamlib RIG_ERJCTED
+#define RPRT_REJECTED -9
+
+// Position push defaults, 1e-1 deg and ms
+#define PUSH_DELTA    1
+#define PUSH_INTERVAL 100
 
 CEncoderAxis* CEasyCommHandler::mAzimuthAxis = NULL;
 CEncoderAxis* CEasyCommHandler::mElevationAxis = NULL;
+CEncoderAxis::SSnapshot CEasyCommHandler::mAzimuthState;
+CEncoderAxis::SSnapshot CEasyCommHandler::mElevationState;
+CEasyCommHandler::SPositionText CEasyCommHandler::mAzimuthText;
+CEasyCommHandler::SPositionText CEasyCommHandler::mElevationText;
+char CEasyCommHandler::mResponse[RESP_BUF_SIZE];
+CEasyCommSession* CEasyCommHandler::mSession = NULL;
 
 void CEasyCommHandler::begin(CEncoderAxis& azimuth_axis, CEncoderAxis& elevation_axis)
 {
   mAzimuthAxis = &azimuth_axis;
   mElevationAxis = &elevation_axis;
+  mAzimuthAxis->get_snapshot(mAzimuthState);
+  mElevationAxis->get_snapshot(mElevationState);
+  mAzimuthText.valid = false;
+  mElevationText.valid = false;
+}
+
+void CEasyCommHandler::update(const CEncoderAxis::SSnapshot& azimuth, const CEncoderAxis::SSnapshot& elevation)
+{
+  mAzimuthState = azimuth;
+  mElevationState = elevation;
+}
+
+// The command takes the rest of the line, its arguments are separated by spaces
+#define COMMAND_REST_OF_LINE 1
+
+// Every command by its mnemonic, see command_table.h. Commands handled by
+// their first letter get COMMAND_ANY.
+struct SEasyCommCommands
+{
+  typedef CCommandTable<CEasyCommHandler::command_handler_t> CTable;
+
+  static constexpr CTable::SEntry list[] =
+  {
+    // rotctld style get and set pos
+    { 'p', COMMAND_ANY, CEasyCommHandler::handle_get_pos_command, 0 },
+    { '\\', 'g', CEasyCommHandler::handle_get_pos_command, 0 },
+    { 'P', COMMAND_ANY, CEasyCommHandler::handle_set_pos_command, COMMAND_REST_OF_LINE },
+    { '\\', 's', CEasyCommHandler::handle_set_pos_command, COMMAND_REST_OF_LINE },
+    { 'A', 'Z', CEasyCommHandler::handle_az_command, 0 },
+    { 'E', 'L', CEasyCommHandler::handle_el_command, 0 },
+    { 'G', 'S', CEasyCommHandler::handle_get_status_command, 0 },
+    { 'G', 'C', CEasyCommHandler::handle_get_coast_command, 0 },
+    { 'G', 'T', CEasyCommHandler::handle_get_tasks_command, 0 },
+    { 'G', 'L', CEasyCommHandler::handle_get_log_command, 0 },
+    { 'G', 'P', CEasyCommHandler::handle_get_perf_command, 0 },
+    { 'D', 'T', CEasyCommHandler::handle_dump_trace_command, 0 },
+    { 'T', COMMAND_ANY, CEasyCommHandler::handle_trajectory_command, 0 },
+    { 'T', 'A', CEasyCommHandler::handle_trajectory_command, COMMAND_REST_OF_LINE },
+    { 'O', COMMAND_ANY, CEasyCommHandler::handle_orbit_command, 0 },
+    { 'O', '1', CEasyCommHandler::handle_orbit_command, COMMAND_REST_OF_LINE },
+    { 'O', '2', CEasyCommHandler::handle_orbit_command, COMMAND_REST_OF_LINE },
+    { 'O', 'S', CEasyCommHandler::handle_orbit_command, COMMAND_REST_OF_LINE },
+    { 'V', 'E', CEasyCommHandler::handle_version_command, 0 },
+    { 'M', COMMAND_ANY, CEasyCommHandler::handle_move_command, 0 },
+    { 'S', COMMAND_ANY, CEasyCommHandler::handle_stop_command, 0 },
+    { 'S', 'U', CEasyCommHandler::handle_subscribe_command, COMMAND_REST_OF_LINE },
+    { 'U', 'N', CEasyCommHandler::handle_unsubscribe_command, 0 },
+  };
+
+  static_assert(CTable::is_perfect(list), "commands collide in the table, change the hash constants");
+
+  static constexpr CTable table COMMAND_TABLE_STORAGE = CTable(list);
+};
+
+constexpr SEasyCommCommands::CTable::SEntry SEasyCommCommands::list[];
+constexpr SEasyCommCommands::CTable SEasyCommCommands::table;
+
+size_t CEasyCommHandler::handle_request(char* request, char* output, size_t size)
+{
+  size_t len = 0;
+  char* it = request;
+
+  output[0] = '\0';
+  while (*it != '\0')
+  {
+    while (CEasyCommHandler::handle_next_command(it, mResponse))
+    {
+      size_t resp_len = strnlen(mResponse, RESP_BUF_SIZE);
+      if (len + resp_len >= size)
+      {
+        LOG_WARN("output buffer is full");
+        continue;
+      }
+      memcpy(&(output[len]), mResponse, resp_len);
+      len += resp_len;
+      output[len] = '\0';
+    }
+
+    // As in handle_commands(), the last separator becomes the line end
+    if (len > 0 && output[len - 1] == ' ' && *it != '\0')
+      output[len - 1] = *it;
+    if (*it != '\0')
+      it++;
+  }
+  return len;
+}
+
+// Handle the command at it and move it past it, returns false at the end of
+// the line. The command is terminated after its separator like a line of its
+// own, the character there is put back afterwards.
+bool CEasyCommHandler::handle_next_command(char*& it, char* response)
+{
+  while (*it == ' ')
+    it++;
+  if (*it == '\0' || *it == '\n' || *it == '\r')
+    return false;
+
+  char* command = it;
+  uint8_t flags = 0;
+  size_t len = 0;
+  if (CEasyCommHandler::find_command(command, flags) != NULL && (flags & COMMAND_REST_OF_LINE))
+    len = strcspn(command, "\r\n");
+  else
+    len = strcspn(command, " \r\n");
+  if (command[len] != '\0')
+    len++;
+
+  char next = command[len];
+  command[len] = '\0';
+#ifdef USE_PERF_COUNTERS
+  uint32_t start = micros();
+#endif
+  CEasyCommHandler::handle_command(command, response);
+  PERF_COMMAND(command, micros() - start);
+  command[len] = next;
+  it = &(command[len]);
+  return true;
 }
 
 void CEasyCommHandler::handle_command(char* command, char* response)
@@ -18,107 +172,164 @@ void CEasyCommHandler::handle_command(char* command, char* response)
   // Empty response by default
   response[0] = '\0';
 
-  Serial.print("Got command ");
-  Serial.println(command);
+  LOG_DEBUG("command %.*s", (int)strcspn(command, "\r\n"), command);
+  // Trace dumps stay out of the trace they read
+  if (command[0] != 'D')
+    TRACE_COMMAND(command);
+
+  uint8_t flags = 0;
+  command_handler_t handler = CEasyCommHandler::find_command(command, flags);
+  if (handler != NULL)
+    handler(command, response);
+}
+
+// Returns NULL for unknown commands
+CEasyCommHandler::command_handler_t CEasyCommHandler::find_command(const char* command, uint8_t& flags)
+{
+  SEasyCommCommands::CTable::SEntry entry;
+  if (!SEasyCommCommands::table.find(command[0], command[1], entry))
+    return NULL;
+  flags = entry.flags;
+  return entry.handler;
+}
 
-  if (command[0] == 'p' || (command[0] == '\\' && command[1] == 'g'))
+void CEasyCommHandler::handle_az_command(char* command, char* response)
+{
+  CEasyCommHandler::handle_az_el_command(mAzimuthAxis, mAzimuthState, mAzimuthText, command, response);
+}
+
+void CEasyCommHandler::handle_el_command(char* command, char* response)
+{
+  CEasyCommHandler::handle_az_el_command(mElevationAxis, mElevationState, mElevationText, command, response);
+}
+
+void CEasyCommHandler::handle_version_command(char* /*command*/, char* response)
+{
+  snprintf(response, RESP_BUF_SIZE, "PA3RVG Az/El rotor 0.0.1\n");
+}
+
+void CEasyCommHandler::handle_move_command(char* command, char* /*response*/)
+{
+  // Manual control takes over from a queued trajectory
+  CEasyCommHandler::stop_tracking();
+  if(command[1] == 'L')
   {
-    // rotctld style get pos
-    handle_get_pos_command(command, response);
+    // Move left
+    mAzimuthAxis->move_negative();
+    LOG_DEBUG("moving left");
   }
-  else if (command[0] == 'P' || (command[0] == '\\' && command[1] == 's'))
+  if(command[1] == 'R')
   {
-    // rotctld style set pos
-    handle_set_pos_command(command, response);
+    // Move right
+    mAzimuthAxis->move_positive();
+    LOG_DEBUG("moving right");
   }
-  else if (command[0] == 'A' && command[1] == 'Z')
+  if(command[1] == 'U')
   {
-    CEasyCommHandler::handle_az_el_command(mAzimuthAxis, command, response);
+    // Move up
+    mElevationAxis->move_positive();
+    LOG_DEBUG("moving up");
   }
-  else if (command[0] == 'E' && command[1] == 'L')
+  if(command[1] == 'D')
   {
-    CEasyCommHandler::handle_az_el_command(mElevationAxis, command, response);
+    // Move down
+    mElevationAxis->move_negative();
+    LOG_DEBUG("moving down");
   }
-  else if (command[0] == 'V' && command[1] == 'E')
+}
+
+void CEasyCommHandler::handle_stop_command(char* command, char* /*response*/)
+{
+  CEasyCommHandler::stop_tracking();
+  if(command[1] == 'A')
   {
-    // Return version
-    snprintf(response, RESP_BUF_SIZE, "PA3RVG Az/El rotor 0.0.1\n");
+    // Stop azimuth movement
+    mAzimuthAxis->stop_moving();
+    LOG_DEBUG("stop moving azimuth");
   }
-  else if (command[0] == 'M')
+  if(command[1] == 'E')
   {
-    if(command[1] == 'L')
-    {
-      // Move left
-      mAzimuthAxis->move_negative();
-      Serial.println("Moving left");
-    }
-    if(command[1] == 'R')
-    {
-      // Move right
-      mAzimuthAxis->move_positive();
-      Serial.println("Moving right");
-    }
-    if(command[1] == 'U')
-    {
-      // Move up
-      mElevationAxis->move_positive();
-      Serial.println("Moving up");
-    }
-    if(command[1] == 'D')
-    {
-      // Move down
-      mElevationAxis->move_negative();
-      Serial.println("Moving down");
-    }
+    // Stop elevation movement
+    mElevationAxis->stop_moving();
+    LOG_DEBUG("stop moving elevation");
   }
-  else if (command[0] == 'S')
+}
+
+// Formats the position only when it changed since the last query, polls
+// just copy the text
+const CEasyCommHandler::SPositionText& CEasyCommHandler::position_text(const CEncoderAxis::SSnapshot& state,
+                                                                       SPositionText& text)
+{
+  if (!text.valid || text.generation != state.generation)
   {
-    if(command[1] == 'A')
-    {
-      // Stop azimuth movement
-      mAzimuthAxis->stop_moving();
-      Serial.println("Stop moving azimuth");
-    }
-    if(command[1] == 'E')
-    {
-      // Stop elevation movement
-      mElevationAxis->stop_moving();
-      Serial.println("Stop moving elevation");
-    }
+    text.len = CDecimalCodec::format(state.position, POSITION_DECIMALS, text.text, sizeof(text.text));
+    text.generation = state.generation;
+    text.valid = true;
   }
+  return text;
 }
 
-void CEasyCommHandler::handle_get_pos_command(char* command, char* response)
+void CEasyCommHandler::handle_get_pos_command(char* /*command*/, char* response)
 {
-  int32_t az_pos = mAzimuthAxis->get_current_position();
-  int32_t el_pos = mElevationAxis->get_current_position();
-  snprintf(response, RESP_BUF_SIZE, "%.1f\n%.1f\n", az_pos/10.0, el_pos/10.0);
+  const SPositionText& az_text = CEasyCommHandler::position_text(mAzimuthState, mAzimuthText);
+  const SPositionText& el_text = CEasyCommHandler::position_text(mElevationState, mElevationText);
+
+  size_t len = 0;
+  memcpy(response, az_text.text, az_text.len);
+  len += az_text.len;
+  response[len++] = '\n';
+  memcpy(&(response[len]), el_text.text, el_text.len);
+  len += el_text.len;
+  response[len++] = '\n';
+  response[len] = '\0';
 }
 
 void CEasyCommHandler::handle_set_pos_command(char* command, char* response)
 {
-  float az_pos = 0.0;
-  float el_pos = 0.0;
+  int32_t az_pos = 0;
+  int32_t el_pos = 0;
 
-  sscanf(command, "%*s %f %f", &az_pos, &el_pos);
-  mAzimuthAxis->move_to_position(static_cast<int32_t>(az_pos*10.0));
-  mElevationAxis->move_to_position(static_cast<int32_t>(el_pos*10.0));
+  // Skip the command itself ("P" or "\set_pos"), the positions follow
+  const char* it = command;
+  while (*it != '\0' && *it != ' ')
+    it++;
+
+  if (!CEasyCommHandler::parse_next_number(it, POSITION_DECIMALS, az_pos) ||
+      !CEasyCommHandler::parse_next_number(it, POSITION_DECIMALS, el_pos))
+  {
+    LOG_WARN("invalid position");
+    snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+    return;
+  }
+
+  if (mAzimuthAxis->is_homing() || mElevationAxis->is_homing())
+  {
+    snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_REJECTED);
+    return;
+  }
+
+  CEasyCommHandler::stop_tracking();
+  mAzimuthAxis->move_to_position(az_pos);
+  mElevationAxis->move_to_position(el_pos);
   snprintf(response, RESP_BUF_SIZE, "RPRT 0\n");
 }
 
-void CEasyCommHandler::handle_az_el_command(CEncoderAxis* axis, char* command, char* response)
+void CEasyCommHandler::handle_az_el_command(CEncoderAxis* axis, const CEncoderAxis::SSnapshot& state,
+                                            SPositionText& text, char* command, char* response)
 {
   size_t len = strnlen(command, COMM_BUF_SIZE);
 
   if (len == 3)
   {
     // If the command is two bytes long get current position
-    char num_string[MAX_NUMBER_STRING_SIZE];
-    int32_t cur_pos = axis->get_current_position();
-    if (CEasyCommHandler::number_to_string(cur_pos, num_string))
+    const SPositionText& position = CEasyCommHandler::position_text(state, text);
+    if (position.len > 0)
     {
-      snprintf(response, RESP_BUF_SIZE, "%c%c%s%c", command[0], command[1], num_string, command[2]);
-      Serial.println(response);
+      response[0] = command[0];
+      response[1] = command[1];
+      memcpy(&(response[2]), position.text, position.len);
+      response[position.len + 2] = command[2];
+      response[position.len + 3] = '\0';
     }
   }
   else
@@ -130,62 +341,369 @@ void CEasyCommHandler::handle_az_el_command(CEncoderAxis* axis, char* command, c
     command[len-1] = '\0';
     if (CEasyCommHandler::string_to_number(&(command[2]), number))
     {
-      Serial.print("Moving to position ");
-      Serial.println(number);
+      LOG_DEBUG("moving to position %ld", (long)number);
+      CEasyCommHandler::stop_tracking();
       axis->move_to_position(number);
     }
   }
 }
 
-bool CEasyCommHandler::string_to_number(char* string, int32_t& number)
+void CEasyCommHandler::handle_get_status_command(char* command, char* response)
 {
-  size_t len = strnlen(string, MAX_NUMBER_STRING_SIZE);
+  snprintf(response, RESP_BUF_SIZE, "GS%d%c", CEasyCommHandler::get_status(), command[2]);
+}
 
-  // if the length is at max, something is wrong with the string
-  if (len >= MAX_NUMBER_STRING_SIZE)
+uint8_t CEasyCommHandler::get_status()
+{
+  uint8_t status = 0;
+
+  if (mAzimuthState.homing || mElevationState.homing)
+    status |= STATUS_HOMING;
+
+  if (mAzimuthState.motor_state == CEncoderAxis::EMotorStateStopped &&
+      mElevationState.motor_state == CEncoderAxis::EMotorStateStopped)
+    status |= STATUS_IDLE;
+  else
+    status |= STATUS_MOVING;
+  return status;
+}
+
+// Learned coast distances: azimuth positive, negative, elevation positive, negative
+void CEasyCommHandler::handle_get_coast_command(char* /*command*/, char* response)
+{
+  int32_t coast[4] =
   {
-    Serial.println("ERR source number string too long");
-    return false;
+    mAzimuthAxis->get_coast(1),
+    mAzimuthAxis->get_coast(-1),
+    mElevationAxis->get_coast(1),
+    mElevationAxis->get_coast(-1),
+  };
+
+  size_t len = snprintf(response, RESP_BUF_SIZE, "GC");
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    len += CDecimalCodec::format(coast[i], POSITION_DECIMALS, &(response[len]), RESP_BUF_SIZE - len - 1);
+    response[len++] = i < 3 ? ' ' : '\n';
   }
+  response[len] = '\0';
+}
 
-  // Assumption: number has a dot and one decimal at the end. If not, something is wrong
-  if (string[len-2] != '.')
+// Log statistics: "GL<dropped lines> <buffered bytes>"
+void CEasyCommHandler::handle_get_log_command(char* /*command*/, char* response)
+{
+  snprintf(response, RESP_BUF_SIZE, "GL%lu %lu\n",
+    static_cast<unsigned long>(CLog::get_dropped()), static_cast<unsigned long>(CLog::get_buffered()));
+}
+
+void CEasyCommHandler::handle_get_perf_command(char* command, char* response)
+{
+#ifdef USE_PERF_COUNTERS
+  // GP followed by the section, loop periods by default
+  char section = command[2] >= 'A' && command[2] <= 'Z' ? command[2] : 'L';
+  if (strchr(PERF_SECTIONS, section) == NULL)
   {
-    Serial.println("ERR No dot found in number");
-    return false;
+    snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+    return;
   }
+  size_t len = snprintf(response, RESP_BUF_SIZE, "GP%c", section);
+  len += CPerfCounters::format_section(section, &(response[len]), RESP_BUF_SIZE - len - 1);
+  response[len++] = '\n';
+  response[len] = '\0';
+#else
+  (void)command;
+  snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+#endif
+}
 
-  // Remove dot between last two chars, shrinking string size by one
-  string[len-2] = string[len-1];
-  string[len-1] = '\0';
+// DT<sequence> returns the trace records from that one on as
+// "DT<first sequence> <hex>", no records once it is caught up
+void CEasyCommHandler::handle_dump_trace_command(char* command, char* response)
+{
+#ifdef USE_MOTION_TRACE
+  const char* it = &(command[2]);
+  int32_t sequence = 0;
+  if (!CEasyCommHandler::parse_next_number(it, 0, sequence) || sequence < 0)
+    sequence = 0;
 
-  number = static_cast<int32_t>(atol(string));
-  //Serial.write("DBG succesfully parsed string to number: ");
-  //Serial.print(number);
-  //Serial.write("\n");
-  return true;
+  uint32_t first = sequence;
+  char records[2 * 8 * TRACE_DUMP_RECORDS + 1];
+  CMotionTrace::dump(first, TRACE_DUMP_RECORDS, records, sizeof(records));
+  snprintf(response, RESP_BUF_SIZE, "DT%lu %s\n", static_cast<unsigned long>(first), records);
+#else
+  (void)command;
+  snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+#endif
+}
+
+// Scheduler task statistics: name:overruns/max runtime in us per task
+void CEasyCommHandler::handle_get_tasks_command(char* /*command*/, char* response)
+{
+  size_t len = snprintf(response, RESP_BUF_SIZE, "GT");
+  for (uint8_t i = 0; i < CScheduler::task_count() && len < RESP_BUF_SIZE - 1; i++)
+  {
+    const CScheduler::STaskStats& stats = CScheduler::get_stats(i);
+    len += snprintf(&(response[len]), RESP_BUF_SIZE - len - 1, "%s%s:%lu/%lu",
+      i > 0 ? " " : "", stats.name,
+      static_cast<unsigned long>(stats.overruns), static_cast<unsigned long>(stats.max_runtime));
+  }
+  if (len > RESP_BUF_SIZE - 2)
+    len = RESP_BUF_SIZE - 2;
+  response[len++] = '\n';
+  response[len] = '\0';
 }
 
-bool CEasyCommHandler::number_to_string(int32_t& number, char* string)
+// Trajectory extension, with USE_TRAJECTORY:
+//   TS<unix time>       set the clock, seconds
+//   TB<unix time>       base time of the waypoints, clears the queue
+//   TA<time> <az> <el>  add a waypoint, time in seconds since the base
+//   TC                  clear the queue
+//   TQ                  query queued waypoints and capacity
+void CEasyCommHandler::handle_trajectory_command(char* command, char* response)
 {
-  snprintf(string, MAX_NUMBER_STRING_SIZE, "%02ld", static_cast<long int>(number));
+#ifdef USE_TRAJECTORY
+  const char* it = &(command[2]);
+  int32_t time = 0;
+  int32_t az_pos = 0;
+  int32_t el_pos = 0;
+  int result = 0;
+
+  switch (command[1])
+  {
+    case 'S':
+      if (!CEasyCommHandler::parse_next_number(it, 0, time) || time < 0)
+        result = RPRT_INVALID;
+      else
+        CWallClock::set(static_cast<uint32_t>(time), 0);
+      break;
+    case 'B':
+#ifdef USE_SAT_TRACKING
+      CSatTracker::stop();
+#endif
+      if (!CEasyCommHandler::parse_next_number(it, 0, time) || time < 0)
+        result = RPRT_INVALID;
+      else
+        CTrajectory::set_base(static_cast<uint32_t>(time));
+      break;
+    case 'A':
+#ifdef USE_SAT_TRACKING
+      CSatTracker::stop();
+#endif
+      if (!CEasyCommHandler::parse_next_number(it, TIME_DECIMALS, time) ||
+          !CEasyCommHandler::parse_next_number(it, POSITION_DECIMALS, az_pos) ||
+          !CEasyCommHandler::parse_next_number(it, POSITION_DECIMALS, el_pos))
+      {
+        LOG_WARN("invalid waypoint");
+        result = RPRT_INVALID;
+      }
+      else if (!CTrajectory::add(time, az_pos, el_pos))
+      {
+        LOG_WARN("waypoint queue full or out of order");
+        result = RPRT_REJECTED;
+      }
+      break;
+    case 'C':
+      CEasyCommHandler::stop_tracking();
+      break;
+    case 'Q':
+      snprintf(response, RESP_BUF_SIZE, "TQ%d %d\n", CTrajectory::size(), TRAJECTORY_SIZE);
+      return;
+    default:
+      result = RPRT_INVALID;
+      break;
+  }
 
-  size_t len = strnlen(string, MAX_NUMBER_STRING_SIZE);
+  snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", result);
+#else
+  (void)command;
+  snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+#endif
+}
+
+// Satellite tracking extension, with USE_SAT_TRACKING:
+//   O1 <TLE line 1>         first line of the element set
+//   O2 <TLE line 2>         second line
+//   OS<lat> <lon> <alt>     station, degrees and m above the ellipsoid
+//   OT                      start tracking, needs the TLE, station and clock
+//   OX                      stop tracking
+//   OQ                      query the current look angles
+void CEasyCommHandler::handle_orbit_command(char* command, char* response)
+{
+#ifdef USE_SAT_TRACKING
+  const char* it = &(command[2]);
+  int32_t latitude = 0;
+  int32_t longitude = 0;
+  int32_t altitude = 0;
+  int32_t az_pos = 0;
+  int32_t el_pos = 0;
+  int result = 0;
 
-  // if the length is at max, something is wrong with the string
-  if (len >= MAX_NUMBER_STRING_SIZE)
+  switch (command[1])
   {
-    Serial.write("ERR destination number string too long\n");
-    return false;
+    case '1':
+    case '2':
+      if (command[2] != ' ' || !CSatTracker::set_tle_line(command[1] - '0', &(command[3])))
+      {
+        LOG_WARN("invalid TLE line");
+        result = RPRT_INVALID;
+      }
+      break;
+    case 'S':
+      if (!CEasyCommHandler::parse_next_number(it, STATION_DECIMALS, latitude) ||
+          !CEasyCommHandler::parse_next_number(it, STATION_DECIMALS, longitude) ||
+          !CEasyCommHandler::parse_next_number(it, 0, altitude))
+        result = RPRT_INVALID;
+      else
+        CSatTracker::set_station(latitude, longitude, altitude);
+      break;
+    case 'T':
+      if (mAzimuthAxis->is_homing() || mElevationAxis->is_homing() || !CSatTracker::start())
+        result = RPRT_REJECTED;
+      break;
+    case 'X':
+      CEasyCommHandler::stop_tracking();
+      break;
+    case 'Q':
+      if (CSatTracker::get_look_angles(az_pos, el_pos))
+      {
+        size_t len = snprintf(response, RESP_BUF_SIZE, "OQ");
+        len += CDecimalCodec::format(az_pos, POSITION_DECIMALS, &(response[len]), RESP_BUF_SIZE - len - 1);
+        response[len++] = ' ';
+        len += CDecimalCodec::format(el_pos, POSITION_DECIMALS, &(response[len]), RESP_BUF_SIZE - len - 1);
+        response[len++] = '\n';
+        response[len] = '\0';
+        return;
+      }
+      result = RPRT_REJECTED;
+      break;
+    default:
+      result = RPRT_INVALID;
+      break;
+  }
+
+  snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", result);
+#else
+  (void)command;
+  snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+#endif
+}
+
+// Subscription extension, per connection:
+//   SU[<delta> [<interval>]]  push "AZ<az> EL<el> GS<status>" when an axis moved
+//                             by delta deg (0.1 by default) or the status
+//                             changed, at most every interval ms (100 by default)
+//   UN                        stop pushing
+void CEasyCommHandler::handle_subscribe_command(char* command, char* response)
+{
+  const char* it = &(command[2]);
+  int32_t delta = PUSH_DELTA;
+  int32_t interval = PUSH_INTERVAL;
+
+  while (*it == ' ')
+    it++;
+  if (*it != '\0' && *it != '\n' && *it != '\r')
+  {
+    if (!CEasyCommHandler::parse_next_number(it, POSITION_DECIMALS, delta) || delta <= 0)
+    {
+      snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+      return;
+    }
+    while (*it == ' ')
+      it++;
+    if (*it != '\0' && *it != '\n' && *it != '\r' &&
+        (!CEasyCommHandler::parse_next_number(it, 0, interval) || interval < 0 || interval > 0xffff))
+    {
+      snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_INVALID);
+      return;
+    }
+  }
+
+  // Only a connection can subscribe
+  if (mSession == NULL)
+  {
+    snprintf(response, RESP_BUF_SIZE, "RPRT %d\n", RPRT_REJECTED);
+    return;
   }
 
-  // Add dot between last two chars, extending string size by one
-  string[len] = string[len-1];
-  string[len-1] = '.';
-  string[len+1] = '\0';
+  mSession->mSubscribed = true;
+  mSession->mPushDelta = delta;
+  mSession->mPushInterval = static_cast<uint16_t>(interval);
+  // The current state goes out right away, no status is 0
+  mSession->mLastPush = millis() - mSession->mPushInterval;
+  mSession->mPushedStatus = 0;
+  snprintf(response, RESP_BUF_SIZE, "RPRT 0\n");
+}
+
+void CEasyCommHandler::handle_unsubscribe_command(char* /*command*/, char* response)
+{
+  if (mSession != NULL)
+    mSession->mSubscribed = false;
+  snprintf(response, RESP_BUF_SIZE, "RPRT 0\n");
+}
+
+// Renders the push of a subscribed session when one is due, from the
+// snapshots of the last update()
+bool CEasyCommHandler::render_push(CEasyCommSession& session, char* response)
+{
+  uint32_t now = millis();
+  if (now - session.mLastPush < session.mPushInterval)
+    return false;
+
+  uint8_t status = CEasyCommHandler::get_status();
+  int32_t az_moved = mAzimuthState.position - session.mPushedAzimuth;
+  int32_t el_moved = mElevationState.position - session.mPushedElevation;
+  if (status == session.mPushedStatus &&
+      az_moved < session.mPushDelta && -az_moved < session.mPushDelta &&
+      el_moved < session.mPushDelta && -el_moved < session.mPushDelta)
+    return false;
+
+  const SPositionText& az_text = CEasyCommHandler::position_text(mAzimuthState, mAzimuthText);
+  const SPositionText& el_text = CEasyCommHandler::position_text(mElevationState, mElevationText);
+  snprintf(response, RESP_BUF_SIZE, "AZ%s EL%s GS%d\n", az_text.text, el_text.text, status);
+
+  session.mLastPush = now;
+  session.mPushedAzimuth = mAzimuthState.position;
+  session.mPushedElevation = mElevationState.position;
+  session.mPushedStatus = status;
+  return true;
+}
+
+// Manual control ends trajectory and satellite tracking
+void CEasyCommHandler::stop_tracking()
+{
+#ifdef USE_SAT_TRACKING
+  CSatTracker::stop();
+#endif
+#ifdef USE_TRAJECTORY
+  CTrajectory::clear();
+#endif
+}
 
-  //Serial.write("DBG succesfully parsed number into string: ");
-  //Serial.write(string);
-  //Serial.write("\n");
+bool CEasyCommHandler::string_to_number(const char* string, int32_t& number)
+{
+  const char* end = NULL;
+  CDecimalCodec::EResult result = CDecimalCodec::parse(string, POSITION_DECIMALS, number, &end);
+
+  if (result == CDecimalCodec::EResultNoDigits)
+  {
+    LOG_WARN("no number found");
+    return false;
+  }
+  if (result == CDecimalCodec::EResultOverflow)
+  {
+    LOG_WARN("number out of range");
+    return false;
+  }
+  if (*end != '\0')
+  {
+    LOG_WARN("trailing characters after number");
+    return false;
+  }
   return true;
 }
+
+bool CEasyCommHandler::parse_next_number(const char*& it, uint8_t decimals, int32_t& number)
+{
+  while (*it == ' ')
+    it++;
+  return CDecimalCodec::parse(it, decimals, number, &it) == CDecimalCodec::EResultOk;
+}
@@ -1,66 +1,220 @@
 #pragma once
 
+#include "decimal_codec.h"
 #include "encoder_axis.h"
+#include "log.h"
+#include "perf_counters.h"
+#include "string.h"
 
+// The nano takes no TLE lines and has one connection to buffer for
+#ifdef ARDUINO_ARCH_AVR
+#define COMM_BUF_SIZE 64
+#define RESP_BUF_SIZE 80
+#define OUT_BUF_SIZE  80
+#else
 #define COMM_BUF_SIZE 128
 #define RESP_BUF_SIZE 128
+#define OUT_BUF_SIZE  128
+#endif
 
+// Maximum number of complete commands handled per call of handle_commands,
+// bounds the time spent in one loop iteration. Set to 1 to handle only one
+// command per loop iteration.
+#define COMM_MAX_COMMANDS_PER_CALL 16
+
+// Receive and transmit state of one EasyComm connection
+class CEasyCommSession
+{
+public:
+  CEasyCommSession() : mCommandLen(0), mOutputLen(0), mSubscribed(false) {}
+  void reset() { mCommandLen = 0; mOutputLen = 0; mSubscribed = false; }
+
+private:
+  friend class CEasyCommHandler;
+
+  char   mCommand[COMM_BUF_SIZE];
+  size_t mCommandLen;
+  char   mOutput[OUT_BUF_SIZE];
+  size_t mOutputLen;
+
+  // Position pushes after SU, see handle_subscribe_command()
+  bool     mSubscribed;
+  int32_t  mPushDelta;    // 1e-1 deg
+  uint16_t mPushInterval; // ms
+  uint32_t mLastPush;     // ms
+  int32_t  mPushedAzimuth;
+  int32_t  mPushedElevation;
+  uint8_t  mPushedStatus;
+};
 
 class CEasyCommHandler
 {
 public:
 
 template<class T>
-static void handle_commands(T client)
+static void handle_commands(T& client, CEasyCommSession& session)
 {
-  static char   command [COMM_BUF_SIZE];
-  static char   response[RESP_BUF_SIZE];
-  static size_t it = 0;
+  // Don't accept new commands while the client hasn't taken earlier responses
+  if (!CEasyCommHandler::flush_output(client, session))
+  {
+    return;
+  }
 
-  bool complete_command_received = false;
+  // Subscribe commands act on the session of the line
+  mSession = &session;
 
-  while (client.available())
+  uint8_t handled_commands = 0;
+
+  while (client.available() && handled_commands < COMM_MAX_COMMANDS_PER_CALL)
   {
-    if (it == COMM_BUF_SIZE-2)
+    if (session.mCommandLen == COMM_BUF_SIZE-2)
     {
-      Serial.println("ERR buffer is full");
-      it = 0;
+      LOG_WARN("command buffer is full");
+      session.mCommandLen = 0;
       break;
     }
 
     char recv_char = client.read();
-    command[it++] = recv_char;
+    session.mCommand[session.mCommandLen++] = recv_char;
 
     if (recv_char == '\n' || recv_char == '\r'/* || recv_char == ' '*/)
     {
-      if (it > 1)
+      if (session.mCommandLen > 1)
       {
-        command[it] = '\0';
-        complete_command_received = true;
+        session.mCommand[session.mCommandLen] = '\0';
+
+        // Any number of space separated commands per line, their responses
+        // are queued and written at once
+        char* it = session.mCommand;
+        while (CEasyCommHandler::handle_next_command(it, mResponse))
+        {
+          handled_commands++;
+          CEasyCommHandler::queue_response(client, session);
+        }
+
+        // Queries echo their separator, "AZ EL \n" is answered as
+        // "AZ12.3 EL45.6\n" like hamlib expects
+        if (session.mOutputLen > 0 && session.mOutput[session.mOutputLen - 1] == ' ')
+        {
+          session.mOutput[session.mOutputLen - 1] = recv_char;
+        }
       }
-      it = 0;
-      break;
+      // Keep reading, a partial command stays in the buffer until the next call
+      session.mCommandLen = 0;
     }
   }
+  mSession = NULL;
 
-  if (complete_command_received)
+  // Pushes go out between lines, never within the responses of one
+  if (session.mSubscribed && CEasyCommHandler::render_push(session, mResponse))
   {
-      CEasyCommHandler::handle_command(command, response);
-      client.write(response);
+    CEasyCommHandler::queue_response(client, session);
   }
+
+  CEasyCommHandler::flush_output(client, session);
 }
 
   static void begin(CEncoderAxis& azimuth_axis, CEncoderAxis& elevation_axis);
 
+  // Handle every command of a request of one or more lines, each ending in a
+  // line terminator, outside of a session. Returns the length of the
+  // aggregated responses in output, which is NUL terminated.
+  static size_t handle_request(char* request, char* output, size_t size);
+
+  // Take the axis snapshots used to answer the queries of all connections,
+  // call once per loop iteration
+  static void update(const CEncoderAxis::SSnapshot& azimuth, const CEncoderAxis::SSnapshot& elevation);
+
 private:
+  // Position of an axis as formatted for the responses, rendered again only
+  // when the generation of the snapshot changed
+  struct SPositionText
+  {
+    uint16_t generation;
+    bool valid;
+    uint8_t len;
+    char text[DECIMAL_STRING_SIZE];
+  };
+
+  friend class CEasyCommBench;
+  friend class CReplay;
+
   static CEncoderAxis* mAzimuthAxis;
   static CEncoderAxis* mElevationAxis;
+  static CEncoderAxis::SSnapshot mAzimuthState;
+  static CEncoderAxis::SSnapshot mElevationState;
+  static SPositionText mAzimuthText;
+  static SPositionText mElevationText;
+  static char mResponse[RESP_BUF_SIZE];
+  static CEasyCommSession* mSession;
+
+  typedef void (*command_handler_t)(char* command, char* response);
+  friend struct SEasyCommCommands;
+
+  // Append mResponse to the queued output
+  template<class T>
+  static void queue_response(T& client, CEasyCommSession& session)
+  {
+    size_t resp_len = strnlen(mResponse, RESP_BUF_SIZE);
+    if (session.mOutputLen + resp_len > OUT_BUF_SIZE)
+    {
+      CEasyCommHandler::flush_output(client, session);
+    }
+    if (session.mOutputLen + resp_len > OUT_BUF_SIZE)
+    {
+      LOG_WARN("output buffer is full");
+    }
+    else
+    {
+      memcpy(&(session.mOutput[session.mOutputLen]), mResponse, resp_len);
+      session.mOutputLen += resp_len;
+    }
+  }
+
+  // Write queued output, returns whether everything was written
+  template<class T>
+  static bool flush_output(T& client, CEasyCommSession& session)
+  {
+    if (session.mOutputLen > 0)
+    {
+      size_t written = client.write(reinterpret_cast<const uint8_t*>(session.mOutput), session.mOutputLen);
+      if (written > session.mOutputLen)
+      {
+        written = session.mOutputLen;
+      }
+      session.mOutputLen -= written;
+      memmove(session.mOutput, &(session.mOutput[written]), session.mOutputLen);
+    }
+    return session.mOutputLen == 0;
+  }
 
   CEasyCommHandler() {}
+  static bool handle_next_command(char*& it, char* response);
   static void handle_command(char* command, char* response);
+  static command_handler_t find_command(const char* command, uint8_t& flags);
+  static void handle_az_command(char* command, char* response);
+  static void handle_el_command(char* command, char* response);
+  static void handle_version_command(char* command, char* response);
+  static void handle_move_command(char* command, char* response);
+  static void handle_stop_command(char* command, char* response);
+  static void handle_subscribe_command(char* command, char* response);
+  static void handle_unsubscribe_command(char* command, char* response);
+  static bool render_push(CEasyCommSession& session, char* response);
+  static uint8_t get_status();
   static void handle_get_pos_command(char* command, char* response);
   static void handle_set_pos_command(char* command, char* response);
-  static void handle_az_el_command(CEncoderAxis* axis, char* command, char* response);
-  static bool string_to_number(char* string, int32_t& number);
-  static bool number_to_string(int32_t& number, char* string);
+  static void handle_get_status_command(char* command, char* response);
+  static void handle_get_coast_command(char* command, char* response);
+  static void handle_get_tasks_command(char* command, char* response);
+  static void handle_get_log_command(char* command, char* response);
+  static void handle_get_perf_command(char* command, char* response);
+  static void handle_dump_trace_command(char* command, char* response);
+  static void handle_trajectory_command(char* command, char* response);
+  static void handle_orbit_command(char* command, char* response);
+  static void stop_tracking();
+  static void handle_az_el_command(CEncoderAxis* axis, const CEncoderAxis::SSnapshot& state, SPositionText& text,
+                                   char* command, char* response);
+  static const SPositionText& position_text(const CEncoderAxis::SSnapshot& state, SPositionText& text);
+  static bool string_to_number(const char* string, int32_t& number);
+  static bool parse_next_number(const char*& it, uint8_t decimals, int32_t& number);
 };
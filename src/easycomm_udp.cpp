@@ -0,0 +1,87 @@
+#include "Arduino.h"
+#include "easycomm_udp.h"
+#include "easycomm_handler.h"
+#include "log.h"
+#include "string.h"
+
+char CEasyCommUdp::mRequest[UDP_REQUEST_SIZE];
+char CEasyCommUdp::mReply[UDP_REPLY_SIZE];
+CEasyCommUdp::SCachedReply CEasyCommUdp::mCache[UDP_REPLY_CACHE_SIZE];
+uint8_t CEasyCommUdp::mNextCacheSlot = 0;
+
+// "#<digits>" followed by a space or the line end, the sequence number is a
+// plain unsigned integer without sign, fraction or exponent
+bool CEasyCommUdp::parse_sequence(char*& it, int32_t& sequence)
+{
+  char* digit = it + 1;
+  int32_t value = 0;
+  for (; *digit >= '0' && *digit <= '9'; digit++)
+  {
+    if (value > (0x7FFFFFFFL - (*digit - '0')) / 10)
+      return false;
+    value = value * 10 + (*digit - '0');
+  }
+  if (digit == it + 1 || (*digit != ' ' && *digit != '\n' && *digit != '\r'))
+    return false;
+
+  sequence = value;
+  it = digit;
+  return true;
+}
+
+size_t CEasyCommUdp::handle_request(uint32_t address, uint16_t port, size_t len)
+{
+  // The handlers expect every command line to end in a terminator
+  if (mRequest[len - 1] != '\n' && mRequest[len - 1] != '\r')
+    mRequest[len++] = '\n';
+  mRequest[len] = '\0';
+
+  char* it = mRequest;
+  int32_t sequence = -1;
+  if (*it == '#')
+  {
+    if (!CEasyCommUdp::parse_sequence(it, sequence))
+    {
+      LOG_WARN("invalid sequence number");
+      return snprintf(mReply, UDP_REPLY_SIZE, "RPRT -1\n");
+    }
+  }
+
+  // A retransmission gets the reply of the original
+  SCachedReply* cached = NULL;
+  for (uint8_t i = 0; i < UDP_REPLY_CACHE_SIZE && sequence >= 0; i++)
+  {
+    if (mCache[i].len > 0 && mCache[i].address == address && mCache[i].port == port)
+    {
+      cached = &(mCache[i]);
+      if (cached->sequence == sequence)
+      {
+        memcpy(mReply, cached->reply, cached->len);
+        return cached->len;
+      }
+    }
+  }
+
+  size_t reply_len = 0;
+  if (sequence >= 0)
+    reply_len = snprintf(mReply, UDP_REPLY_SIZE, "#%ld ", static_cast<long>(sequence));
+  reply_len += CEasyCommHandler::handle_request(it, &(mReply[reply_len]), UDP_REPLY_SIZE - reply_len);
+  if (sequence < 0)
+    return reply_len;
+
+  // Nothing but the sequence number acknowledges the request
+  if (mReply[reply_len - 1] == ' ')
+    mReply[reply_len - 1] = '\n';
+
+  if (cached == NULL)
+  {
+    cached = &(mCache[mNextCacheSlot]);
+    mNextCacheSlot = (mNextCacheSlot + 1) % UDP_REPLY_CACHE_SIZE;
+  }
+  cached->address = address;
+  cached->port = port;
+  cached->sequence = sequence;
+  cached->len = reply_len;
+  memcpy(cached->reply, mReply, reply_len);
+  return reply_len;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Datagram sizes; a request holds one or more command lines
+#define UDP_REQUEST_SIZE 128
+#define UDP_REPLY_SIZE   192
+
+// Maximum number of datagrams handled per call of handle_datagrams
+#define UDP_MAX_DATAGRAMS_PER_CALL 4
+
+// Replies kept for retransmitted requests, one per peer
+#define UDP_REPLY_CACHE_SIZE 4
+
+// EasyComm over UDP, next to the TCP server. Every datagram is a request of
+// one or more commands, answered by one datagram with all their responses.
+// A request may start with a sequence number, "#<seq> ", which then starts the
+// reply and makes the request idempotent: the same sequence number from the
+// same peer again gets the reply of the first one without running its
+// commands twice, so a client can retry a P whose reply got lost. Requests
+// with a sequence number are always answered, without one only when there is
+// a response.
+class CEasyCommUdp
+{
+public:
+  // U has the interface of WiFiUDP
+  template<class U>
+  static void handle_datagrams(U& udp)
+  {
+    for (uint8_t i = 0; i < UDP_MAX_DATAGRAMS_PER_CALL && udp.parsePacket() > 0; i++)
+    {
+      int len = udp.read(reinterpret_cast<uint8_t*>(mRequest), UDP_REQUEST_SIZE - 2);
+      if (len <= 0)
+      {
+        continue;
+      }
+
+      size_t reply_len = CEasyCommUdp::handle_request(udp.remoteIP(), udp.remotePort(), len);
+      if (reply_len > 0)
+      {
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write(reinterpret_cast<const uint8_t*>(mReply), reply_len);
+        udp.endPacket();
+      }
+    }
+  }
+
+private:
+  friend class CEasyCommUdpTest;
+
+  struct SCachedReply
+  {
+    uint32_t address;
+    uint16_t port;
+    int32_t sequence;
+    size_t len;
+    char reply[UDP_REPLY_SIZE];
+  };
+
+  CEasyCommUdp() {}
+
+  // Handle the request of len bytes in mRequest, returns the reply length
+  static size_t handle_request(uint32_t address, uint16_t port, size_t len);
+  static bool parse_sequence(char*& it, int32_t& sequence);
+
+  static char mRequest[UDP_REQUEST_SIZE];
+  static char mReply[UDP_REPLY_SIZE];
+  static SCachedReply mCache[UDP_REPLY_CACHE_SIZE];
+  static uint8_t mNextCacheSlot;
+};
@@ -1,76 +1,138 @@
 #include "Arduino.h"
 #include "encoder_axis.h"
-
-// 300 [rot/min] * (20*2) [transitions] / 60 [sec/min] = 200 [transitions/second]
-// 1000 [ms] / 200 [transitions/second] = 5 [ms/transition]
-#define ENC_DEAD_TIME 2 // ms
+#include "motion_trace.h"
 
 // 7.5 deg/s / 5 rot/s / 20*2 trans/rot = 0.0375 deg/trans = 375 * 1e-4 deg/trans
+// In quadrature both channels of the same disk give 20*4 trans/rot, half that.
+#ifndef INCR_PER_COUNT
 #define INCR_PER_COUNT 375 // 1e-4 deg
+#endif
+
+#ifdef ENC_QUADRATURE
+// Forward is 00 -> 01 -> 11 -> 10
+const int8_t CEncoderAxis::mQuadTable[16] =
+{
+   0,  1, -1, QUAD_INVALID,
+  -1,  0, QUAD_INVALID,  1,
+   1, QUAD_INVALID,  0, -1,
+  QUAD_INVALID, -1,  1,  0,
+};
+#endif
 
+#ifndef ANGLE_HYSTERESIS
 #define ANGLE_HYSTERESIS 5000 // 1e-4 deg
+#endif
 
 // external (1e-1 deg) to internal (1e-4 deg) scaling factor
-#define EXT_TO_INT_FACTOR 1e3
+#define EXT_TO_INT_FACTOR 1000L
 
 #define STOPPING_TIME 500L //ms
-#define HOMING_CHECK_TIME 500 // ms
+#define STOPPING_TIME_US (STOPPING_TIME * 1000L)
 #define HOMING_TIMEOUT 60*1000L // ms
 #define HOMING_POSITION 0 // [1/10 deg]
 
+// Weight of a new coast measurement in the learned value, 1 / (1 << shift)
+#define COAST_AVERAGE_SHIFT 2
+// Coasting further than this is taken as a measurement error
+#define COAST_MAX 100000 // 1e-4 deg
+
+#ifdef ENC_QUADRATURE
+CEncoderAxis::CEncoderAxis(uint8_t enc_pin_a, uint8_t enc_pin_b, uint8_t mot_pos_pin, uint8_t mot_neg_pin) :
+#else
 CEncoderAxis::CEncoderAxis(uint8_t enc_pin, uint8_t mot_pos_pin, uint8_t mot_neg_pin) :
+#endif
   mMotCurState(CEncoderAxis::EMotorStateStopped),
   mMotReqState(CEncoderAxis::EMotorStateStopped),
+  mHomingState(CEncoderAxis::EHomingStateIdle),
+  mCalibrated(false),
+  mHomingDueTime(0),
+  mEncEvents(),
   mEncLastChange(0),
+  mEncLostSum(0),
+  mEncLostSumSeen(0),
+  mEncOverflowSeen(0),
+  mEncLastDirection(0),
+  mEncLastEdge(0),
+  mEncMoving(false),
+  mEncInterval(0),
+  mLastMotionTime(0),
+  mPulseStats(),
   mEncAngleAct(),
+  mPositionGeneration(0),
   mEncAngleSet(0),
   mTransitionDueTime(0),
+#ifdef ENC_QUADRATURE
+  mEncPin(enc_pin_a),
+  mEncPinB(enc_pin_b),
+  mEncQuadState(0),
+  mEncInvalidSum(0),
+  mEncInvalidSeen(0),
+  mEncCount(0),
+#else
   mEncPin(enc_pin),
+#endif
   mMotPosPin(mot_pos_pin),
   mMotNegPin(mot_neg_pin),
-  mStopAtSetpoint(true)
+  mStopAtSetpoint(true),
+  mCoastStartAngle(0),
+  mCoastStartSpeed(0),
+  mCoastMeasuring(false),
+  mCoastCompensation(true),
+  mRelayWriter(NULL),
+#ifdef USE_PERF_COUNTERS
+  mIsrCount(0),
+  mIsrRejected(0),
+  mRelayTransitions(0),
+#endif
+  mSnapshot()
 {
+  mCoast[0] = mCoast[1] = 0;
+  mCoastSpeed[0] = mCoastSpeed[1] = 0;
 }
 
 void CEncoderAxis::begin()
 {
   pinMode(mEncPin, INPUT);
+#ifdef ENC_QUADRATURE
+  pinMode(mEncPinB, INPUT);
+  mEncQuadState = (digitalRead(mEncPin) << 1) | digitalRead(mEncPinB);
+#endif
   digitalWrite(mMotPosPin, CEncoderAxis::ERelayStateOff);
   pinMode(mMotPosPin, OUTPUT);
   digitalWrite(mMotNegPin, CEncoderAxis::ERelayStateOff);
   pinMode(mMotNegPin, OUTPUT);
 }
 
+#ifdef ENC_QUADRATURE
 void CEncoderAxis::enc_interrupt()
 {
-  uint32_t cur_time = millis();
-
-  if (cur_time > (mEncLastChange + ENC_DEAD_TIME))
-  {
-    // valid encoder transition
-    if (mMotCurState == CEncoderAxis::EMotorStateRunningPos || mMotCurState == CEncoderAxis::EMotorStateStoppingPos)
-    {
-      mEncAngleAct += INCR_PER_COUNT;
-    }
-    if (mMotCurState == CEncoderAxis::EMotorStateRunningNeg || mMotCurState == CEncoderAxis::EMotorStateStoppingNeg)
-    {
-      mEncAngleAct -= INCR_PER_COUNT;
-    }
-    mEncLastChange = cur_time;
-  }
-  return;
+  enc_edge(micros(), (digitalRead(mEncPin) << 1) | digitalRead(mEncPinB));
+}
+#else
+void CEncoderAxis::enc_interrupt()
+{
+  enc_edge(micros());
 }
+#endif
 
 void CEncoderAxis::enc_reset()
 {
+  uint32_t cur_time = micros();
   noInterrupts();
-  mEncLastChange = millis() - ENC_DEAD_TIME;
+  mEncLastChange = cur_time - ENC_DEAD_TIME - 1;
   interrupts();
+  mLastMotionTime = cur_time;
 }
 
 void CEncoderAxis::move_to_position(int32_t setpoint)
 {
+  // Position is unknown until homing finishes
+  if (is_homing())
+    return;
+
   mStopAtSetpoint = true;
+  if (setpoint * EXT_TO_INT_FACTOR != mEncAngleSet)
+    TRACE_SETPOINT(this, setpoint);
   mEncAngleSet = setpoint * EXT_TO_INT_FACTOR;
   if (mEncAngleSet > mEncAngleAct + ANGLE_HYSTERESIS)
   {
@@ -84,22 +146,31 @@ void CEncoderAxis::move_to_position(int32_t setpoint)
   {
     motor_request_state(CEncoderAxis::EMotorStateStopped);
   }
+  publish_snapshot();
 }
 
 void CEncoderAxis::move_positive()
 {
+  if (is_homing())
+    return;
+
   mStopAtSetpoint = false;
   motor_request_state(CEncoderAxis::EMotorStateRunningPos);
 }
 
 void CEncoderAxis::move_negative()
 {
+  if (is_homing())
+    return;
+
   mStopAtSetpoint = false;
   motor_request_state(CEncoderAxis::EMotorStateRunningNeg);
 }
 
 void CEncoderAxis::stop_moving()
 {
+  // Stopping aborts homing, the position stays as it is and uncalibrated
+  mHomingState = CEncoderAxis::EHomingStateIdle;
   mStopAtSetpoint = true;
   motor_request_state(CEncoderAxis::EMotorStateStopped);
 }
@@ -118,19 +189,96 @@ int32_t CEncoderAxis::get_current_position()
 void CEncoderAxis::set_current_position(int32_t position)
 {
   mEncAngleAct = position * EXT_TO_INT_FACTOR;
-  //Serial.write("DBG cur pos set to");
-  //Serial.print(mEncAngleAct);
-  //Serial.write("\n");
+  mPositionGeneration++;
+  mCalibrated = true;
+  publish_snapshot();
+}
+
+// Take the encoder edges from the interrupt handler into the position and
+// pulse statistics
+void CEncoderAxis::process_enc_events()
+{
+  int32_t angle = mEncAngleAct;
+  SEncEvent event;
+  while (mEncEvents.pop(event))
+  {
+    mEncAngleAct += count_increment(event.direction);
+    if (event.direction != 0)
+      mPulseStats.edges++;
+    TRACE_EDGE(this, event.time, event.direction, mEncAngleAct / EXT_TO_INT_FACTOR);
+
+    // Only intervals within one movement say something about the speed
+    uint32_t interval = event.time - mEncLastEdge;
+    if (mEncMoving && interval < STOPPING_TIME_US && event.direction != 0 && event.direction == mEncLastDirection)
+    {
+      mEncInterval = interval;
+      mPulseStats.last_interval = interval;
+      if (mPulseStats.min_interval == 0 || interval < mPulseStats.min_interval)
+        mPulseStats.min_interval = interval;
+      if (interval > mPulseStats.max_interval)
+        mPulseStats.max_interval = interval;
+      if (mPulseStats.mean_interval == 0)
+        mPulseStats.mean_interval = interval;
+      else
+        mPulseStats.mean_interval += (static_cast<int32_t>(interval - mPulseStats.mean_interval)) / 8;
+    }
+
+    mEncLastEdge = event.time;
+    mEncMoving = true;
+    mEncLastDirection = event.direction;
+    mLastMotionTime = event.time;
+  }
 
+  // Edges that didn't fit in the ring, only their count is known
+  uint8_t lost_sum = mEncLostSum;
+  int8_t lost = static_cast<int8_t>(lost_sum - mEncLostSumSeen);
+  for (; lost > 0; lost--)
+    mEncAngleAct += count_increment(1);
+  for (; lost < 0; lost++)
+    mEncAngleAct += count_increment(-1);
+  mEncLostSumSeen = lost_sum;
+
+  uint8_t overflow_count = mEncEvents.overflow_count();
+  mPulseStats.overflows += static_cast<uint8_t>(overflow_count - mEncOverflowSeen);
+  mEncOverflowSeen = overflow_count;
+
+#ifdef ENC_QUADRATURE
+  uint8_t invalid_sum = mEncInvalidSum;
+  mPulseStats.invalid += static_cast<uint8_t>(invalid_sum - mEncInvalidSeen);
+  mEncInvalidSeen = invalid_sum;
+#endif
+
+  if (mEncAngleAct != angle)
+    mPositionGeneration++;
+}
+
+// Angle moved by one count. In quadrature a count is half a single channel
+// count, which isn't a whole internal unit; rounding the running count keeps
+// every two counts exact.
+int32_t CEncoderAxis::count_increment(int8_t direction)
+{
+#ifdef ENC_QUADRATURE
+  int32_t before = mEncCount * INCR_PER_COUNT / 2;
+  mEncCount += direction;
+  return mEncCount * INCR_PER_COUNT / 2 - before;
+#else
+  return direction * INCR_PER_COUNT;
+#endif
 }
 
 // Update the state machine by doing requests based on input conditions
 void CEncoderAxis::update()
 {
+  process_enc_events();
+  if (mEncMoving && micros() - mEncLastEdge > STOPPING_TIME_US)
+  {
+    mEncMoving = false;
+    mEncInterval = 0;
+  }
+
   int32_t enc_angle = mEncAngleAct;
-  uint32_t enc_last_change = mEncLastChange;
 
-  bool not_moving = millis() > (enc_last_change + STOPPING_TIME);
+  bool not_moving = (micros() - mLastMotionTime) > STOPPING_TIME_US;
 
   switch(mMotCurState)
   {
@@ -138,14 +286,28 @@ void CEncoderAxis::update()
       // Do nothing
       break;
     case CEncoderAxis::EMotorStateRunningPos:
-      // Start transition to stopped if necessary
-      if (not_moving || (mStopAtSetpoint && enc_angle >= mEncAngleSet))
+      // Start transition to stopped if necessary, early by the expected coast
+      if (not_moving)
+      {
         motor_request_state(CEncoderAxis::EMotorStateStopped);
+      }
+      else if (mStopAtSetpoint && enc_angle + predict_coast(1) >= mEncAngleSet)
+      {
+        motor_request_state(CEncoderAxis::EMotorStateStopped);
+        mCoastMeasuring = true;
+      }
       break;
     case CEncoderAxis::EMotorStateRunningNeg:
-      // Start transition to stopped if necessary
-      if (not_moving || (mStopAtSetpoint && enc_angle <= mEncAngleSet))
+      // Start transition to stopped if necessary, early by the expected coast
+      if (not_moving)
+      {
+        motor_request_state(CEncoderAxis::EMotorStateStopped);
+      }
+      else if (mStopAtSetpoint && enc_angle - predict_coast(-1) <= mEncAngleSet)
+      {
         motor_request_state(CEncoderAxis::EMotorStateStopped);
+        mCoastMeasuring = true;
+      }
       break;
     case CEncoderAxis::EMotorStateStoppingNeg: // fall-through
     case CEncoderAxis::EMotorStateStoppingPos:
@@ -153,6 +315,108 @@ void CEncoderAxis::update()
       motor_request_state(mMotReqState);
       break;
   }
+
+  if (mHomingState == CEncoderAxis::EHomingStateRunning)
+  {
+    if (is_stopped())
+    {
+      // Stalled against the end stop, which is the homing position
+      set_current_position(HOMING_POSITION);
+      mHomingState = CEncoderAxis::EHomingStateIdle;
+    }
+    else if (static_cast<int32_t>(millis() - mHomingDueTime) >= 0)
+    {
+      // Give up, the position is taken as homed once stopped
+      motor_request_state(CEncoderAxis::EMotorStateStopped);
+    }
+  }
+
+  publish_snapshot();
+}
+
+// Distance the axis is expected to coast after a stop at the current speed.
+// Friction brakes at a constant rate, so the distance goes with the square of
+// the speed.
+int32_t CEncoderAxis::predict_coast(int8_t direction)
+{
+  uint8_t index = direction > 0 ? 0 : 1;
+  if (!mCoastCompensation || mCoastSpeed[index] == 0)
+    return 0;
+
+  int32_t speed = get_velocity() * direction;
+  if (speed <= 0)
+    return 0;
+
+  int32_t coast = mCoast[index] * speed / mCoastSpeed[index] * speed / mCoastSpeed[index];
+  return coast < COAST_MAX ? coast : COAST_MAX;
+}
+
+// Compare where the axis came to rest with where the stop was requested
+void CEncoderAxis::learn_coast()
+{
+  mCoastMeasuring = false;
+
+  int8_t direction = mCoastStartSpeed > 0 ? 1 : -1;
+  uint8_t index = direction > 0 ? 0 : 1;
+  int32_t coast = (mEncAngleAct - mCoastStartAngle) * direction;
+  int32_t speed = mCoastStartSpeed * direction;
+  if (speed <= 0 || coast < 0 || coast > COAST_MAX)
+    return;
+
+  if (mCoastSpeed[index] == 0)
+  {
+    mCoast[index] = coast;
+    mCoastSpeed[index] = speed;
+  }
+  else
+  {
+    mCoast[index] += (coast - mCoast[index]) >> COAST_AVERAGE_SHIFT;
+    mCoastSpeed[index] += (speed - mCoastSpeed[index]) >> COAST_AVERAGE_SHIFT;
+  }
+}
+
+// Learned coast distance in 1e-1 deg for direction 1 or -1
+int32_t CEncoderAxis::get_coast(int8_t direction)
+{
+  return mCoast[direction > 0 ? 0 : 1] / EXT_TO_INT_FACTOR;
+}
+
+// Coast distances are learned either way, compensation only stops early
+void CEncoderAxis::set_coast_compensation(bool enabled)
+{
+  mCoastCompensation = enabled;
+}
+
+#ifdef USE_PERF_COUNTERS
+void CEncoderAxis::get_perf_counters(SPerfCounters& counters) const
+{
+  noInterrupts();
+  counters.interrupts = mIsrCount;
+  counters.rejected = mIsrRejected;
+  interrupts();
+  counters.relay_transitions = mRelayTransitions;
+}
+#endif
+
+// Copy the axis state into the snapshot readers take with get_snapshot()
+void CEncoderAxis::publish_snapshot()
+{
+  SSnapshot snapshot;
+  snapshot.position = get_current_position();
+  snapshot.setpoint = get_position_setpoint();
+  snapshot.motor_state = mMotCurState;
+  snapshot.homing = is_homing();
+  snapshot.calibrated = mCalibrated;
+  snapshot.last_edge_time = mEncLastEdge;
+  snapshot.velocity = get_velocity();
+  snapshot.generation = mPositionGeneration;
+  mSnapshot.write(snapshot);
+}
+
+// State as of the last update() or position change, never a mix of two
+void CEncoderAxis::get_snapshot(CEncoderAxis::SSnapshot& snapshot) const
+{
+  mSnapshot.read(snapshot);
 }
 
 // Request state transitions
@@ -203,35 +467,66 @@ void CEncoderAxis::motor_request_state(CEncoderAxis::EMotorState req_state)
   }
 }
 
+void CEncoderAxis::set_relay_writer(relay_writer_t writer)
+{
+  mRelayWriter = writer;
+}
+
+void CEncoderAxis::write_relay(bool negative, uint8_t level)
+{
+  if (mRelayWriter != NULL)
+    mRelayWriter(negative, level);
+  else
+    digitalWrite(negative ? mMotNegPin : mMotPosPin, level);
+}
+
 // Perform state transitions
 // should only be called by motor_request_state to adhere to state diagram
 void CEncoderAxis::_motor_set_state(CEncoderAxis::EMotorState state)
 {
+#ifdef USE_PERF_COUNTERS
+  // Stopped only switches a relay when it doesn't follow Stopping
+  if (state != CEncoderAxis::EMotorStateStopped ||
+      mMotCurState == CEncoderAxis::EMotorStateRunningPos ||
+      mMotCurState == CEncoderAxis::EMotorStateRunningNeg)
+  {
+    mRelayTransitions++;
+  }
+#endif
+  TRACE_MOTOR(this, state);
   mMotCurState = state;
   //Serial.write("DBG setting state ");
   switch(state)
   {
     case CEncoderAxis::EMotorStateRunningPos:
+      mCoastMeasuring = false;
       enc_reset();
-      digitalWrite(mMotPosPin, CEncoderAxis::ERelayStateOn);
+      write_relay(false, CEncoderAxis::ERelayStateOn);
       //Serial.write("EMotorStateRunningPos");
       break;
     case CEncoderAxis::EMotorStateRunningNeg:
+      mCoastMeasuring = false;
       enc_reset();
-      digitalWrite(mMotNegPin, CEncoderAxis::ERelayStateOn);
+      write_relay(true, CEncoderAxis::ERelayStateOn);
       //Serial.write("EMotorStateRunningNeg");
       break;
     case CEncoderAxis::EMotorStateStoppingPos:
-      digitalWrite(mMotPosPin, CEncoderAxis::ERelayStateOff);
+      mCoastStartAngle = mEncAngleAct;
+      mCoastStartSpeed = get_velocity();
+      write_relay(false, CEncoderAxis::ERelayStateOff);
       //Serial.write("EMotorStateStoppingPos");
       break;
     case CEncoderAxis::EMotorStateStoppingNeg:
-      digitalWrite(mMotNegPin, CEncoderAxis::ERelayStateOff);
+      mCoastStartAngle = mEncAngleAct;
+      mCoastStartSpeed = get_velocity();
+      write_relay(true, CEncoderAxis::ERelayStateOff);
       //Serial.write("EMotorStateStoppingNeg");
       break;
     case CEncoderAxis::EMotorStateStopped:
-      digitalWrite(mMotPosPin, CEncoderAxis::ERelayStateOff);
-      digitalWrite(mMotNegPin, CEncoderAxis::ERelayStateOff);
+      write_relay(false, CEncoderAxis::ERelayStateOff);
+      write_relay(true, CEncoderAxis::ERelayStateOff);
+      if (mCoastMeasuring)
+        learn_coast();
       //Serial.write("EMotorStateStopped");
       break;
     default:
@@ -240,21 +535,54 @@ void CEncoderAxis::_motor_set_state(CEncoderAxis::EMotorState state)
   //Serial.write("\n");
 }
 
-void CEncoderAxis::do_homing_procedure()
+// Move to the negative end stop and take it as homing position. Driven by
+// update(), stalling against the end stop is detected like any other stall.
+void CEncoderAxis::start_homing()
 {
-  // Start moving in negative direction
+  TRACE_HOMING(this);
   move_negative();
+  mHomingState = CEncoderAxis::EHomingStateRunning;
+  mHomingDueTime = millis() + HOMING_TIMEOUT;
+  mCalibrated = false;
+  publish_snapshot();
+}
 
-  // Wait until stopped (end stop used as homing position)
-  auto timeout = millis() + HOMING_TIMEOUT;
-  while(not is_stopped() && millis() < timeout)
-  {
-    update();
-    delay(HOMING_CHECK_TIME);
-  }
+bool CEncoderAxis::is_homing()
+{
+  return (mHomingState == CEncoderAxis::EHomingStateRunning);
+}
+
+// Whether the position is known. Aborting homing leaves the axis uncalibrated
+// until the next homing finishes or the position is set.
+bool CEncoderAxis::is_calibrated()
+{
+  return mCalibrated;
+}
+
+const CEncoderAxis::SPulseStats& CEncoderAxis::get_pulse_stats()
+{
+  return mPulseStats;
+}
+
+// Velocity in 1e-1 deg/s from the last edge interval, decaying when the next
+// edge takes longer
+int32_t CEncoderAxis::get_velocity()
+{
+  uint32_t since_last_edge = micros() - mEncLastEdge;
+  if (mEncInterval == 0 || since_last_edge > STOPPING_TIME_US)
+    return 0;
+
+  uint32_t interval = mEncInterval;
+  if (since_last_edge > interval)
+    interval = since_last_edge;
 
-  // When stopped, update current position to homing position
-  set_current_position(HOMING_POSITION);
+  // 1e-4 deg per edge over us gives 1e2 deg/s, so 1e3 for 1e-1 deg/s. In
+  // quadrature an edge is half a count.
+#ifdef ENC_QUADRATURE
+  return mEncLastDirection * static_cast<int32_t>(INCR_PER_COUNT * 1000L / 2 / interval);
+#else
+  return mEncLastDirection * static_cast<int32_t>(INCR_PER_COUNT * 1000L / interval);
+#endif
 }
 
 bool CEncoderAxis::is_stopped()
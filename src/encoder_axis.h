@@ -1,9 +1,82 @@
 #pragma once
 
+#include "perf_counters.h"
+#include "seqlock.h"
+#include "spsc_ring.h"
+
+// Encoder edges buffered between the interrupt handler and update()
+#ifdef ARDUINO_ARCH_AVR
+#define ENC_EVENT_RING_SIZE 16
+#else
+#define ENC_EVENT_RING_SIZE 32
+#endif
+
+// 300 [rot/min] * (20*2) [transitions] / 60 [sec/min] = 200 [transitions/second]
+// 1000 [ms] / 200 [transitions/second] = 5 [ms/transition]
+#ifndef ENC_DEAD_TIME
+#define ENC_DEAD_TIME 2000 // us
+#endif
+
+// Quadrature transition that skipped a state
+#define QUAD_INVALID 2
+
+// With -DENC_QUADRATURE the encoder has two channels in quadrature, each on an
+// interrupt pin. Every edge of either channel is a count with its true
+// direction, also while coasting or when the mast is turned by the wind.
+// Without it a single channel is counted in the direction the motor runs.
+
 class CEncoderAxis
 {
 public:
+  enum EMotorState
+  {
+    EMotorStateStopped     = 0,
+    EMotorStateRunningPos  = 1,
+    EMotorStateStoppingPos = 2,
+    EMotorStateRunningNeg  = 3,
+    EMotorStateStoppingNeg = 4,
+  };
+
+  // Consistent view of the axis, published by the main loop
+  struct SSnapshot
+  {
+    int32_t position;        // 1e-1 deg
+    int32_t setpoint;        // 1e-1 deg
+    EMotorState motor_state;
+    bool homing;
+    bool calibrated;         // position known from homing or set_current_position()
+    uint32_t last_edge_time; // us
+    int32_t velocity;        // 1e-1 deg/s
+    uint16_t generation;     // changes with the position, for caching what is derived from it
+  };
+
+  struct SPulseStats
+  {
+    uint32_t edges;         // edges counted into the position
+    uint32_t overflows;     // edges that didn't fit in the event ring, position still counted
+    uint32_t last_interval; // us
+    uint32_t min_interval;  // us
+    uint32_t max_interval;  // us
+    uint32_t mean_interval; // us, moving average
+#ifdef ENC_QUADRATURE
+    uint32_t invalid;       // transitions that skipped a state, their counts are lost
+#endif
+  };
+
+#ifdef USE_PERF_COUNTERS
+  struct SPerfCounters
+  {
+    uint32_t interrupts;        // encoder interrupts, including rejected ones
+    uint32_t rejected;          // interrupts within the dead time
+    uint32_t relay_transitions; // relay switched on or off
+  };
+#endif
+
+#ifdef ENC_QUADRATURE
+  CEncoderAxis(uint8_t enc_pin_a, uint8_t enc_pin_b, uint8_t mot_pos_pin, uint8_t mot_neg_pin);
+#else
   CEncoderAxis(uint8_t enc_pin, uint8_t mot_pos_pin, uint8_t mot_neg_pin);
+#endif
   void begin();
   void INTERRUPT_FUNC enc_interrupt();
   void enc_reset();
@@ -15,8 +88,31 @@ public:
   int32_t get_current_position();
   void set_current_position(int32_t position);
   void update();
-  void do_homing_procedure();
+  void start_homing();
+  bool is_homing();
+  bool is_calibrated();
   bool is_stopped();
+  const SPulseStats& get_pulse_stats();
+  int32_t get_velocity();
+  void get_snapshot(SSnapshot& snapshot) const;
+  int32_t get_coast(int8_t direction);
+  void set_coast_compensation(bool enabled);
+#ifdef USE_PERF_COUNTERS
+  void get_perf_counters(SPerfCounters& counters) const;
+#endif
+
+protected:
+  // Drives one relay, for pin access resolved at compile time
+  typedef void (*relay_writer_t)(bool negative, uint8_t level);
+  void set_relay_writer(relay_writer_t writer);
+
+  // Body of the interrupt handler, inline so a handler for a fixed axis
+  // compiles to a single function
+#ifdef ENC_QUADRATURE
+  inline void enc_edge(uint32_t cur_time, uint8_t state) __attribute__((always_inline));
+#else
+  inline void enc_edge(uint32_t cur_time) __attribute__((always_inline));
+#endif
 
 private:
   enum EEncState
@@ -32,27 +128,136 @@ private:
     ERelayStateOn     = 1,
   };
 
-  enum EMotorState
+  enum EHomingState
   {
-    EMotorStateStopped     = 0,
-    EMotorStateRunningPos  = 1,
-    EMotorStateStoppingPos = 2,
-    EMotorStateRunningNeg  = 3,
-    EMotorStateStoppingNeg = 4,
+    EHomingStateIdle    = 0,
+    EHomingStateRunning = 1,
+  };
+
+  struct SEncEvent
+  {
+    uint32_t time; // us
+    int8_t direction;
   };
 
   void motor_request_state(EMotorState req_state);
   void _motor_set_state(EMotorState state);
-
+  void write_relay(bool negative, uint8_t level);
+  void process_enc_events();
+  int32_t count_increment(int8_t direction);
+  void publish_snapshot();
+  int32_t predict_coast(int8_t direction);
+  void learn_coast();
 
   EMotorState mMotCurState;
   EMotorState mMotReqState;
+  EHomingState mHomingState;
+  bool mCalibrated;
+  uint32_t mHomingDueTime;
+  CSpscRing<SEncEvent, ENC_EVENT_RING_SIZE> mEncEvents;
   volatile uint32_t mEncLastChange;
-  volatile int32_t mEncAngleAct;
+  volatile uint8_t mEncLostSum;
+  uint8_t mEncLostSumSeen;
+  uint8_t mEncOverflowSeen;
+  int8_t mEncLastDirection;
+  uint32_t mEncLastEdge;
+  // Whether the last edge is within STOPPING_TIME_US, and the interval before
+  // it in that movement, 0 if none. Cleared by update(), so an old interval
+  // doesn't come back as a speed when micros() wraps.
+  bool mEncMoving;
+  uint32_t mEncInterval; // us
+  uint32_t mLastMotionTime;
+  SPulseStats mPulseStats;
+  int32_t mEncAngleAct;
+  uint16_t mPositionGeneration;
   int32_t mEncAngleSet;
   uint32_t mTransitionDueTime;
   uint8_t mEncPin;
+#ifdef ENC_QUADRATURE
+  uint8_t mEncPinB;
+  volatile uint8_t mEncQuadState; // channel A in bit 1, B in bit 0
+  volatile uint8_t mEncInvalidSum;
+  uint8_t mEncInvalidSeen;
+  int32_t mEncCount;
+  // Count per transition from state (A << 1 | B) to state, indexed by old << 2 | new
+  static const int8_t mQuadTable[16];
+#endif
   uint8_t mMotPosPin;
   uint8_t mMotNegPin;
   bool mStopAtSetpoint;
+  int32_t mCoast[2];      // 1e-4 deg, learned coast distance, positive and negative direction
+  int32_t mCoastSpeed[2]; // 1e-1 deg/s, speed at which the coast was learned
+  int32_t mCoastStartAngle;
+  int32_t mCoastStartSpeed;
+  bool mCoastMeasuring;
+  bool mCoastCompensation;
+  relay_writer_t mRelayWriter;
+#ifdef USE_PERF_COUNTERS
+  volatile uint32_t mIsrCount;
+  volatile uint32_t mIsrRejected;
+  uint32_t mRelayTransitions;
+#endif
+  CSeqLock<SSnapshot> mSnapshot;
 };
+
+#ifdef ENC_QUADRATURE
+// Decode the new channel state and pass the count on to update() with its
+// timestamp. Bounce on one channel decodes as counts back and forth, so there
+// is no dead time.
+void CEncoderAxis::enc_edge(uint32_t cur_time, uint8_t state)
+{
+  PERF_COUNT(mIsrCount);
+
+  int8_t count = mQuadTable[(mEncQuadState << 2) | state];
+  mEncQuadState = state;
+  if (count == 0 || count == QUAD_INVALID)
+  {
+    // Same state (edge too short to see) or both channels changed
+    PERF_COUNT(mIsrRejected);
+    if (count == QUAD_INVALID)
+      mEncInvalidSum = mEncInvalidSum + 1;
+    return;
+  }
+
+  SEncEvent event;
+  event.time = cur_time;
+  event.direction = count;
+  if (!mEncEvents.push(event))
+  {
+    // Ring is full, keep the count so the position stays right
+    mEncLostSum = mEncLostSum + event.direction;
+  }
+}
+#else
+// Debounce the edge and pass it on to update() with its timestamp
+void CEncoderAxis::enc_edge(uint32_t cur_time)
+{
+  PERF_COUNT(mIsrCount);
+
+  if (cur_time - mEncLastChange > ENC_DEAD_TIME)
+  {
+    // valid encoder transition
+    SEncEvent event;
+    event.time = cur_time;
+    event.direction = 0;
+    if (mMotCurState == CEncoderAxis::EMotorStateRunningPos || mMotCurState == CEncoderAxis::EMotorStateStoppingPos)
+    {
+      event.direction = 1;
+    }
+    if (mMotCurState == CEncoderAxis::EMotorStateRunningNeg || mMotCurState == CEncoderAxis::EMotorStateStoppingNeg)
+    {
+      event.direction = -1;
+    }
+    if (!mEncEvents.push(event))
+    {
+      // Ring is full, keep the count so the position stays right
+      mEncLostSum = mEncLostSum + event.direction;
+    }
+    mEncLastChange = cur_time;
+  }
+  else
+  {
+    PERF_COUNT(mIsrRejected);
+  }
+}
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "encoder_axis.h"
+#include "fast_io.h"
+
+#define FAST_AXIS_NO_PIN 0xff
+
+// CEncoderAxis with its pins fixed at compile time. Relay writes go straight
+// to the port registers (see fast_io.h) and enc_interrupt() is inline, so the
+// interrupt handler of an axis object compiles to one function with the pin
+// reads and the object address as constants. ENC_PIN_B is the second channel
+// with -DENC_QUADRATURE and unused without.
+template<uint8_t ENC_PIN, uint8_t MOT_POS_PIN, uint8_t MOT_NEG_PIN, uint8_t ENC_PIN_B = FAST_AXIS_NO_PIN>
+class CFastEncoderAxis : public CEncoderAxis
+{
+public:
+#ifdef ENC_QUADRATURE
+  static_assert(ENC_PIN_B != FAST_AXIS_NO_PIN, "quadrature needs the second encoder pin");
+
+  CFastEncoderAxis() : CEncoderAxis(ENC_PIN, ENC_PIN_B, MOT_POS_PIN, MOT_NEG_PIN)
+#else
+  CFastEncoderAxis() : CEncoderAxis(ENC_PIN, MOT_POS_PIN, MOT_NEG_PIN)
+#endif
+  {
+    set_relay_writer(write_relay);
+  }
+
+  // Call from the interrupt handler of this axis only
+  inline void enc_interrupt() __attribute__((always_inline))
+  {
+#ifdef ENC_QUADRATURE
+    enc_edge(micros(), (CFastPin<ENC_PIN>::read() << 1) | CFastPin<ENC_PIN_B>::read());
+#else
+    enc_edge(micros());
+#endif
+  }
+
+private:
+  static void write_relay(bool negative, uint8_t level)
+  {
+    if (negative)
+      CFastPin<MOT_NEG_PIN>::write(level);
+    else
+      CFastPin<MOT_POS_PIN>::write(level);
+  }
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+// Digital pin access with the pin known at compile time. On the ATmega328 a
+// write is a single sbi/cbi on the port register, on the ESP8266 a store to
+// GPOS/GPOC. Other targets, and ESP8266 GPIO16, fall back to
+// digitalWrite()/digitalRead(). Like those, the pin must have been set up with
+// pinMode() first.
+template<uint8_t PIN>
+class CFastPin
+{
+public:
+  static inline void write(uint8_t level) __attribute__((always_inline))
+  {
+#if defined(__AVR_ATmega328P__)
+    if (level)
+      port() |= mask();
+    else
+      port() &= ~mask();
+#elif defined(ARDUINO_ARCH_ESP8266)
+    if (PIN < 16)
+    {
+      if (level)
+        GPOS = 1 << (PIN & 15);
+      else
+        GPOC = 1 << (PIN & 15);
+    }
+    else
+    {
+      digitalWrite(PIN, level);
+    }
+#else
+    digitalWrite(PIN, level);
+#endif
+  }
+
+  static inline uint8_t read() __attribute__((always_inline))
+  {
+#if defined(__AVR_ATmega328P__)
+    return (input() & mask()) ? HIGH : LOW;
+#elif defined(ARDUINO_ARCH_ESP8266)
+    if (PIN < 16)
+      return (GPI >> (PIN & 15)) & 1;
+    return digitalRead(PIN);
+#else
+    return digitalRead(PIN);
+#endif
+  }
+
+private:
+  CFastPin() {}
+
+#if defined(__AVR_ATmega328P__)
+  // Digital pins 0-7 are port D, 8-13 port B, 14-19 (A0-A5) port C
+  static_assert(PIN < 20, "no such pin on the ATmega328");
+
+  static inline volatile uint8_t& port() __attribute__((always_inline))
+  {
+    return PIN < 8 ? PORTD : PIN < 14 ? PORTB : PORTC;
+  }
+
+  static inline volatile uint8_t& input() __attribute__((always_inline))
+  {
+    return PIN < 8 ? PIND : PIN < 14 ? PINB : PINC;
+  }
+
+  static inline uint8_t mask() __attribute__((always_inline))
+  {
+    return 1 << (PIN < 8 ? PIN : PIN < 14 ? PIN - 8 : PIN - 14);
+  }
+#endif
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Shadow framebuffer for a character LCD (HD44780 style, e.g. LiquidCrystal).
+// Text is written to the buffer, flush() sends only the cells that differ from
+// what the display shows, and stops once its time budget is spent, so a full
+// redraw is spread over several calls. The display's cursor auto-increments,
+// so runs of changed cells cost one setCursor(). T needs setCursor(col, row)
+// and write(uint8_t).
+template<class T, uint8_t COLS, uint8_t ROWS>
+class CLcdFramebuffer
+{
+public:
+  CLcdFramebuffer(T& display) : mDisplay(display)
+  {
+    memset(mText, ' ', sizeof(mText));
+    invalidate();
+  }
+
+  // Forget what the display shows, e.g. after clearing it behind our back
+  void invalidate()
+  {
+    // Never a character we write, so every cell is sent once
+    memset(mShown, 0, sizeof(mShown));
+    mCursorCol = COLS;
+    mCursorRow = ROWS;
+    mNext = 0;
+  }
+
+  // Replace a row, padded with spaces or cut off at the display width
+  void set_row(uint8_t row, const char* text)
+  {
+    if (row >= ROWS)
+      return;
+    uint8_t col = 0;
+    for (; col < COLS && text[col] != '\0'; col++)
+      mText[row][col] = text[col];
+    for (; col < COLS; col++)
+      mText[row][col] = ' ';
+  }
+
+  // Write changed cells until all are shown or the budget (in us) is spent.
+  // At least one cell is written per call. Returns whether the display is up
+  // to date.
+  bool flush(uint32_t budget)
+  {
+    uint32_t start = micros();
+    bool written = false;
+    for (uint8_t checked = 0; checked < COLS * ROWS; checked++)
+    {
+      uint8_t row = mNext / COLS;
+      uint8_t col = mNext % COLS;
+      if (mText[row][col] != mShown[row][col])
+      {
+        if (written && micros() - start >= budget)
+          return false;
+        if (col != mCursorCol || row != mCursorRow)
+          mDisplay.setCursor(col, row);
+        mDisplay.write(static_cast<uint8_t>(mText[row][col]));
+        mShown[row][col] = mText[row][col];
+        mCursorCol = col + 1;
+        mCursorRow = row;
+        written = true;
+      }
+      mNext = (mNext + 1) % (COLS * ROWS);
+    }
+    return true;
+  }
+
+  bool is_dirty() const
+  {
+    return memcmp(mText, mShown, sizeof(mText)) != 0;
+  }
+
+private:
+  T& mDisplay;
+  char mText[ROWS][COLS];
+  char mShown[ROWS][COLS];
+  uint8_t mCursorCol; // where the next write lands
+  uint8_t mCursorRow;
+  uint8_t mNext;      // cell to check next, flushes continue where the last stopped
+};
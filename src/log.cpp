@@ -0,0 +1,106 @@
+#include "Arduino.h"
+#include "log.h"
+#include <stdarg.h>
+
+char CLog::mBuffer[LOG_BUFFER_SIZE];
+size_t CLog::mHead = 0;
+size_t CLog::mCount = 0;
+uint32_t CLog::mDropped = 0;
+CLog::sink_t CLog::mSink = NULL;
+
+// Same prefixes as the error lines of old
+static const char* const LOG_PREFIXES[] = { "", "ERR ", "WRN ", "INF ", "DBG " };
+
+void CLog::write(uint8_t level, const char* format, ...)
+{
+  char line[LOG_LINE_SIZE];
+  size_t len = strlen(LOG_PREFIXES[level]);
+  memcpy(line, LOG_PREFIXES[level], len);
+
+  va_list args;
+  va_start(args, format);
+#ifdef ARDUINO_ARCH_AVR
+  int written = vsnprintf_P(&(line[len]), sizeof(line) - len - 2, format, args);
+#else
+  int written = vsnprintf(&(line[len]), sizeof(line) - len - 2, format, args);
+#endif
+  va_end(args);
+
+  // Long messages are cut off, the line end is always there
+  if (written > 0)
+    len += static_cast<size_t>(written) < sizeof(line) - len - 2 ? written : sizeof(line) - len - 3;
+  line[len++] = '\r';
+  line[len++] = '\n';
+
+  push(line, len);
+}
+
+void CLog::set_sink(sink_t sink)
+{
+  mSink = sink;
+}
+
+// Lines go in whole or not at all, also when an interrupt handler logs
+void CLog::push(const char* data, size_t len)
+{
+  noInterrupts();
+  if (mCount + len > LOG_BUFFER_SIZE)
+  {
+    mDropped++;
+    interrupts();
+    return;
+  }
+  size_t tail = (mHead + mCount) % LOG_BUFFER_SIZE;
+  mCount += len;
+  interrupts();
+
+  // The space is reserved, copying can be interrupted. drain() only takes
+  // complete lines, which this one isn't until its line end is in.
+  for (size_t i = 0; i < len; i++)
+  {
+    mBuffer[tail] = data[i];
+    tail = (tail + 1) % LOG_BUFFER_SIZE;
+  }
+}
+
+// Copy the oldest complete line, returns its length or 0 when there is none
+size_t CLog::peek_line(char* line, size_t size)
+{
+  size_t count = mCount;
+  for (size_t i = 0; i < count && i < size; i++)
+  {
+    line[i] = mBuffer[(mHead + i) % LOG_BUFFER_SIZE];
+    if (line[i] == '\n')
+      return i + 1;
+  }
+  return 0;
+}
+
+void CLog::drain()
+{
+  if (mSink == NULL)
+    return;
+
+  char line[LOG_LINE_SIZE];
+  size_t len;
+  while ((len = peek_line(line, sizeof(line))) > 0)
+  {
+    if (!mSink(line, len))
+      return;
+
+    noInterrupts();
+    mHead = (mHead + len) % LOG_BUFFER_SIZE;
+    mCount -= len;
+    interrupts();
+  }
+}
+
+uint32_t CLog::get_dropped()
+{
+  return mDropped;
+}
+
+size_t CLog::get_buffered()
+{
+  return mCount;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Messages above this level are stripped at compile time, arguments included
+#ifndef LOG_LEVEL
+#ifdef ARDUINO_ARCH_AVR
+#define LOG_LEVEL LOG_LEVEL_WARN
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// Buffered lines waiting for the sink, and the longest line
+#ifdef ARDUINO_ARCH_AVR
+#define LOG_BUFFER_SIZE 128
+#define LOG_LINE_SIZE 48
+#else
+#define LOG_BUFFER_SIZE 1024
+#define LOG_LINE_SIZE 96
+#endif
+
+// Format strings stay in flash on the AVR
+#ifdef ARDUINO_ARCH_AVR
+#include <avr/pgmspace.h>
+#define LOG_STR(s) PSTR(s)
+#else
+#define LOG_STR(s) (s)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) CLog::write(LOG_LEVEL_ERROR, LOG_STR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) CLog::write(LOG_LEVEL_WARN, LOG_STR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) CLog::write(LOG_LEVEL_INFO, LOG_STR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) CLog::write(LOG_LEVEL_DEBUG, LOG_STR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+// Log lines are formatted into a RAM ring buffer and never wait for the
+// output. drain() hands them to the sink one line at a time, as far as the sink
+// takes them without blocking. Lines that don't fit in the buffer are dropped
+// and counted.
+class CLog
+{
+public:
+  // Takes a whole line (with line end), returns false when it can't right now
+  typedef bool (*sink_t)(const char* line, size_t len);
+
+  // Use the LOG_* macros, they strip disabled levels at compile time
+  static void write(uint8_t level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  static void set_sink(sink_t sink);
+
+  // Pass buffered lines to the sink, call from a low priority task
+  static void drain();
+
+  static uint32_t get_dropped();
+  static size_t get_buffered();
+
+private:
+  CLog() {}
+  static void push(const char* data, size_t len);
+  static size_t peek_line(char* line, size_t size);
+
+  static char mBuffer[LOG_BUFFER_SIZE];
+  static size_t mHead;
+  static size_t mCount;
+  static uint32_t mDropped;
+  static sink_t mSink;
+};
@@ -0,0 +1,93 @@
+#include "Arduino.h"
+#include "motion_trace.h"
+
+#ifdef USE_MOTION_TRACE
+
+#define TRACE_ELEVATION 0x80
+
+const CEncoderAxis* CMotionTrace::mElevationAxis = NULL;
+CMotionTrace::SRecord CMotionTrace::mRecords[TRACE_SIZE];
+uint32_t CMotionTrace::mSequence = 0;
+
+// Only the elevation axis is told apart, records of any other are azimuth
+void CMotionTrace::begin(const CEncoderAxis& /*azimuth_axis*/, const CEncoderAxis& elevation_axis)
+{
+  mElevationAxis = &elevation_axis;
+}
+
+// Setpoints and positions in 1e-1 deg, clamped to the record
+static int16_t clamp_value(int32_t value)
+{
+  return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value;
+}
+
+void CMotionTrace::write(uint32_t time, uint8_t type, uint8_t arg, int16_t value)
+{
+  SRecord& record = mRecords[mSequence % TRACE_SIZE];
+  record.time = time;
+  record.type = type;
+  record.arg = arg;
+  record.value = value;
+  mSequence++;
+}
+
+void CMotionTrace::record(const CEncoderAxis* axis, EType type, uint8_t arg, int32_t value)
+{
+  uint8_t axis_bit = axis == mElevationAxis ? TRACE_ELEVATION : 0;
+  write(micros(), type | axis_bit, arg, clamp_value(value));
+}
+
+void CMotionTrace::record_edge(const CEncoderAxis* axis, uint32_t time, int8_t direction, int32_t position)
+{
+  uint8_t axis_bit = axis == mElevationAxis ? TRACE_ELEVATION : 0;
+  write(time, ETypeEdge | axis_bit, static_cast<uint8_t>(direction), clamp_value(position));
+}
+
+void CMotionTrace::record_command(const char* command)
+{
+  // The first three characters tell the command apart, line ends are left out
+  uint8_t chars[3] = { 0, 0, 0 };
+  for (uint8_t i = 0; i < 3 && command[i] != '\0' && command[i] != '\r' && command[i] != '\n'; i++)
+    chars[i] = command[i];
+  write(micros(), ETypeCommand, chars[0], static_cast<int16_t>(chars[1] | (chars[2] << 8)));
+}
+
+uint32_t CMotionTrace::get_sequence()
+{
+  return mSequence;
+}
+
+static size_t append_hex(char* buffer, uint32_t value, uint8_t bytes)
+{
+  static const char digits[] = "0123456789abcdef";
+  for (uint8_t i = 0; i < bytes; i++)
+  {
+    buffer[2 * i] = digits[(value >> 4) & 0xf];
+    buffer[2 * i + 1] = digits[value & 0xf];
+    value >>= 8;
+  }
+  return 2 * bytes;
+}
+
+uint8_t CMotionTrace::dump(uint32_t& first, uint8_t max_records, char* buffer, size_t size)
+{
+  uint32_t oldest = mSequence > TRACE_SIZE ? mSequence - TRACE_SIZE : 0;
+  if (first < oldest || first > mSequence)
+    first = oldest;
+
+  uint8_t count = 0;
+  size_t len = 0;
+  while (count < max_records && first + count < mSequence && len + 2 * sizeof(SRecord) < size)
+  {
+    const SRecord& record = mRecords[(first + count) % TRACE_SIZE];
+    len += append_hex(&(buffer[len]), record.time, 4);
+    len += append_hex(&(buffer[len]), record.type, 1);
+    len += append_hex(&(buffer[len]), record.arg, 1);
+    len += append_hex(&(buffer[len]), static_cast<uint16_t>(record.value), 2);
+    count++;
+  }
+  buffer[len] = '\0';
+  return count;
+}
+
+#endif
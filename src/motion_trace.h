@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Motion trace, enabled with -DUSE_MOTION_TRACE. Without the flag the TRACE_*
+// macros compile to nothing.
+#ifdef USE_MOTION_TRACE
+#define TRACE_EDGE(axis, time, direction, position) CMotionTrace::record_edge(axis, time, direction, position)
+#define TRACE_MOTOR(axis, state) CMotionTrace::record(axis, CMotionTrace::ETypeMotor, state, 0)
+#define TRACE_SETPOINT(axis, setpoint) CMotionTrace::record(axis, CMotionTrace::ETypeSetpoint, 0, setpoint)
+#define TRACE_COMMAND(command) CMotionTrace::record_command(command)
+#define TRACE_HOMING(axis) CMotionTrace::record(axis, CMotionTrace::ETypeHoming, 0, 0)
+#else
+#define TRACE_EDGE(axis, time, direction, position) do {} while (0)
+#define TRACE_MOTOR(axis, state) do {} while (0)
+#define TRACE_SETPOINT(axis, setpoint) do {} while (0)
+#define TRACE_COMMAND(command) do {} while (0)
+#define TRACE_HOMING(axis) do {} while (0)
+#endif
+
+#ifdef USE_MOTION_TRACE
+
+// Records kept, a power of two
+#ifndef TRACE_SIZE
+#ifdef ARDUINO_ARCH_AVR
+#define TRACE_SIZE 32
+#else
+#define TRACE_SIZE 1024
+#endif
+#endif
+
+// Records per dump response, 8 bytes each as hex
+#define TRACE_DUMP_RECORDS 6
+
+class CEncoderAxis;
+
+// Ring of the last TRACE_SIZE motion events in 8 byte records, little endian:
+//
+//   uint32 time   us
+//   uint8  type   ETypeX, bit 7 set for the elevation axis
+//   uint8  arg    edge: direction (int8), motor: EMotorState, command: 1st char
+//   int16  value  edge: position after it, setpoint: new setpoint (1e-1 deg),
+//                 command: 2nd and 3rd char
+//
+// Every record has a sequence number, so a dump can be taken in pieces while
+// recording goes on. Records are written from the main loop only; edges carry
+// the time stamp taken in the interrupt handler, so they may be a bit older
+// than the records before them.
+class CMotionTrace
+{
+public:
+  enum EType
+  {
+    ETypeEdge     = 1,
+    ETypeMotor    = 2,
+    ETypeSetpoint = 3,
+    ETypeCommand  = 4,
+    ETypeHoming   = 5,
+  };
+
+  static void begin(const CEncoderAxis& azimuth_axis, const CEncoderAxis& elevation_axis);
+
+  static void record(const CEncoderAxis* axis, EType type, uint8_t arg, int32_t value);
+  static void record_edge(const CEncoderAxis* axis, uint32_t time, int8_t direction, int32_t position);
+  static void record_command(const char* command);
+
+  // Sequence number of the next record
+  static uint32_t get_sequence();
+
+  // Hex of up to max_records records from sequence first on, or from the oldest
+  // one still there. Returns the number of records, first is set to the
+  // sequence of the first one.
+  static uint8_t dump(uint32_t& first, uint8_t max_records, char* buffer, size_t size);
+
+private:
+  struct SRecord
+  {
+    uint32_t time;
+    uint8_t type;
+    uint8_t arg;
+    int16_t value;
+  };
+
+  CMotionTrace() {}
+  static void write(uint32_t time, uint8_t type, uint8_t arg, int16_t value);
+
+  static const CEncoderAxis* mElevationAxis;
+  static SRecord mRecords[TRACE_SIZE];
+  static uint32_t mSequence;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "sgp4.h"
+
+// Ground station and the look angles from it to a position in the TEME frame
+// of CSgp4. Earth rotation is taken from the mean sidereal time, polar motion
+// and nutation are ignored, which is far below the pointing accuracy needed.
+template<class T>
+class CObserver
+{
+public:
+  CObserver() : mSinLat(0), mCosLat(1), mLongitude(0), mRadius(0), mZ(0) {}
+
+  // Geodetic latitude and longitude in rad, altitude in km
+  void set(T latitude, T longitude, T altitude)
+  {
+    // WGS-72 ellipsoid, matching the propagator
+    const T f = T(1.0) / T(298.26);
+    const T a = T(6378.135);
+    mSinLat = sgp4_sin(latitude);
+    mCosLat = sgp4_cos(latitude);
+    mLongitude = longitude;
+    T c = T(1.0) / sgp4_sqrt(T(1.0) + f * (f - T(2.0)) * mSinLat * mSinLat);
+    T s = (T(1.0) - f) * (T(1.0) - f) * c;
+    mRadius = (a * c + altitude) * mCosLat;
+    mZ = (a * s + altitude) * mSinLat;
+  }
+
+  // Greenwich mean sidereal time in rad. The whole days and the time of day
+  // are scaled separately to keep the precision in float.
+  static T gmst(uint32_t unix_time, uint16_t ms)
+  {
+    // 2000-01-01 12:00 UTC
+    int32_t seconds = static_cast<int32_t>(unix_time - 946728000UL);
+    int32_t days = seconds / 86400;
+    int32_t day_seconds = seconds % 86400;
+    if (day_seconds < 0)
+    {
+      days--;
+      day_seconds += 86400;
+    }
+    T day_fraction = (T(day_seconds) + T(ms) / T(1000.0)) / T(86400.0);
+    T degrees = T(280.46061837) + sgp4_fmod(T(0.98564736629) * T(days), T(360.0)) + T(360.98564736629) * day_fraction;
+    return sgp4_fmod(degrees, T(360.0)) * T(M_PI) / T(180.0);
+  }
+
+  // Azimuth (0 .. 2 pi, clockwise from north) and elevation in rad, range in km
+  void look_angles(const T position[3], uint32_t unix_time, uint16_t ms, T& azimuth, T& elevation, T& range) const
+  {
+    T theta = gmst(unix_time, ms) + mLongitude;
+    T sin_theta = sgp4_sin(theta);
+    T cos_theta = sgp4_cos(theta);
+
+    T rx = position[0] - mRadius * cos_theta;
+    T ry = position[1] - mRadius * sin_theta;
+    T rz = position[2] - mZ;
+
+    // South, east, zenith
+    T top_s = mSinLat * cos_theta * rx + mSinLat * sin_theta * ry - mCosLat * rz;
+    T top_e = -sin_theta * rx + cos_theta * ry;
+    T top_z = mCosLat * cos_theta * rx + mCosLat * sin_theta * ry + mSinLat * rz;
+
+    range = sgp4_sqrt(rx * rx + ry * ry + rz * rz);
+    elevation = sgp4_asin(top_z / range);
+    azimuth = sgp4_atan2(-top_e, top_s) + T(M_PI);
+  }
+
+private:
+  T mSinLat;
+  T mCosLat;
+  T mLongitude;
+  T mRadius; // km, distance from the earth axis
+  T mZ;      // km, above the equator plane
+};
@@ -0,0 +1,209 @@
+#include "Arduino.h"
+#include "perf_counters.h"
+
+#ifdef USE_PERF_COUNTERS
+
+#include "encoder_axis.h"
+#include <stdarg.h>
+
+#ifdef ARDUINO_ARCH_AVR
+// Free stack is found from the untouched part of a pattern painted at begin()
+#define PERF_STACK_PAINT 0xa5
+#define PERF_STACK_MARGIN 32 // bytes below the stack pointer left alone at begin()
+extern char __heap_start;
+extern char* __brkval;
+#endif
+
+CEncoderAxis* CPerfCounters::mAzimuthAxis = NULL;
+CEncoderAxis* CPerfCounters::mElevationAxis = NULL;
+uint32_t CPerfCounters::mLastLoop = 0;
+uint32_t CPerfCounters::mLoopBins[PERF_LOOP_BINS];
+CPerfCounters::SCommandStats CPerfCounters::mCommands[PERF_COMMAND_TYPE_COUNT];
+uint32_t CPerfCounters::mTcpConnects = 0;
+uint32_t CPerfCounters::mMqttFailures = 0;
+
+void CPerfCounters::begin(CEncoderAxis& azimuth_axis, CEncoderAxis& elevation_axis)
+{
+  mAzimuthAxis = &azimuth_axis;
+  mElevationAxis = &elevation_axis;
+  mLastLoop = micros();
+
+#ifdef ARDUINO_ARCH_AVR
+  char top;
+  char* heap_end = __brkval ? __brkval : &__heap_start;
+  for (char* p = heap_end; p < &top - PERF_STACK_MARGIN; p++)
+    *p = PERF_STACK_PAINT;
+#endif
+}
+
+void CPerfCounters::record_loop(uint32_t now)
+{
+  uint32_t period = (now - mLastLoop) >> PERF_LOOP_BIN_SHIFT;
+  mLastLoop = now;
+
+  uint8_t bin = 0;
+  while (period > 0 && bin < PERF_LOOP_BINS - 1)
+  {
+    period >>= 1;
+    bin++;
+  }
+  mLoopBins[bin]++;
+}
+
+uint8_t CPerfCounters::command_type(const char* command)
+{
+  char type = command[0];
+  if (type == '\\')
+    type = command[1] == 'g' ? 'p' : command[1] == 's' ? 'P' : '?';
+
+  const char* types = PERF_COMMAND_TYPES;
+  uint8_t i = 0;
+  while (i < PERF_COMMAND_TYPE_COUNT - 1 && types[i] != type)
+    i++;
+  return i;
+}
+
+void CPerfCounters::record_command(const char* command, uint32_t runtime)
+{
+  SCommandStats& stats = mCommands[command_type(command)];
+  stats.count++;
+  stats.total_runtime += runtime;
+  if (runtime > stats.max_runtime)
+    stats.max_runtime = runtime;
+}
+
+uint32_t CPerfCounters::free_heap()
+{
+#if defined(ARDUINO_ARCH_ESP8266)
+  return ESP.getFreeHeap();
+#elif defined(ARDUINO_ARCH_AVR)
+  char top;
+  return &top - (__brkval ? __brkval : &__heap_start);
+#else
+  return 0;
+#endif
+}
+
+uint32_t CPerfCounters::free_stack()
+{
+#if defined(ARDUINO_ARCH_ESP8266)
+  // The core paints the stack too and reports the untouched part
+  return ESP.getFreeContStack();
+#elif defined(ARDUINO_ARCH_AVR)
+  char top;
+  const char* p = __brkval ? __brkval : &__heap_start;
+  uint32_t free = 0;
+  while (p < &top && *p == static_cast<char>(PERF_STACK_PAINT))
+  {
+    p++;
+    free++;
+  }
+  return free;
+#else
+  return 0;
+#endif
+}
+
+// snprintf that keeps the length within the buffer
+static size_t append(char* buffer, size_t size, size_t len, const char* format, ...)
+{
+  if (len + 1 >= size)
+    return len;
+
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(&(buffer[len]), size - len, format, args);
+  va_end(args);
+
+  if (written < 0)
+    return len;
+  return len + written < size ? len + written : size - 1;
+}
+
+size_t CPerfCounters::format_section(char section, char* buffer, size_t size)
+{
+  size_t len = 0;
+  buffer[0] = '\0';
+
+  if (section == 'L')
+  {
+    for (uint8_t i = 0; i < PERF_LOOP_BINS; i++)
+      len = append(buffer, size, len, "%s%lu", i > 0 ? "," : "", static_cast<unsigned long>(mLoopBins[i]));
+  }
+  else if (section == 'C')
+  {
+    // Only commands that were used, as far as they fit
+    char item[32];
+    for (uint8_t i = 0; i < PERF_COMMAND_TYPE_COUNT; i++)
+    {
+      const SCommandStats& stats = mCommands[i];
+      if (stats.count == 0)
+        continue;
+      size_t item_len = snprintf(item, sizeof(item), "%s%c:%lu/%lu/%lu", len > 0 ? " " : "",
+        PERF_COMMAND_TYPES[i], static_cast<unsigned long>(stats.count),
+        static_cast<unsigned long>(stats.total_runtime / stats.count), static_cast<unsigned long>(stats.max_runtime));
+      if (len + item_len >= size)
+        break;
+      len = append(buffer, size, len, "%s", item);
+    }
+  }
+  else if (section == 'A')
+  {
+    CEncoderAxis::SPerfCounters az;
+    CEncoderAxis::SPerfCounters el;
+    mAzimuthAxis->get_perf_counters(az);
+    mElevationAxis->get_perf_counters(el);
+    len = append(buffer, size, len, "az:%lu/%lu/%lu el:%lu/%lu/%lu",
+      static_cast<unsigned long>(az.interrupts), static_cast<unsigned long>(az.rejected),
+      static_cast<unsigned long>(az.relay_transitions),
+      static_cast<unsigned long>(el.interrupts), static_cast<unsigned long>(el.rejected),
+      static_cast<unsigned long>(el.relay_transitions));
+  }
+  else if (section == 'S')
+  {
+    len = append(buffer, size, len, "tcp:%lu mqtt:%lu heap:%lu stack:%lu",
+      static_cast<unsigned long>(mTcpConnects), static_cast<unsigned long>(mMqttFailures),
+      static_cast<unsigned long>(free_heap()), static_cast<unsigned long>(free_stack()));
+  }
+  return len;
+}
+
+static size_t append_axis_json(char* buffer, size_t size, size_t len, const char* name, CEncoderAxis* axis)
+{
+  CEncoderAxis::SPerfCounters counters;
+  axis->get_perf_counters(counters);
+  return append(buffer, size, len, "\"%s\": {\"interrupts\": %lu, \"rejected\": %lu, \"relay_transitions\": %lu}, ",
+    name, static_cast<unsigned long>(counters.interrupts), static_cast<unsigned long>(counters.rejected),
+    static_cast<unsigned long>(counters.relay_transitions));
+}
+
+size_t CPerfCounters::format_json(char* buffer, size_t size)
+{
+  size_t len = append(buffer, size, 0, "{\"loop_us\": [");
+  for (uint8_t i = 0; i < PERF_LOOP_BINS; i++)
+    len = append(buffer, size, len, "%s%lu", i > 0 ? ", " : "", static_cast<unsigned long>(mLoopBins[i]));
+
+  len = append(buffer, size, len, "], \"commands\": {");
+  bool first = true;
+  for (uint8_t i = 0; i < PERF_COMMAND_TYPE_COUNT; i++)
+  {
+    const SCommandStats& stats = mCommands[i];
+    if (stats.count == 0)
+      continue;
+    len = append(buffer, size, len, "%s\"%c\": {\"count\": %lu, \"mean_us\": %lu, \"max_us\": %lu}",
+      first ? "" : ", ", PERF_COMMAND_TYPES[i], static_cast<unsigned long>(stats.count),
+      static_cast<unsigned long>(stats.total_runtime / stats.count), static_cast<unsigned long>(stats.max_runtime));
+    first = false;
+  }
+  len = append(buffer, size, len, "}, ");
+
+  len = append_axis_json(buffer, size, len, "az", mAzimuthAxis);
+  len = append_axis_json(buffer, size, len, "el", mElevationAxis);
+
+  len = append(buffer, size, len, "\"tcp_connects\": %lu, \"mqtt_failures\": %lu, \"free_heap\": %lu, \"free_stack\": %lu}",
+    static_cast<unsigned long>(mTcpConnects), static_cast<unsigned long>(mMqttFailures),
+    static_cast<unsigned long>(free_heap()), static_cast<unsigned long>(free_stack()));
+  return len;
+}
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Runtime counters, enabled with -DUSE_PERF_COUNTERS. Without the flag the
+// PERF_* macros compile to nothing and the axes don't carry the counters.
+#ifdef USE_PERF_COUNTERS
+#define PERF_COUNT(counter) ((counter)++)
+#define PERF_LOOP(now) CPerfCounters::record_loop(now)
+#define PERF_COMMAND(command, runtime) CPerfCounters::record_command(command, runtime)
+#define PERF_TCP_CONNECT() CPerfCounters::count_tcp_connect()
+#define PERF_MQTT_FAILURE() CPerfCounters::count_mqtt_failure()
+#else
+#define PERF_COUNT(counter) do {} while (0)
+#define PERF_LOOP(now) do {} while (0)
+#define PERF_COMMAND(command, runtime) do {} while (0)
+#define PERF_TCP_CONNECT() do {} while (0)
+#define PERF_MQTT_FAILURE() do {} while (0)
+#endif
+
+#ifdef USE_PERF_COUNTERS
+
+// Loop period bins, the first ends at 2^PERF_LOOP_BIN_SHIFT us and each next
+// one is twice as wide, the last takes everything longer
+#define PERF_LOOP_BINS 8
+#define PERF_LOOP_BIN_SHIFT 8
+
+// Commands are counted per first letter, rotctld style \get_pos and \set_pos
+// as p and P. Anything else counts as '?'.
+#define PERF_COMMAND_TYPES "pPAEGMSTOV?"
+#define PERF_COMMAND_TYPE_COUNT (sizeof(PERF_COMMAND_TYPES) - 1)
+
+#define PERF_SECTIONS "LCAS"
+
+class CEncoderAxis;
+
+class CPerfCounters
+{
+public:
+  struct SCommandStats
+  {
+    uint32_t count;
+    uint32_t max_runtime;   // us
+    uint32_t total_runtime; // us
+  };
+
+  static void begin(CEncoderAxis& azimuth_axis, CEncoderAxis& elevation_axis);
+
+  // Call at the start of every control loop iteration, now in us
+  static void record_loop(uint32_t now);
+  static void record_command(const char* command, uint32_t runtime);
+  static void count_tcp_connect() { mTcpConnects++; }
+  static void count_mqtt_failure() { mMqttFailures++; }
+
+  static uint8_t command_type(const char* command);
+  static uint32_t free_heap();
+  static uint32_t free_stack(); // lowest free stack seen, bytes
+
+  // One of PERF_SECTIONS as EasyComm response payload: L loop periods,
+  // C commands, A axes, S system. Returns the length.
+  static size_t format_section(char section, char* buffer, size_t size);
+
+  // Everything as a JSON object
+  static size_t format_json(char* buffer, size_t size);
+
+private:
+  CPerfCounters() {}
+
+  static CEncoderAxis* mAzimuthAxis;
+  static CEncoderAxis* mElevationAxis;
+  static uint32_t mLastLoop;
+  static uint32_t mLoopBins[PERF_LOOP_BINS];
+  static SCommandStats mCommands[PERF_COMMAND_TYPE_COUNT];
+  static uint32_t mTcpConnects;
+  static uint32_t mMqttFailures;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifdef IS_D1_MINI
+#define MOT_EL_NEG D8
+#define MOT_EL_POS D7
+#define MOT_AZ_NEG D6
+#define MOT_AZ_POS D5
+#define ENC_AZ     D2
+#define ENC_EL     D1
+// Second encoder channels with -DENC_QUADRATURE, both pulled up at boot
+#define ENC_AZ_B   D3
+#define ENC_EL_B   D4
+#else
+#define MOT_EL_NEG 0
+#define MOT_EL_POS 1
+#define MOT_AZ_NEG 2
+#define MOT_AZ_POS 3
+// Encoder pins must stay on port D (0-7), they use its pin change interrupt
+#define ENC_AZ     4
+#define ENC_EL     5
+// Second encoder channels with -DENC_QUADRATURE
+#define ENC_AZ_B   6
+#define ENC_EL_B   7
+#endif
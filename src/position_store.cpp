@@ -0,0 +1,263 @@
+#include "Arduino.h"
+#include "position_store.h"
+#include "log.h"
+
+// sequence (2), positions (2*4), flags (1), reserved (1), crc (2), padding (2),
+// then the invalidation marker (4) outside the CRC, erased until the record
+// is no longer at rest
+#define STORE_DATA_SIZE 12
+#define STORE_MARKER_OFFSET 16
+#define STORE_RECORD_SIZE 20
+
+#define STORE_FLAG_AT_REST 0x01
+
+#ifdef ARDUINO_ARCH_AVR
+#include <EEPROM.h>
+// Records round robin over EEPROM slots, every cell is written on its own
+#define STORE_BASE_ADDRESS 0
+#define STORE_SLOTS 16
+#else
+#include <flash_hal.h>
+// An append-only log over raw flash sectors at the start of the (unused)
+// filesystem area. Programming only clears bits, so a record is written into
+// erased flash and invalidated in place; a sector is erased only when the log
+// wraps into it, once per STORE_SLOTS_PER_SECTOR saves, and never the one
+// holding the latest record.
+#define STORE_BASE_ADDRESS FS_PHYS_ADDR
+#define STORE_SECTOR_SIZE 4096
+#define STORE_SECTORS 2
+#define STORE_SLOTS_PER_SECTOR (STORE_SECTOR_SIZE / STORE_RECORD_SIZE)
+#define STORE_SLOTS (STORE_SECTORS * STORE_SLOTS_PER_SECTOR)
+#endif
+
+CPositionStore::SPositionRecord CPositionStore::mLatest;
+bool CPositionStore::mLatestValid = false;
+uint16_t CPositionStore::mLatestSlot = 0;
+uint16_t CPositionStore::mNextSlot = 0;
+bool CPositionStore::mResting = false;
+uint32_t CPositionStore::mRestSince = 0;
+
+void CPositionStore::begin()
+{
+  mLatestValid = false;
+  mNextSlot = 0;
+  mResting = false;
+
+#ifndef ARDUINO_ARCH_AVR
+  if (FS_PHYS_SIZE < STORE_SECTORS * STORE_SECTOR_SIZE)
+  {
+    LOG_ERROR("no flash for the position store");
+    return;
+  }
+#endif
+
+  for (uint16_t slot = 0; slot < STORE_SLOTS; slot++)
+  {
+    SPositionRecord record;
+    if (!read_record(slot, record))
+      continue;
+
+    // Sequence numbers wrap, compare the difference
+    if (!mLatestValid || static_cast<int16_t>(record.sequence - mLatest.sequence) > 0)
+    {
+      mLatest = record;
+      mLatestValid = true;
+      mLatestSlot = slot;
+      mNextSlot = (slot + 1) % STORE_SLOTS;
+    }
+  }
+}
+
+bool CPositionStore::load(int32_t& az_position, int32_t& el_position)
+{
+  if (!mLatestValid || !(mLatest.flags & STORE_FLAG_AT_REST))
+    return false;
+
+  az_position = mLatest.az_position;
+  el_position = mLatest.el_position;
+  return true;
+}
+
+void CPositionStore::save(int32_t az_position, int32_t el_position, bool at_rest)
+{
+  if (!at_rest)
+  {
+    // Invalidate the latest record in place, no new record
+    if (mLatestValid && (mLatest.flags & STORE_FLAG_AT_REST))
+    {
+      invalidate_record(mLatestSlot);
+      mLatest.flags &= ~STORE_FLAG_AT_REST;
+    }
+    return;
+  }
+
+  SPositionRecord record;
+  record.sequence = mLatestValid ? mLatest.sequence + 1 : 0;
+  record.az_position = az_position;
+  record.el_position = el_position;
+  record.flags = STORE_FLAG_AT_REST;
+
+  // Skip slots a power loss left half written, they can't be programmed again
+  uint16_t slot = mNextSlot;
+  for (uint16_t i = 0; i < STORE_SLOTS && !prepare_slot(slot); i++)
+    slot = (slot + 1) % STORE_SLOTS;
+  write_record(slot, record);
+
+  mLatest = record;
+  mLatestValid = true;
+  mLatestSlot = slot;
+  mNextSlot = (slot + 1) % STORE_SLOTS;
+}
+
+void CPositionStore::update(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el)
+{
+  bool at_rest = az.motor_state == CEncoderAxis::EMotorStateStopped && az.calibrated &&
+                 el.motor_state == CEncoderAxis::EMotorStateStopped && el.calibrated;
+  bool stored_at_rest = mLatestValid && (mLatest.flags & STORE_FLAG_AT_REST);
+
+  if (!at_rest)
+  {
+    mResting = false;
+    if (stored_at_rest)
+      CPositionStore::save(az.position, el.position, false);
+    return;
+  }
+
+  // Tracking stops every few seconds, only a longer rest is written
+  if (!mResting)
+  {
+    mResting = true;
+    mRestSince = millis();
+  }
+  if (!stored_at_rest && millis() - mRestSince >= STORE_REST_DELAY)
+    CPositionStore::save(az.position, el.position, true);
+}
+
+bool CPositionStore::read_record(uint16_t slot, SPositionRecord& record)
+{
+  uint8_t data[STORE_RECORD_SIZE];
+  read_bytes(slot_address(slot), data, STORE_RECORD_SIZE);
+
+  uint16_t crc = data[STORE_DATA_SIZE] | (static_cast<uint16_t>(data[STORE_DATA_SIZE + 1]) << 8);
+  if (crc != crc16(data, STORE_DATA_SIZE))
+    return false;
+
+  record.sequence    = data[0] | (static_cast<uint16_t>(data[1]) << 8);
+  record.az_position = static_cast<int32_t>(read_uint32(&(data[2])));
+  record.el_position = static_cast<int32_t>(read_uint32(&(data[6])));
+  record.flags       = data[10];
+  if (read_uint32(&(data[STORE_MARKER_OFFSET])) != 0xFFFFFFFF)
+    record.flags &= ~STORE_FLAG_AT_REST;
+  return true;
+}
+
+void CPositionStore::write_record(uint16_t slot, const SPositionRecord& record)
+{
+  uint8_t data[STORE_RECORD_SIZE];
+  serialize(record, data);
+  write_bytes(slot_address(slot), data, STORE_RECORD_SIZE);
+}
+
+void CPositionStore::invalidate_record(uint16_t slot)
+{
+  uint8_t marker[4] = { 0, 0, 0, 0 };
+  write_bytes(slot_address(slot) + STORE_MARKER_OFFSET, marker, sizeof(marker));
+}
+
+uint32_t CPositionStore::slot_address(uint16_t slot)
+{
+#ifdef ARDUINO_ARCH_AVR
+  return STORE_BASE_ADDRESS + slot * STORE_RECORD_SIZE;
+#else
+  return STORE_BASE_ADDRESS + (slot / STORE_SLOTS_PER_SECTOR) * STORE_SECTOR_SIZE +
+         (slot % STORE_SLOTS_PER_SECTOR) * STORE_RECORD_SIZE;
+#endif
+}
+
+// Make a slot ready to be written, returns false when it can't be
+bool CPositionStore::prepare_slot(uint16_t slot)
+{
+#ifdef ARDUINO_ARCH_AVR
+  return true;
+#else
+  // Entering a sector erases it, the latest record is in another one
+  if (slot % STORE_SLOTS_PER_SECTOR == 0)
+    flash_hal_erase(STORE_BASE_ADDRESS + (slot / STORE_SLOTS_PER_SECTOR) * STORE_SECTOR_SIZE, STORE_SECTOR_SIZE);
+
+  uint8_t data[STORE_RECORD_SIZE];
+  read_bytes(slot_address(slot), data, STORE_RECORD_SIZE);
+  for (uint8_t i = 0; i < STORE_RECORD_SIZE; i++)
+  {
+    if (data[i] != 0xFF)
+      return false;
+  }
+  return true;
+#endif
+}
+
+void CPositionStore::read_bytes(uint32_t address, uint8_t* data, uint8_t len)
+{
+#ifdef ARDUINO_ARCH_AVR
+  for (uint8_t i = 0; i < len; i++)
+    data[i] = EEPROM.read(address + i);
+#else
+  flash_hal_read(address, len, data);
+#endif
+}
+
+void CPositionStore::write_bytes(uint32_t address, const uint8_t* data, uint8_t len)
+{
+#ifdef ARDUINO_ARCH_AVR
+  // Only erase/write cells that change
+  for (uint8_t i = 0; i < len; i++)
+    EEPROM.update(address + i, data[i]);
+#else
+  flash_hal_write(address, len, data);
+#endif
+}
+
+void CPositionStore::serialize(const SPositionRecord& record, uint8_t* data)
+{
+  uint32_t az = static_cast<uint32_t>(record.az_position);
+  uint32_t el = static_cast<uint32_t>(record.el_position);
+
+  data[0]  = record.sequence & 0xFF;
+  data[1]  = record.sequence >> 8;
+  data[2]  = az & 0xFF;
+  data[3]  = (az >> 8) & 0xFF;
+  data[4]  = (az >> 16) & 0xFF;
+  data[5]  = (az >> 24) & 0xFF;
+  data[6]  = el & 0xFF;
+  data[7]  = (el >> 8) & 0xFF;
+  data[8]  = (el >> 16) & 0xFF;
+  data[9]  = (el >> 24) & 0xFF;
+  data[10] = record.flags;
+  data[11] = 0xFF;
+
+  uint16_t crc = crc16(data, STORE_DATA_SIZE);
+  data[STORE_DATA_SIZE]     = crc & 0xFF;
+  data[STORE_DATA_SIZE + 1] = crc >> 8;
+  memset(&(data[STORE_DATA_SIZE + 2]), 0xFF, STORE_RECORD_SIZE - STORE_DATA_SIZE - 2);
+}
+
+// Little endian
+uint32_t CPositionStore::read_uint32(const uint8_t* data)
+{
+  return static_cast<uint32_t>(data[0]) |
+         (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t CPositionStore::crc16(const uint8_t* data, uint8_t len)
+{
+  uint16_t crc = 0xFFFF;
+  while (len--)
+  {
+    crc ^= static_cast<uint16_t>(*data++) << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include "encoder_axis.h"
+
+// Positions are written after the axes were at rest this long, ms
+#define STORE_REST_DELAY 10000
+
+// Persistent store for the axis positions, so a restart after a clean
+// shutdown doesn't need homing. Records have a sequence number and CRC; a
+// record torn by a power loss fails its CRC and the previous one is used. On
+// the nano they go round robin over EEPROM slots, on the esp8266 into a log
+// over raw flash sectors, see position_store.cpp. A record stops counting as
+// at rest by overwriting a marker in it, which needs no erase.
+class CPositionStore
+{
+public:
+  // Scan the slots for the latest valid record
+  static void begin();
+
+  // Get the positions of the latest record, returns false when there is none
+  // or the axes were not at rest when it was written
+  static bool load(int32_t& az_position, int32_t& el_position);
+
+  // Append a record at rest, or invalidate the latest one
+  static void save(int32_t az_position, int32_t el_position, bool at_rest);
+
+  // Store the position once both axes have been at rest with a known position
+  // for STORE_REST_DELAY, and invalidate it when they start moving or lose
+  // their calibration, so a power loss then or aborted homing forces homing at
+  // the next boot. Call periodically with the latest snapshots.
+  static void update(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el);
+
+private:
+  struct SPositionRecord
+  {
+    uint16_t sequence;
+    int32_t  az_position;
+    int32_t  el_position;
+    uint8_t  flags;
+  };
+
+  CPositionStore() {}
+  static bool read_record(uint16_t slot, SPositionRecord& record);
+  static void write_record(uint16_t slot, const SPositionRecord& record);
+  static void invalidate_record(uint16_t slot);
+  static uint32_t slot_address(uint16_t slot);
+  static bool prepare_slot(uint16_t slot);
+  static void read_bytes(uint32_t address, uint8_t* data, uint8_t len);
+  static void write_bytes(uint32_t address, const uint8_t* data, uint8_t len);
+  static void serialize(const SPositionRecord& record, uint8_t* data);
+  static uint32_t read_uint32(const uint8_t* data);
+  static uint16_t crc16(const uint8_t* data, uint8_t len);
+
+  static SPositionRecord mLatest;
+  static bool mLatestValid;
+  static uint16_t mLatestSlot;
+  static uint16_t mNextSlot;
+  static bool mResting;
+  static uint32_t mRestSince;
+};
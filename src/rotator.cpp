@@ -1,6 +1,19 @@
 #include <Arduino.h>
+#include "decimal_codec.h"
 #include "easycomm_handler.h"
 #include "encoder_axis.h"
+#include "lcd_framebuffer.h"
+#include "log.h"
+#include "motion_trace.h"
+#include "perf_counters.h"
+#include "pins.h"
+#include "position_store.h"
+#include "rotator_axes.h"
+#include "sat_tracker.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "trajectory.h"
+#include "wall_clock.h"
 
 #ifdef USE_WIFI
 #include <ESP8266WiFi.h>
@@ -9,10 +22,25 @@
 
 #include "credentials.h"
 #define TCP_PORT 4533
+#define MAX_TCP_CLIENTS 4
+#define LOG_TCP_PORT 4534
 WiFiServer wifiServer(TCP_PORT);
+WiFiServer logServer(LOG_TCP_PORT);
+#ifdef USE_EASYCOMM_UDP
+#include <WiFiUdp.h>
+#include "easycomm_udp.h"
+#define UDP_PORT 4533
+WiFiUDP easycommUdp;
+#endif
+WiFiClient logClient;
 WiFiClient wifiClient;
 PubSubClient mqttClient(wifiClient);
-#define MQTT_UPDATE_PERIOD 1000 // ms
+#define MQTT_STATS_PERIOD 10000 // ms
+#define MQTT_BUFFER_SIZE 768 // bytes, fits the stats
+#include <sys/time.h>
+#define NTP_SERVER "pool.ntp.org"
+#define NTP_SYNC_PERIOD 3600000UL // ms
+#define NTP_RETRY_PERIOD 1000 // ms
 #endif
 
 #ifdef USE_LCD
@@ -27,57 +55,141 @@ PubSubClient mqttClient(wifiClient);
 #define LCD_COLS 16
 #define LCD_ROWS 2
 #define DISPLAY_UPDATE_PERIOD 500 // ms
+#define DISPLAY_MOVING_PERIOD 100 // ms
 LiquidCrystal lcd(LCD_RS, LCD_E, LCD_D4, LCD_D5, LCD_D6, LCD_D7);
-#endif
-
-#ifdef IS_D1_MINI
-#define MOT_EL_NEG D8
-#define MOT_EL_POS D7
-#define MOT_AZ_NEG D6
-#define MOT_AZ_POS D5
-#define ENC_AZ     D2
-#define ENC_EL     D1
-#else
-#define MOT_EL_NEG 0
-#define MOT_EL_POS 1
-#define MOT_AZ_NEG 2
-#define MOT_AZ_POS 3
-#define ENC_AZ     4
-#define ENC_EL     5
+CLcdFramebuffer<LiquidCrystal, LCD_COLS, LCD_ROWS> lcd_buffer(lcd);
 #endif
 
 #define BAUD_RATE 9600
 
-CEncoderAxis   azimuth_axis(ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG);
-CEncoderAxis elevation_axis(ENC_EL, MOT_EL_POS, MOT_EL_NEG);
+// Task timing in us. The control deadline counts from the encoder edge that
+// triggered it.
+#define CONTROL_PERIOD      1000
+#define CONTROL_DEADLINE    2000
+#define COMMS_PERIOD        2000
+#define COMMS_DEADLINE      20000
+#define TRACKING_PERIOD     50000
+#define TRACKING_DEADLINE   250000
+#define HOUSEKEEPING_PERIOD 100000
+#define LOG_PERIOD          10000
+#define DISPLAY_PERIOD      5000
+#define DISPLAY_BUDGET      300
+
+#define TASK_PRIORITY_CONTROL   0
+#define TASK_PRIORITY_COMMS     1
+#define TASK_PRIORITY_TRACKING  2
+#define TASK_PRIORITY_REPORTING 3
+#define TASK_PRIORITY_LOG       4
+
+// Pins fixed at compile time, the interrupt handlers below are complete
+// handlers for their axis rather than calls into CEncoderAxis
+CAzimuthAxis     azimuth_axis;
+CElevationAxis elevation_axis;
+
+// Axis state as of the last update, everything but the axes themselves reads these
+CEncoderAxis::SSnapshot az_state;
+CEncoderAxis::SSnapshot el_state;
+
+uint8_t control_task_id = SCHEDULER_NO_TASK;
+#ifdef USE_WIFI
+uint8_t mqtt_task_id = SCHEDULER_NO_TASK;
+#endif
+void scheduler_setup();
 
 void INTERRUPT_FUNC azimuth_enc_interrupt()
 {
   azimuth_axis.enc_interrupt();
+  CScheduler::trigger(control_task_id);
 }
 
 void INTERRUPT_FUNC elevation_enc_interrupt()
 {
   elevation_axis.enc_interrupt();
+  CScheduler::trigger(control_task_id);
+}
+
+#if defined(__AVR_ATmega328P__)
+// The nano's encoder pins aren't external interrupt pins (only 2 and 3 are,
+// which drive relays). They are all on port D and share its pin change
+// interrupt, whose handler passes each change on to the axis of the pin.
+#ifdef ENC_QUADRATURE
+#define ENC_AZ_MASK (_BV(ENC_AZ) | _BV(ENC_AZ_B))
+#define ENC_EL_MASK (_BV(ENC_EL) | _BV(ENC_EL_B))
+static_assert(ENC_AZ_B < 8 && ENC_EL_B < 8, "encoder pins must be on port D");
+#else
+#define ENC_AZ_MASK _BV(ENC_AZ)
+#define ENC_EL_MASK _BV(ENC_EL)
+#endif
+static_assert(ENC_AZ < 8 && ENC_EL < 8, "encoder pins must be on port D");
+
+volatile uint8_t enc_port_state = 0;
+
+ISR(PCINT2_vect)
+{
+  uint8_t state = PIND;
+  uint8_t changed = state ^ enc_port_state;
+  enc_port_state = state;
+
+  if (changed & ENC_AZ_MASK)
+    azimuth_enc_interrupt();
+  if (changed & ENC_EL_MASK)
+    elevation_enc_interrupt();
 }
 
+void attach_enc_interrupts()
+{
+  enc_port_state = PIND;
+  PCMSK2 |= ENC_AZ_MASK | ENC_EL_MASK;
+  PCIFR = _BV(PCIF2);
+  PCICR |= _BV(PCIE2);
+}
+#else
+void attach_enc_interrupts()
+{
+  attachInterrupt(digitalPinToInterrupt(ENC_AZ),   azimuth_enc_interrupt, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(ENC_EL), elevation_enc_interrupt, CHANGE);
+#ifdef ENC_QUADRATURE
+  attachInterrupt(digitalPinToInterrupt(ENC_AZ_B),   azimuth_enc_interrupt, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(ENC_EL_B), elevation_enc_interrupt, CHANGE);
+#endif
+}
+#endif
+
 #ifdef USE_WIFI
 bool is_ota_mode_requested = false;
 bool is_ota_mode = false;
 
+bool mqtt_publish(const char* topic, const char* payload)
+{
+  if (mqttClient.publish(topic, payload))
+    return true;
+  PERF_MQTT_FAILURE();
+  return false;
+}
+
+bool publish_measurements(const uint8_t* payload, size_t len, bool binary)
+{
+  if (!mqttClient.connected())
+    return false;
+  if (mqttClient.publish(binary ? MQTT_TOPIC_PREFIX"/measurements/bin" : MQTT_TOPIC_PREFIX"/measurements", payload, len))
+    return true;
+  PERF_MQTT_FAILURE();
+  return false;
+}
+
 void mqtt_callback(char* topic, byte* payload, uint length)
 {
-  Serial.println("MQTT message received");
+  LOG_DEBUG("MQTT message received");
   if (strncmp((char*)payload, "OTA", 3) == 0)
   {
     is_ota_mode_requested = true;
-    mqttClient.publish(MQTT_TOPIC_PREFIX"/state", "OTA");
-    Serial.println("OTA mode on");
+    mqtt_publish(MQTT_TOPIC_PREFIX"/state", "OTA");
+    LOG_INFO("OTA mode on");
   }
   else
   {
     is_ota_mode_requested = false;
-    Serial.println("OTA mode off");
+    LOG_INFO("OTA mode off");
     if (is_ota_mode)
     {
       ESP.restart();
@@ -89,6 +201,8 @@ void mqtt_connect()
 {
   mqttClient.setServer(mqtt_server, mqtt_port);
   mqttClient.setCallback(mqtt_callback);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+  CTelemetry::begin(publish_measurements);
 
   for (int i = 0; i < 4; i++)
   {
@@ -96,9 +210,9 @@ void mqtt_connect()
         wifi_hostname, mqtt_user, mqtt_pass))
     {
       mqttClient.subscribe(MQTT_TOPIC_PREFIX"/set");
-      mqttClient.publish(MQTT_TOPIC_PREFIX"/state", "NORMAL");
+      mqtt_publish(MQTT_TOPIC_PREFIX"/state", "NORMAL");
       mqttClient.loop();
-      Serial.println("MQTT connected");
+      LOG_INFO("MQTT connected");
       break;
     }
   }
@@ -109,24 +223,96 @@ void wifi_connect()
   WiFi.hostname(wifi_hostname);
   WiFi.begin(wifi_ssid, wifi_pass);
 
-  Serial.print("Connecting to WiFi");
   while (WiFi.status() != WL_CONNECTED)
   {
     delay(100);
-    Serial.print(".");
   }
-  Serial.println();
 
-  Serial.print("Connected, IP address: ");
-  Serial.println(WiFi.localIP());
+  LOG_INFO("connected, IP address %s", WiFi.localIP().toString().c_str());
   wifiServer.begin();
+  logServer.begin();
+#ifdef USE_EASYCOMM_UDP
+  easycommUdp.begin(UDP_PORT);
+#endif
+
+  // UTC, the wall clock is taken over once the first reply is in
+  configTime(0, 0, NTP_SERVER);
 }
+
+uint32_t next_ntp_sync_due = 0;
+
+void ntp_sync()
+{
+  if (static_cast<int32_t>(millis() - next_ntp_sync_due) < 0)
+    return;
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < 1000000000L)
+  {
+    // Not synchronized yet
+    next_ntp_sync_due = millis() + NTP_RETRY_PERIOD;
+    return;
+  }
+
+  CWallClock::set(now.tv_sec, now.tv_usec / 1000);
+  next_ntp_sync_due = millis() + NTP_SYNC_PERIOD;
+}
+#endif
+
+#ifdef USE_WIFI
+// Log lines go to the debug port, or to MQTT when nobody listens there, so the
+// serial port only carries EasyComm traffic
+bool log_sink(const char* line, size_t len)
+{
+  if (logClient.connected())
+  {
+    if (static_cast<size_t>(logClient.availableForWrite()) < len)
+      return false;
+    logClient.write(line, len);
+    return true;
+  }
+  if (mqttClient.connected())
+  {
+    // Without the line end
+    if (mqttClient.publish(MQTT_TOPIC_PREFIX"/log", reinterpret_cast<const uint8_t*>(line), len - 2, false))
+      return true;
+    PERF_MQTT_FAILURE();
+    return false;
+  }
+  return false;
+}
+#else
+// Only take lines that fit in the transmit buffer, so logging never waits for
+// the UART
+bool log_sink(const char* line, size_t len)
+{
+  if (static_cast<size_t>(Serial.availableForWrite()) < len)
+    return false;
+  Serial.write(line, len);
+  return true;
+}
+#endif
+
+void log_task()
+{
+#ifdef USE_WIFI
+  // A new debug port client replaces the old one
+  WiFiClient newClient = logServer.available();
+  if (newClient)
+  {
+    logClient.stop();
+    logClient = newClient;
+  }
 #endif
+  CLog::drain();
+}
 
 void setup() {
   Serial.begin(BAUD_RATE);
   Serial.println();
   Serial.println("PA3RVG Az/El Rotator");
+  CLog::set_sink(log_sink);
 
 #ifdef USE_WIFI
   wifi_connect();
@@ -135,32 +321,93 @@ void setup() {
 
   azimuth_axis.begin();
   elevation_axis.begin();
+#ifdef USE_MOTION_TRACE
+  CMotionTrace::begin(azimuth_axis, elevation_axis);
+#endif
 
-  attachInterrupt(digitalPinToInterrupt(ENC_AZ),   azimuth_enc_interrupt, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(ENC_EL), elevation_enc_interrupt, CHANGE);
-
-  CEasyCommHandler::begin(azimuth_axis, elevation_axis);
+  attach_enc_interrupts();
 
 #ifdef USE_LCD
   lcd.begin(LCD_COLS, LCD_ROWS);
   lcd.setCursor(0,0);
   lcd.print("PA3RVG Az/El Rot");
   delay(1000);
-
-//  lcd.setCursor(0,1);
-//  lcd.print("Homing El..");
 #endif
-  elevation_axis.do_homing_procedure();
 
-#ifdef USE_LCD
-//  lcd.setCursor(0,1);
-//  lcd.print("Homing Az..");
+  CPositionStore::begin();
+  int32_t az_pos = 0;
+  int32_t el_pos = 0;
+  if (CPositionStore::load(az_pos, el_pos))
+  {
+    // Axes were at rest at shutdown, so the stored position is still valid
+    azimuth_axis.set_current_position(az_pos);
+    azimuth_axis.move_to_position(az_pos);
+    elevation_axis.set_current_position(el_pos);
+    elevation_axis.move_to_position(el_pos);
+    LOG_INFO("restored position, skipping homing");
+  }
+  else
+  {
+    // Both axes home in parallel while the main loop keeps running
+    elevation_axis.start_homing();
+    azimuth_axis.start_homing();
+  }
+
+  CEasyCommHandler::begin(azimuth_axis, elevation_axis);
+#ifdef USE_TRAJECTORY
+  CTrajectory::begin(azimuth_axis, elevation_axis);
+#endif
+#ifdef USE_PERF_COUNTERS
+  CPerfCounters::begin(azimuth_axis, elevation_axis);
 #endif
-  azimuth_axis.do_homing_procedure();
+  scheduler_setup();
 }
 
+CEasyCommSession serial_session;
+
 #ifdef USE_WIFI
-WiFiClient curClient;
+WiFiClient tcp_clients[MAX_TCP_CLIENTS];
+CEasyCommSession tcp_sessions[MAX_TCP_CLIENTS];
+uint8_t next_tcp_client = 0;
+
+void accept_tcp_client()
+{
+  WiFiClient newClient = wifiServer.available();
+  if (!newClient)
+  {
+    return;
+  }
+
+  for (uint8_t i = 0; i < MAX_TCP_CLIENTS; i++)
+  {
+    if (!tcp_clients[i].connected())
+    {
+      tcp_clients[i].stop();
+      tcp_clients[i] = newClient;
+      tcp_sessions[i].reset();
+      PERF_TCP_CONNECT();
+      LOG_INFO("client %u connected", i);
+      return;
+    }
+  }
+
+  LOG_WARN("no free client slot, connection refused");
+  newClient.stop();
+}
+
+void handle_tcp_clients()
+{
+  // Start with a different client every iteration so none is always served first
+  for (uint8_t n = 0; n < MAX_TCP_CLIENTS; n++)
+  {
+    uint8_t i = (next_tcp_client + n) % MAX_TCP_CLIENTS;
+    if (tcp_clients[i].connected())
+    {
+      CEasyCommHandler::handle_commands(tcp_clients[i], tcp_sessions[i]);
+    }
+  }
+  next_tcp_client = (next_tcp_client + 1) % MAX_TCP_CLIENTS;
+}
 
 void ota_setup()
 {
@@ -174,30 +421,15 @@ void ota_setup()
     }
 
     // NOTE: if updating FS this would be the place to unmount FS using FS.end()
-    Serial.println("Start updating " + type);
+    LOG_INFO("start updating %s", type.c_str());
   });
 
   ArduinoOTA.onEnd([]() {
-    Serial.println("\nEnd");
-  });
-
-  ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
-    Serial.printf("Progress: %u%%\r", (progress / (total / 100)));
+    LOG_INFO("update done");
   });
 
   ArduinoOTA.onError([](ota_error_t error) {
-    Serial.printf("Error[%u]: ", error);
-    if (error == OTA_AUTH_ERROR) {
-      Serial.println("Auth Failed");
-    } else if (error == OTA_BEGIN_ERROR) {
-      Serial.println("Begin Failed");
-    } else if (error == OTA_CONNECT_ERROR) {
-      Serial.println("Connect Failed");
-    } else if (error == OTA_RECEIVE_ERROR) {
-      Serial.println("Receive Failed");
-    } else if (error == OTA_END_ERROR) {
-      Serial.println("End Failed");
-    }
+    LOG_ERROR("update failed, error %u", error);
   });
 
   ArduinoOTA.begin();
@@ -207,119 +439,130 @@ void ota_loop()
 {
   mqttClient.loop();
   ArduinoOTA.handle();
+  log_task();
   delay(1);
 }
 
-uint32_t next_mqtt_update_due = 0;
 #endif
 
-#ifdef USE_LCD
-uint32_t next_display_update_due = 0;
-#endif
-
-// Init to a value we will never reach to trigger initial update
-int32_t prev_az_set = 7200;
-int32_t prev_el_set = 7200;
-int32_t prev_az_pos = 7200;
-int32_t prev_el_pos = 7200;
-
-void rotator_loop()
+// Stop decisions and setpoint changes, also triggered by every encoder edge
+void control_task()
 {
+  PERF_LOOP(micros());
+  azimuth_axis.update();
+  elevation_axis.update();
+
+  // Read each axis once, commands are answered from the same snapshot
+  azimuth_axis.get_snapshot(az_state);
+  elevation_axis.get_snapshot(el_state);
+  CEasyCommHandler::update(az_state, el_state);
 
 #ifdef USE_WIFI
-  WiFiClient newClient = wifiServer.available();
-  if (newClient)
-  {
-    Serial.println("New client connected");
-    if (curClient.connected())
-    {
-      curClient.stop();
-      Serial.println("Old client disconnected");
-    }
-    curClient = newClient;
-  }
+  if (CTelemetry::has_event(az_state, el_state))
+    CScheduler::trigger(mqtt_task_id);
+#endif
+}
 
-  if (curClient.connected())
-  {
-     CEasyCommHandler::handle_commands(curClient);
-  }
+void comms_task()
+{
+#ifdef USE_WIFI
+  accept_tcp_client();
+  handle_tcp_clients();
+#ifdef USE_EASYCOMM_UDP
+  CEasyCommUdp::handle_datagrams(easycommUdp);
+#endif
 
   mqttClient.loop();
+  ntp_sync();
 #endif
 
-  CEasyCommHandler::handle_commands(Serial);
+  CEasyCommHandler::handle_commands(Serial, serial_session);
+}
 
-  azimuth_axis.update();
-  elevation_axis.update();
+#ifdef USE_TRAJECTORY
+void tracking_task()
+{
+#ifdef USE_SAT_TRACKING
+  CSatTracker::update();
+#endif
+  CTrajectory::update();
+}
+#endif
+
+void housekeeping_task()
+{
+  CPositionStore::update(az_state, el_state);
 
 #ifdef USE_WIFI
   // Move to OTA mode if requested and no axes are moving
-  if (azimuth_axis.is_stopped() && elevation_axis.is_stopped() && is_ota_mode_requested)
+  bool at_rest = az_state.motor_state == CEncoderAxis::EMotorStateStopped &&
+                 el_state.motor_state == CEncoderAxis::EMotorStateStopped;
+  if (at_rest && is_ota_mode_requested)
   {
     ota_setup();
     is_ota_mode = true;
     is_ota_mode_requested = false;
   }
+#endif
+}
 
-  if (millis() >= next_mqtt_update_due)
-  {
-    int32_t cur_az_set = azimuth_axis.get_position_setpoint();
-    int32_t cur_el_set = elevation_axis.get_position_setpoint();
-    int32_t cur_az_pos = azimuth_axis.get_current_position();
-    int32_t cur_el_pos = elevation_axis.get_current_position();
-
-    if (cur_az_set != prev_az_set ||
-        cur_el_set != prev_el_set ||
-        cur_az_pos != prev_az_pos ||
-        cur_el_pos != prev_el_pos)
-    {
-
-      // send values
-      static char json_str[256];
-
-      snprintf(
-        json_str,
-        sizeof(json_str),
-        "{\"az_setpoint\": %0.01f, \"el_setpoint\": %0.01f, \"az_position\": %0.01f, \"el_position\": %0.01f}",
-        cur_az_set/10.0f,
-        cur_el_set/10.0f,
-        cur_az_pos/10.0f,
-        cur_el_pos/10.0f);
-
-      mqttClient.publish(MQTT_TOPIC_PREFIX"/measurements", json_str);
-
-      prev_az_set = cur_az_set;
-      prev_el_set = cur_el_set;
-      prev_az_pos = cur_az_pos;
-      prev_el_pos = cur_el_pos;
-    }
+#ifdef USE_WIFI
+// Runs every moving period, and right away on setpoint changes, starts and stops
+void mqtt_task()
+{
+  CTelemetry::update(az_state, el_state);
 
-    next_mqtt_update_due += MQTT_UPDATE_PERIOD;
+#ifdef USE_PERF_COUNTERS
+  static uint32_t last_stats = 0;
+  if (millis() - last_stats >= MQTT_STATS_PERIOD)
+  {
+    static char stats_str[MQTT_BUFFER_SIZE - 64];
+    CPerfCounters::format_json(stats_str, sizeof(stats_str));
+    mqtt_publish(MQTT_TOPIC_PREFIX"/stats", stats_str);
+    last_stats = millis();
   }
 #endif
+}
+#endif
 
 #ifdef USE_LCD
-    if (millis() >= next_display_update_due)
-    {
-      lcd.setCursor(0,0);
-      lcd.print("Set A ");
-      lcd.print(azimuth_axis.get_position_setpoint()/10);
-      lcd.print(" E ");
-      lcd.print(elevation_axis.get_position_setpoint()/10);
-      lcd.print("     ");
-
-      lcd.setCursor(0,1);
-      lcd.print("Cur A ");
-      lcd.print(azimuth_axis.get_current_position()/10);
-      lcd.print(" E ");
-      lcd.print(elevation_axis.get_current_position()/10);
-      lcd.print("     ");
-
-      next_display_update_due += DISPLAY_UPDATE_PERIOD;
-    }
+// Renders into the framebuffer, faster while moving, and writes out changed
+// cells for at most DISPLAY_BUDGET us per run
+void display_task()
+{
+  static uint32_t last_render = 0;
+  bool moving = az_state.motor_state != CEncoderAxis::EMotorStateStopped ||
+                el_state.motor_state != CEncoderAxis::EMotorStateStopped;
+  if (millis() - last_render >= (moving ? DISPLAY_MOVING_PERIOD : DISPLAY_UPDATE_PERIOD))
+  {
+    char row[32]; // cut off at the display width by set_row()
+    snprintf(row, sizeof(row), "Set A %ld E %ld", (long)(az_state.setpoint/10), (long)(el_state.setpoint/10));
+    lcd_buffer.set_row(0, row);
+    snprintf(row, sizeof(row), "Cur A %ld E %ld", (long)(az_state.position/10), (long)(el_state.position/10));
+    lcd_buffer.set_row(1, row);
+    last_render = millis();
+  }
+
+  lcd_buffer.flush(DISPLAY_BUDGET);
+}
 #endif
 
-    delay(1);
+// Control beats comms, comms beat tracking, reporting and logging come last
+void scheduler_setup()
+{
+  control_task_id = CScheduler::add("control", control_task, CONTROL_PERIOD, CONTROL_DEADLINE, TASK_PRIORITY_CONTROL);
+  CScheduler::add("comms", comms_task, COMMS_PERIOD, COMMS_DEADLINE, TASK_PRIORITY_COMMS);
+#ifdef USE_TRAJECTORY
+  CScheduler::add("tracking", tracking_task, TRACKING_PERIOD, TRACKING_DEADLINE, TASK_PRIORITY_TRACKING);
+#endif
+  CScheduler::add("housekeeping", housekeeping_task, HOUSEKEEPING_PERIOD, HOUSEKEEPING_PERIOD, TASK_PRIORITY_REPORTING);
+#ifdef USE_WIFI
+  mqtt_task_id = CScheduler::add("mqtt", mqtt_task, TELEMETRY_MOVING_PERIOD * 1000UL, TELEMETRY_MOVING_PERIOD * 1000UL, TASK_PRIORITY_REPORTING);
+#endif
+  CScheduler::add("log", log_task, LOG_PERIOD, LOG_PERIOD, TASK_PRIORITY_LOG);
+#ifdef USE_LCD
+  CScheduler::add("display", display_task, DISPLAY_PERIOD, DISPLAY_PERIOD, TASK_PRIORITY_REPORTING);
+#endif
 }
 
 void loop()
@@ -327,5 +570,5 @@ void loop()
 #ifdef USE_WIFI
   if (is_ota_mode) ota_loop(); else
 #endif
-  rotator_loop();
+  CScheduler::run();
 }
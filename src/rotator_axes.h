@@ -0,0 +1,16 @@
+#pragma once
+
+#include "fast_encoder_axis.h"
+#include "pins.h"
+
+// The axes of the rotator, defined in rotator.cpp
+#ifdef ENC_QUADRATURE
+typedef CFastEncoderAxis<ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG, ENC_AZ_B> CAzimuthAxis;
+typedef CFastEncoderAxis<ENC_EL, MOT_EL_POS, MOT_EL_NEG, ENC_EL_B> CElevationAxis;
+#else
+typedef CFastEncoderAxis<ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG> CAzimuthAxis;
+typedef CFastEncoderAxis<ENC_EL, MOT_EL_POS, MOT_EL_NEG> CElevationAxis;
+#endif
+
+extern CAzimuthAxis azimuth_axis;
+extern CElevationAxis elevation_axis;
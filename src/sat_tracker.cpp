@@ -0,0 +1,152 @@
+#include "Arduino.h"
+#include "log.h"
+#include "sat_tracker.h"
+
+#ifdef USE_SAT_TRACKING
+#include "tle.h"
+#include "trajectory.h"
+#include "wall_clock.h"
+
+// Propagation steps, CTrajectory interpolates between them
+#define SAT_TRACK_STEP 2000 // ms
+// Waypoints kept queued ahead of the current time
+#define SAT_TRACK_WAYPOINTS 3
+// Below the horizon the next pass is searched for this far ahead, so the axes
+// can move to its start in advance
+#define SAT_TRACK_SEARCH 600000L // ms
+
+#define TLE_LINE1_VALID 1
+#define TLE_LINE2_VALID 2
+
+CSgp4<float> CSatTracker::mModel;
+CObserver<float> CSatTracker::mObserver;
+STleElements CSatTracker::mElements;
+uint32_t CSatTracker::mLine1Catalog = 0;
+uint8_t CSatTracker::mLinesValid = 0;
+bool CSatTracker::mStationValid = false;
+bool CSatTracker::mTracking = false;
+uint32_t CSatTracker::mBaseTime = 0;
+int32_t CSatTracker::mNextTime = 0;
+
+bool CSatTracker::set_tle_line(uint8_t number, const char* line)
+{
+  uint32_t catalog = 0;
+
+  if (number == 1)
+  {
+    // A new line 1 starts a new element set
+    stop();
+    mLinesValid = 0;
+    if (!CTle::parse_line1(line, mElements, catalog))
+      return false;
+    mLine1Catalog = catalog;
+    mLinesValid = TLE_LINE1_VALID;
+    return true;
+  }
+
+  if (number != 2 || mLinesValid != TLE_LINE1_VALID)
+    return false;
+  if (!CTle::parse_line2(line, mElements, catalog) || catalog != mLine1Catalog)
+    return false;
+  if (!mModel.init(mElements))
+  {
+    LOG_WARN("orbit not supported");
+    return false;
+  }
+  mLinesValid |= TLE_LINE2_VALID;
+  return true;
+}
+
+void CSatTracker::set_station(int32_t latitude, int32_t longitude, int32_t altitude)
+{
+  const float scale = static_cast<float>(M_PI) / 180.0f * 1.0e-4f;
+  mObserver.set(latitude * scale, longitude * scale, altitude * 1.0e-3f);
+  mStationValid = true;
+}
+
+bool CSatTracker::start()
+{
+  if (mLinesValid != (TLE_LINE1_VALID | TLE_LINE2_VALID) || !mStationValid || !CWallClock::is_set())
+    return false;
+
+  mBaseTime = CWallClock::now();
+  mNextTime = 0;
+  CTrajectory::set_base(mBaseTime);
+  mTracking = true;
+  return true;
+}
+
+void CSatTracker::stop()
+{
+  if (mTracking)
+    CTrajectory::clear();
+  mTracking = false;
+}
+
+bool CSatTracker::is_tracking()
+{
+  return mTracking;
+}
+
+bool CSatTracker::get_look_angles(int32_t& azimuth, int32_t& elevation)
+{
+  if (mLinesValid != (TLE_LINE1_VALID | TLE_LINE2_VALID) || !mStationValid || !CWallClock::is_set())
+    return false;
+
+  uint32_t now = CWallClock::now();
+  int32_t ms = CWallClock::ms_since(now);
+  return look_angles_at(now + ms / 1000, ms % 1000, azimuth, elevation);
+}
+
+bool CSatTracker::look_angles_at(uint32_t unix_time, uint16_t ms, int32_t& azimuth, int32_t& elevation)
+{
+  float position[3];
+  float velocity[3];
+  if (!mModel.propagate(mModel.minutes_since_epoch(unix_time, ms), position, velocity))
+    return false;
+
+  float az = 0.0f;
+  float el = 0.0f;
+  float range = 0.0f;
+  mObserver.look_angles(position, unix_time, ms, az, el, range);
+
+  const float scale = 1800.0f / static_cast<float>(M_PI);
+  azimuth = static_cast<int32_t>(az * scale + 0.5f) % 3600;
+  elevation = static_cast<int32_t>(el * scale + (el < 0.0f ? -0.5f : 0.5f));
+  return true;
+}
+
+void CSatTracker::update()
+{
+  if (!mTracking || CTrajectory::size() >= SAT_TRACK_WAYPOINTS)
+    return;
+
+  // Never queue behind the current time, e.g. after the satellite was below
+  // the horizon
+  int32_t now = CWallClock::ms_since(mBaseTime);
+  if (mNextTime < now)
+    mNextTime = now - now % SAT_TRACK_STEP + SAT_TRACK_STEP;
+  if (mNextTime > now + SAT_TRACK_SEARCH)
+    return;
+
+  // One propagation per call keeps the loop responsive
+  int32_t time = mNextTime;
+  mNextTime += SAT_TRACK_STEP;
+
+  int32_t azimuth = 0;
+  int32_t elevation = 0;
+  if (!look_angles_at(mBaseTime + time / 1000, time % 1000, azimuth, elevation))
+  {
+    LOG_ERROR("propagation failed, tracking stopped");
+    stop();
+    return;
+  }
+
+  // Below the horizon the axes stay where they are
+  if (elevation < 0)
+    return;
+
+  CTrajectory::add(time, azimuth, elevation);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "observer.h"
+#include "sgp4.h"
+
+#if defined(USE_SAT_TRACKING) && !defined(USE_TRAJECTORY)
+#error "USE_SAT_TRACKING needs USE_TRAJECTORY"
+#endif
+
+// Autonomous satellite tracking: propagates a TLE on the device and queues
+// the look angles from the station as waypoints of CTrajectory, which
+// interpolates them and drives the axes. Needs the wall clock to be set.
+// Built with USE_SAT_TRACKING, which the nano leaves off for RAM.
+class CSatTracker
+{
+public:
+  // TLE line 1 or 2, returns false when it doesn't parse or the lines are of
+  // different satellites
+  static bool set_tle_line(uint8_t number, const char* line);
+
+  // Latitude and longitude in 1e-4 deg, altitude in m
+  static void set_station(int32_t latitude, int32_t longitude, int32_t altitude);
+
+  // Returns false when the TLE, station or clock is missing
+  static bool start();
+  static void stop();
+  static bool is_tracking();
+
+  // Current look angles in 1e-1 deg
+  static bool get_look_angles(int32_t& azimuth, int32_t& elevation);
+
+  // Queue waypoints ahead, call once per loop iteration
+  static void update();
+
+private:
+  CSatTracker() {}
+  static bool look_angles_at(uint32_t unix_time, uint16_t ms, int32_t& azimuth, int32_t& elevation);
+
+  static CSgp4<float> mModel;
+  static CObserver<float> mObserver;
+  static STleElements mElements;
+  static uint32_t mLine1Catalog;
+  static uint8_t mLinesValid;
+  static bool mStationValid;
+  static bool mTracking;
+  static uint32_t mBaseTime;
+  static int32_t mNextTime;
+};
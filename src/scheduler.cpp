@@ -0,0 +1,161 @@
+#include "Arduino.h"
+#include "log.h"
+#include "scheduler.h"
+
+#ifdef ARDUINO_ARCH_AVR
+#include <avr/sleep.h>
+#endif
+
+// Idle time slice of the host build, where idling advances the simulation
+#define SCHEDULER_IDLE_STEP 100 // us
+
+CScheduler::STask CScheduler::mTasks[SCHEDULER_MAX_TASKS];
+CScheduler::STaskStats CScheduler::mStats[SCHEDULER_MAX_TASKS];
+volatile bool CScheduler::mTriggered[SCHEDULER_MAX_TASKS];
+volatile uint32_t CScheduler::mTriggerTime[SCHEDULER_MAX_TASKS];
+uint8_t CScheduler::mTaskCount = 0;
+
+uint8_t CScheduler::add(const char* name, task_func_t run, uint32_t period, uint32_t deadline, uint8_t priority)
+{
+  if (mTaskCount == SCHEDULER_MAX_TASKS)
+  {
+    LOG_ERROR("too many tasks");
+    return SCHEDULER_NO_TASK;
+  }
+
+  uint8_t task = mTaskCount;
+  mTasks[task].run = run;
+  mTasks[task].period = period;
+  mTasks[task].deadline = deadline;
+  mTasks[task].next_release = micros();
+  mTasks[task].priority = priority;
+  mStats[task].name = name;
+  mStats[task].runs = 0;
+  mStats[task].overruns = 0;
+  mStats[task].max_runtime = 0;
+  mTriggered[task] = false;
+  mTaskCount++;
+  return task;
+}
+
+// Only the first trigger before the task runs counts, so its deadline is
+// taken from the oldest event
+void CScheduler::trigger(uint8_t task)
+{
+  if (task < mTaskCount && !mTriggered[task])
+  {
+    mTriggerTime[task] = micros();
+    mTriggered[task] = true;
+  }
+}
+
+void CScheduler::run()
+{
+  uint32_t now = micros();
+  uint8_t next = SCHEDULER_NO_TASK;
+  uint32_t next_due = 0;
+
+  for (uint8_t i = 0; i < mTaskCount; i++)
+  {
+    // The trigger time is stable while the flag is set
+    uint32_t release;
+    if (mTriggered[i])
+      release = mTriggerTime[i];
+    else if (mTasks[i].period != 0 && static_cast<int32_t>(now - mTasks[i].next_release) >= 0)
+      release = mTasks[i].next_release;
+    else
+      continue;
+
+    uint32_t due = release + mTasks[i].deadline;
+    if (next == SCHEDULER_NO_TASK ||
+        mTasks[i].priority < mTasks[next].priority ||
+        (mTasks[i].priority == mTasks[next].priority && static_cast<int32_t>(due - next_due) < 0))
+    {
+      next = i;
+      next_due = due;
+    }
+  }
+
+  if (next == SCHEDULER_NO_TASK)
+  {
+    idle(now);
+    return;
+  }
+
+  STask& task = mTasks[next];
+  mTriggered[next] = false;
+  if (task.period != 0 && static_cast<int32_t>(now - task.next_release) >= 0)
+  {
+    // Periodic releases that were missed entirely are skipped
+    task.next_release += task.period;
+    if (static_cast<int32_t>(now - task.next_release) >= 0)
+      task.next_release = now + task.period;
+  }
+
+  uint32_t start = micros();
+  task.run();
+  uint32_t end = micros();
+
+  STaskStats& stats = mStats[next];
+  stats.runs++;
+  if (end - start > stats.max_runtime)
+    stats.max_runtime = end - start;
+  if (static_cast<int32_t>(end - next_due) > 0)
+    stats.overruns++;
+}
+
+bool CScheduler::is_triggered()
+{
+  for (uint8_t i = 0; i < mTaskCount; i++)
+  {
+    if (mTriggered[i])
+      return true;
+  }
+  return false;
+}
+
+// Sleep until the next release at most; any interrupt ends it early
+void CScheduler::idle(uint32_t now)
+{
+  uint32_t wait = 0xffffffffUL;
+  for (uint8_t i = 0; i < mTaskCount; i++)
+  {
+    if (mTasks[i].period != 0 && mTasks[i].next_release - now < wait)
+      wait = mTasks[i].next_release - now;
+  }
+
+#if defined(ARDUINO_ARCH_AVR)
+  // Idle mode keeps the timers and UART running, the timer 0 overflow wakes
+  // the CPU at least every 1 ms. Interrupts are enabled right before sleeping,
+  // so a trigger can't slip in between the check and the sleep.
+  (void)wait;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  noInterrupts();
+  if (!is_triggered())
+  {
+    sleep_enable();
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+  }
+  interrupts();
+#elif defined(ARDUINO)
+  // delay() lets the WiFi stack run and the modem sleep
+  if (wait >= 1000 && !is_triggered())
+    delay(1);
+  else
+    yield();
+#else
+  delayMicroseconds(wait < SCHEDULER_IDLE_STEP ? wait : SCHEDULER_IDLE_STEP);
+#endif
+}
+
+uint8_t CScheduler::task_count()
+{
+  return mTaskCount;
+}
+
+const CScheduler::STaskStats& CScheduler::get_stats(uint8_t task)
+{
+  return mStats[task];
+}
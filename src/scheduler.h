@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef ARDUINO_ARCH_AVR
+#define SCHEDULER_MAX_TASKS 6
+#else
+#define SCHEDULER_MAX_TASKS 8
+#endif
+#define SCHEDULER_NO_TASK 0xff
+
+// Cooperative fixed priority scheduler. Tasks are released periodically or
+// triggered (e.g. from an interrupt handler) and run to completion; of the
+// ready tasks the one with the highest priority (lowest number) runs first,
+// earliest deadline on a tie. A triggered task therefore starts at the latest
+// when the task running at that moment returns. When nothing is ready the CPU
+// idles until the next release or interrupt.
+class CScheduler
+{
+public:
+  typedef void (*task_func_t)();
+
+  struct STaskStats
+  {
+    const char* name;
+    uint32_t runs;
+    uint32_t overruns;    // runs that finished after their deadline
+    uint32_t max_runtime; // us
+  };
+
+  // Period and deadline in us, the deadline is relative to the release. A
+  // period of 0 only runs the task when triggered. Returns the task index or
+  // SCHEDULER_NO_TASK when the table is full.
+  static uint8_t add(const char* name, task_func_t run, uint32_t period, uint32_t deadline, uint8_t priority);
+
+  // Make a task ready now, safe to call from an interrupt handler
+  static void INTERRUPT_FUNC trigger(uint8_t task);
+
+  // Run the next ready task, or idle when there is none. Call from loop().
+  static void run();
+
+  static uint8_t task_count();
+  static const STaskStats& get_stats(uint8_t task);
+
+private:
+  struct STask
+  {
+    task_func_t run;
+    uint32_t period;
+    uint32_t deadline;
+    uint32_t next_release; // us
+    uint8_t priority;
+  };
+
+  CScheduler() {}
+  static bool is_triggered();
+  static void idle(uint32_t now);
+
+  static STask mTasks[SCHEDULER_MAX_TASKS];
+  static STaskStats mStats[SCHEDULER_MAX_TASKS];
+  static volatile bool mTriggered[SCHEDULER_MAX_TASKS];
+  static volatile uint32_t mTriggerTime[SCHEDULER_MAX_TASKS];
+  static uint8_t mTaskCount;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Single byte loads and stores are atomic on the AVR, wider ones elsewhere keep
+// a preempted reader from missing a full wrap of the sequence
+#ifdef ARDUINO_ARCH_AVR
+typedef uint8_t seqlock_sequence_t;
+#else
+typedef uint32_t seqlock_sequence_t;
+#endif
+
+// Sequence lock: one writer publishes a value that readers copy without
+// disabling interrupts. The sequence is odd while a write is in progress;
+// readers retry until they saw the same even sequence before and after their
+// copy, so they never see a mix of old and new fields.
+//
+// A reader must not preempt the writer (it would spin forever), so the writer
+// runs in the lowest priority context, e.g. the main loop.
+template<class T>
+class CSeqLock
+{
+public:
+  CSeqLock() : mValue(), mSequence(0) {}
+
+  void write(const T& value)
+  {
+    seqlock_sequence_t sequence = mSequence;
+    __atomic_store_n(&mSequence, static_cast<seqlock_sequence_t>(sequence + 1), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    mValue = value;
+    __atomic_store_n(&mSequence, static_cast<seqlock_sequence_t>(sequence + 2), __ATOMIC_RELEASE);
+  }
+
+  void read(T& value) const
+  {
+    seqlock_sequence_t before;
+    seqlock_sequence_t after;
+    do
+    {
+      before = __atomic_load_n(&mSequence, __ATOMIC_ACQUIRE);
+      value = mValue;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      after = __atomic_load_n(&mSequence, __ATOMIC_RELAXED);
+    }
+    while ((before & 1) || before != after);
+  }
+
+  // Changes with every write, readers can use it to skip unchanged values
+  seqlock_sequence_t sequence() const
+  {
+    return __atomic_load_n(&mSequence, __ATOMIC_ACQUIRE);
+  }
+
+private:
+  T mValue;
+  seqlock_sequence_t mSequence;
+};
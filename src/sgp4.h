@@ -0,0 +1,344 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// SGP4 orbit propagator for near-earth orbits (period below 225 min), as in
+// Spacetrack Report #3, with the WGS-72 constants TLEs are generated with.
+// Deep space orbits are rejected. The model is a template on the real type:
+// the firmware uses float, the host tests compare it to the double version.
+
+// Mean elements of a TLE, angles in rad, mean motion in rad/min
+struct STleElements
+{
+  uint32_t epoch_time;  // unix time, seconds
+  uint16_t epoch_ms;    // ms part of the epoch
+  float bstar;          // 1/earth radii
+  float inclination;
+  float raan;
+  float eccentricity;
+  float arg_perigee;
+  float mean_anomaly;
+  float mean_motion;
+};
+
+// Math functions resolving to the single precision versions for float, so
+// the float model doesn't silently compute in double on the host
+inline float sgp4_sin(float x) { return sinf(x); }
+inline float sgp4_cos(float x) { return cosf(x); }
+inline float sgp4_sqrt(float x) { return sqrtf(x); }
+inline float sgp4_pow(float x, float y) { return powf(x, y); }
+inline float sgp4_atan2(float y, float x) { return atan2f(y, x); }
+inline float sgp4_asin(float x) { return asinf(x); }
+inline float sgp4_fmod(float x, float y) { return fmodf(x, y); }
+inline float sgp4_fabs(float x) { return fabsf(x); }
+inline double sgp4_sin(double x) { return sin(x); }
+inline double sgp4_cos(double x) { return cos(x); }
+inline double sgp4_sqrt(double x) { return sqrt(x); }
+inline double sgp4_pow(double x, double y) { return pow(x, y); }
+inline double sgp4_atan2(double y, double x) { return atan2(y, x); }
+inline double sgp4_asin(double x) { return asin(x); }
+inline double sgp4_fmod(double x, double y) { return fmod(x, y); }
+inline double sgp4_fabs(double x) { return fabs(x); }
+
+template<class T>
+class CSgp4
+{
+public:
+  CSgp4() : mValid(false) {}
+
+  // Returns false for deep space or decayed orbits
+  bool init(const STleElements& elements)
+  {
+    const T two_thirds = T(2.0) / T(3.0);
+
+    mValid = false;
+    mEpochTime = elements.epoch_time;
+    mEpochMs = elements.epoch_ms;
+    mBstar = elements.bstar;
+    mInclination = elements.inclination;
+    mRaan = elements.raan;
+    mEccentricity = elements.eccentricity;
+    mArgPerigee = elements.arg_perigee;
+    mMeanAnomaly = elements.mean_anomaly;
+    T no = elements.mean_motion;
+    T eo = mEccentricity;
+
+    // Recover the original mean motion and semi-major axis
+    T a1 = sgp4_pow(xke() / no, two_thirds);
+    mCosio = sgp4_cos(mInclination);
+    mSinio = sgp4_sin(mInclination);
+    T theta2 = mCosio * mCosio;
+    mX3thm1 = T(3.0) * theta2 - T(1.0);
+    T eosq = eo * eo;
+    T betao2 = T(1.0) - eosq;
+    T betao = sgp4_sqrt(betao2);
+    T del1 = T(1.5) * ck2() * mX3thm1 / (a1 * a1 * betao * betao2);
+    T ao = a1 * (T(1.0) - del1 * (T(0.5) * two_thirds + del1 * (T(1.0) + T(134.0) / T(81.0) * del1)));
+    T delo = T(1.5) * ck2() * mX3thm1 / (ao * ao * betao * betao2);
+    mXnodp = no / (T(1.0) + delo);
+    mAodp = ao / (T(1.0) - delo);
+
+    if (T(2.0) * T(M_PI) / mXnodp >= T(225.0))
+      return false;
+
+    // Perigee below 220 km uses a truncated drag model
+    mIsimp = mAodp * (T(1.0) - eo) < T(220.0) / xkmper() + T(1.0);
+
+    T s4 = T(1.01222928);
+    T qoms24 = T(1.88027916e-9);
+    T perigee = (mAodp * (T(1.0) - eo) - T(1.0)) * xkmper();
+    if (perigee < T(156.0))
+    {
+      s4 = perigee - T(78.0);
+      if (perigee <= T(98.0))
+        s4 = T(20.0);
+      T q = (T(120.0) - s4) / xkmper();
+      qoms24 = q * q * q * q;
+      s4 = s4 / xkmper() + T(1.0);
+    }
+    if (perigee < T(0.0))
+      return false;
+
+    T pinvsq = T(1.0) / (mAodp * mAodp * betao2 * betao2);
+    T tsi = T(1.0) / (mAodp - s4);
+    mEta = mAodp * eo * tsi;
+    T etasq = mEta * mEta;
+    T eeta = eo * mEta;
+    T psisq = sgp4_fabs(T(1.0) - etasq);
+    T tsi2 = tsi * tsi;
+    T coef = qoms24 * tsi2 * tsi2;
+    T coef1 = coef / sgp4_pow(psisq, T(3.5));
+    T c2 = coef1 * mXnodp * (mAodp * (T(1.0) + T(1.5) * etasq + eeta * (T(4.0) + etasq)) +
+      T(0.75) * ck2() * tsi / psisq * mX3thm1 * (T(8.0) + T(3.0) * etasq * (T(8.0) + etasq)));
+    mC1 = mBstar * c2;
+    T a3ovk2 = -xj3() / ck2();
+    T c3 = eo > T(1.0e-4) ? coef * tsi * a3ovk2 * mXnodp * mSinio / eo : T(0.0);
+    mX1mth2 = T(1.0) - theta2;
+    mC4 = T(2.0) * mXnodp * coef1 * mAodp * betao2 * (mEta * (T(2.0) + T(0.5) * etasq) +
+      eo * (T(0.5) + T(2.0) * etasq) - T(2.0) * ck2() * tsi / (mAodp * psisq) *
+      (T(-3.0) * mX3thm1 * (T(1.0) - T(2.0) * eeta + etasq * (T(1.5) - T(0.5) * eeta)) +
+      T(0.75) * mX1mth2 * (T(2.0) * etasq - eeta * (T(1.0) + etasq)) * sgp4_cos(T(2.0) * mArgPerigee)));
+    mC5 = T(2.0) * coef1 * mAodp * betao2 * (T(1.0) + T(2.75) * (etasq + eeta) + eeta * etasq);
+
+    // Secular rates
+    T theta4 = theta2 * theta2;
+    T temp1 = T(3.0) * ck2() * pinvsq * mXnodp;
+    T temp2 = temp1 * ck2() * pinvsq;
+    T temp3 = T(1.25) * ck4() * pinvsq * pinvsq * mXnodp;
+    mXmdot = mXnodp + T(0.5) * temp1 * betao * mX3thm1 +
+      T(0.0625) * temp2 * betao * (T(13.0) - T(78.0) * theta2 + T(137.0) * theta4);
+    T x1m5th = T(1.0) - T(5.0) * theta2;
+    mOmgdot = T(-0.5) * temp1 * x1m5th + T(0.0625) * temp2 * (T(7.0) - T(114.0) * theta2 + T(395.0) * theta4) +
+      temp3 * (T(3.0) - T(36.0) * theta2 + T(49.0) * theta4);
+    T xhdot1 = -temp1 * mCosio;
+    mXnodot = xhdot1 + (T(0.5) * temp2 * (T(4.0) - T(19.0) * theta2) + T(2.0) * temp3 * (T(3.0) - T(7.0) * theta2)) * mCosio;
+    mOmgcof = mBstar * c3 * sgp4_cos(mArgPerigee);
+    mXmcof = eo > T(1.0e-4) ? -two_thirds * coef * mBstar / eeta : T(0.0);
+    mXnodcf = T(3.5) * betao2 * xhdot1 * mC1;
+    mT2cof = T(1.5) * mC1;
+    mXlcof = T(0.125) * a3ovk2 * mSinio * (T(3.0) + T(5.0) * mCosio) / (T(1.0) + mCosio);
+    mAycof = T(0.25) * a3ovk2 * mSinio;
+    T delmo = T(1.0) + mEta * sgp4_cos(mMeanAnomaly);
+    mDelmo = delmo * delmo * delmo;
+    mSinmo = sgp4_sin(mMeanAnomaly);
+    mX7thm1 = T(7.0) * theta2 - T(1.0);
+
+    if (!mIsimp)
+    {
+      T c1sq = mC1 * mC1;
+      mD2 = T(4.0) * mAodp * tsi * c1sq;
+      T temp = mD2 * tsi * mC1 / T(3.0);
+      mD3 = (T(17.0) * mAodp + s4) * temp;
+      mD4 = T(0.5) * temp * mAodp * tsi * (T(221.0) * mAodp + T(31.0) * s4) * mC1;
+      mT3cof = mD2 + T(2.0) * c1sq;
+      mT4cof = T(0.25) * (T(3.0) * mD3 + mC1 * (T(12.0) * mD2 + T(10.0) * c1sq));
+      mT5cof = T(0.2) * (T(3.0) * mD4 + T(12.0) * mC1 * mD3 + T(6.0) * mD2 * mD2 + T(15.0) * c1sq * (T(2.0) * mD2 + c1sq));
+    }
+
+    mValid = true;
+    return true;
+  }
+
+  bool is_valid() const
+  {
+    return mValid;
+  }
+
+  // Minutes since the TLE epoch of the given unix time
+  T minutes_since_epoch(uint32_t unix_time, uint16_t ms) const
+  {
+    int32_t seconds = static_cast<int32_t>(unix_time - mEpochTime);
+    int32_t msec = static_cast<int32_t>(ms) - static_cast<int32_t>(mEpochMs);
+    return (T(seconds) + T(msec) / T(1000.0)) / T(60.0);
+  }
+
+  // Position (km) and velocity (km/s) in the TEME frame. Returns false when
+  // the orbit has decayed.
+  bool propagate(T tsince, T position[3], T velocity[3]) const
+  {
+    if (!mValid)
+      return false;
+
+    // Secular gravity and atmospheric drag
+    T xmdf = mMeanAnomaly + mXmdot * tsince;
+    T omgadf = mArgPerigee + mOmgdot * tsince;
+    T xnoddf = mRaan + mXnodot * tsince;
+    T omega = omgadf;
+    T xmp = xmdf;
+    T tsq = tsince * tsince;
+    T xnode = xnoddf + mXnodcf * tsq;
+    T tempa = T(1.0) - mC1 * tsince;
+    T tempe = mBstar * mC4 * tsince;
+    T templ = mT2cof * tsq;
+    if (!mIsimp)
+    {
+      T delomg = mOmgcof * tsince;
+      T delm = T(1.0) + mEta * sgp4_cos(xmdf);
+      delm = mXmcof * (delm * delm * delm - mDelmo);
+      T temp = delomg + delm;
+      xmp = xmdf + temp;
+      omega = omgadf - temp;
+      T tcube = tsq * tsince;
+      T tfour = tsince * tcube;
+      tempa = tempa - mD2 * tsq - mD3 * tcube - mD4 * tfour;
+      tempe = tempe + mBstar * mC5 * (sgp4_sin(xmp) - mSinmo);
+      templ = templ + mT3cof * tcube + tfour * (mT4cof + tsince * mT5cof);
+    }
+    T a = mAodp * tempa * tempa;
+    T e = mEccentricity - tempe;
+    if (e < T(1.0e-6))
+      e = T(1.0e-6);
+    if (a < T(0.95) || e >= T(1.0))
+      return false;
+    T xl = xmp + omega + xnode + mXnodp * templ;
+    T beta = sgp4_sqrt(T(1.0) - e * e);
+    T xn = xke() / sgp4_pow(a, T(1.5));
+
+    // Long period periodics
+    T axn = e * sgp4_cos(omega);
+    T temp = T(1.0) / (a * beta * beta);
+    T xll = temp * mXlcof * axn;
+    T aynl = temp * mAycof;
+    T xlt = xl + xll;
+    T ayn = e * sgp4_sin(omega) + aynl;
+
+    // Solve Kepler's equation
+    T capu = sgp4_fmod(xlt - xnode, T(2.0) * T(M_PI));
+    T epw = capu;
+    T sinepw = T(0.0);
+    T cosepw = T(1.0);
+    for (uint8_t i = 0; i < 10; i++)
+    {
+      sinepw = sgp4_sin(epw);
+      cosepw = sgp4_cos(epw);
+      T delta = (capu - ayn * cosepw + axn * sinepw - epw) / (T(1.0) - axn * cosepw - ayn * sinepw);
+      epw += delta;
+      if (sgp4_fabs(delta) <= T(1.0e-6))
+        break;
+    }
+    sinepw = sgp4_sin(epw);
+    cosepw = sgp4_cos(epw);
+
+    // Short period preliminary quantities
+    T ecose = axn * cosepw + ayn * sinepw;
+    T esine = axn * sinepw - ayn * cosepw;
+    T elsq = axn * axn + ayn * ayn;
+    temp = T(1.0) - elsq;
+    T pl = a * temp;
+    T r = a * (T(1.0) - ecose);
+    T temp1 = T(1.0) / r;
+    T rdot = xke() * sgp4_sqrt(a) * esine * temp1;
+    T rfdot = xke() * sgp4_sqrt(pl) * temp1;
+    T temp2 = a * temp1;
+    T betal = sgp4_sqrt(temp);
+    T temp3 = T(1.0) / (T(1.0) + betal);
+    T cosu = temp2 * (cosepw - axn + ayn * esine * temp3);
+    T sinu = temp2 * (sinepw - ayn - axn * esine * temp3);
+    T u = sgp4_atan2(sinu, cosu);
+    T sin2u = T(2.0) * sinu * cosu;
+    T cos2u = T(2.0) * cosu * cosu - T(1.0);
+    temp = T(1.0) / pl;
+    temp1 = ck2() * temp;
+    temp2 = temp1 * temp;
+
+    // Short period periodics
+    T rk = r * (T(1.0) - T(1.5) * temp2 * betal * mX3thm1) + T(0.5) * temp1 * mX1mth2 * cos2u;
+    T uk = u - T(0.25) * temp2 * mX7thm1 * sin2u;
+    T xnodek = xnode + T(1.5) * temp2 * mCosio * sin2u;
+    T xinck = mInclination + T(1.5) * temp2 * mCosio * mSinio * cos2u;
+    T rdotk = rdot - xn * temp1 * mX1mth2 * sin2u;
+    T rfdotk = rfdot + xn * temp1 * (mX1mth2 * cos2u + T(1.5) * mX3thm1);
+
+    // Orientation vectors
+    T sinuk = sgp4_sin(uk);
+    T cosuk = sgp4_cos(uk);
+    T sinik = sgp4_sin(xinck);
+    T cosik = sgp4_cos(xinck);
+    T sinnok = sgp4_sin(xnodek);
+    T cosnok = sgp4_cos(xnodek);
+    T xmx = -sinnok * cosik;
+    T xmy = cosnok * cosik;
+    T ux = xmx * sinuk + cosnok * cosuk;
+    T uy = xmy * sinuk + sinnok * cosuk;
+    T uz = sinik * sinuk;
+    T vx = xmx * cosuk - cosnok * sinuk;
+    T vy = xmy * cosuk - sinnok * sinuk;
+    T vz = sinik * cosuk;
+
+    position[0] = rk * ux * xkmper();
+    position[1] = rk * uy * xkmper();
+    position[2] = rk * uz * xkmper();
+    velocity[0] = (rdotk * ux + rfdotk * vx) * xkmper() / T(60.0);
+    velocity[1] = (rdotk * uy + rfdotk * vy) * xkmper() / T(60.0);
+    velocity[2] = (rdotk * uz + rfdotk * vz) * xkmper() / T(60.0);
+    return true;
+  }
+
+private:
+  // WGS-72 constants
+  static T xke() { return T(0.0743669161); }   // sqrt(GM) in earth radii^1.5 / min
+  static T ck2() { return T(5.413080e-4); }    // J2 / 2
+  static T ck4() { return T(0.62098875e-6); }  // -3 J4 / 8
+  static T xj3() { return T(-0.253881e-5); }
+  static T xkmper() { return T(6378.135); }    // km per earth radius
+
+  bool mValid;
+  bool mIsimp;
+  uint32_t mEpochTime;
+  uint16_t mEpochMs;
+  T mBstar;
+  T mInclination;
+  T mRaan;
+  T mEccentricity;
+  T mArgPerigee;
+  T mMeanAnomaly;
+  T mXnodp;
+  T mAodp;
+  T mCosio;
+  T mSinio;
+  T mEta;
+  T mX3thm1;
+  T mX1mth2;
+  T mX7thm1;
+  T mC1;
+  T mC4;
+  T mC5;
+  T mD2;
+  T mD3;
+  T mD4;
+  T mXmdot;
+  T mOmgdot;
+  T mXnodot;
+  T mOmgcof;
+  T mXmcof;
+  T mXnodcf;
+  T mT2cof;
+  T mT3cof;
+  T mT4cof;
+  T mT5cof;
+  T mXlcof;
+  T mAycof;
+  T mDelmo;
+  T mSinmo;
+};
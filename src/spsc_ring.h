@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer ring buffer, e.g. for passing
+// events from an interrupt handler to the main loop. The indices are free
+// running 8 bit counters, written by one side only, so they can be read
+// without disabling interrupts. SIZE must be a power of two, at most 128.
+template<class T, uint8_t SIZE>
+class CSpscRing
+{
+public:
+  CSpscRing() : mHead(0), mTail(0), mOverflowCount(0) {}
+
+  // Producer side, returns false (and counts an overflow) when full
+  bool push(const T& item)
+  {
+    uint8_t head = mHead;
+    uint8_t tail = __atomic_load_n(&mTail, __ATOMIC_ACQUIRE);
+    if (static_cast<uint8_t>(head - tail) == SIZE)
+    {
+      __atomic_store_n(&mOverflowCount, static_cast<uint8_t>(mOverflowCount + 1), __ATOMIC_RELAXED);
+      return false;
+    }
+    mItems[head & (SIZE - 1)] = item;
+    __atomic_store_n(&mHead, static_cast<uint8_t>(head + 1), __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Consumer side, returns false when empty
+  bool pop(T& item)
+  {
+    uint8_t tail = mTail;
+    uint8_t head = __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+      return false;
+    }
+    item = mItems[tail & (SIZE - 1)];
+    __atomic_store_n(&mTail, static_cast<uint8_t>(tail + 1), __ATOMIC_RELEASE);
+    return true;
+  }
+
+  uint8_t size()
+  {
+    return __atomic_load_n(&mHead, __ATOMIC_ACQUIRE) - __atomic_load_n(&mTail, __ATOMIC_ACQUIRE);
+  }
+
+  // Free running count of rejected pushes, wraps at 256. Consumers track the
+  // difference to the previous read.
+  uint8_t overflow_count()
+  {
+    return __atomic_load_n(&mOverflowCount, __ATOMIC_RELAXED);
+  }
+
+private:
+  static_assert(SIZE > 0 && SIZE <= 128 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two up to 128");
+
+  T mItems[SIZE];
+  uint8_t mHead;
+  uint8_t mTail;
+  uint8_t mOverflowCount;
+};
@@ -0,0 +1,144 @@
+#include "Arduino.h"
+#include "telemetry.h"
+#include "decimal_codec.h"
+
+CTelemetry::publish_t CTelemetry::mPublish = NULL;
+int32_t CTelemetry::mPublished[EFieldCount];
+bool CTelemetry::mValid = false;
+uint32_t CTelemetry::mLastPublish = 0;
+uint32_t CTelemetry::mLastFull = 0;
+uint32_t CTelemetry::mLastFailure = 0;
+bool CTelemetry::mFailed = false;
+
+static const char* const FIELD_NAMES[] = { "az_setpoint", "el_setpoint", "az_position", "el_position", "moving" };
+
+// Changes to these fields don't wait for the moving period
+#define IMMEDIATE_FIELDS ((1 << EFieldAzSetpoint) | (1 << EFieldElSetpoint) | (1 << EFieldMoving))
+#define ALL_FIELDS       ((1 << EFieldCount) - 1)
+
+void CTelemetry::begin(publish_t publish)
+{
+  mPublish = publish;
+  mValid = false;
+  mFailed = false;
+}
+
+void CTelemetry::snapshot(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el, int32_t* values)
+{
+  values[EFieldAzSetpoint] = az.setpoint;
+  values[EFieldElSetpoint] = el.setpoint;
+  values[EFieldAzPosition] = az.position;
+  values[EFieldElPosition] = el.position;
+  values[EFieldMoving] = (az.motor_state != CEncoderAxis::EMotorStateStopped ? TELEMETRY_FLAG_AZ_MOVING : 0) |
+                         (el.motor_state != CEncoderAxis::EMotorStateStopped ? TELEMETRY_FLAG_EL_MOVING : 0);
+}
+
+bool CTelemetry::has_event(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el)
+{
+  if (mFailed && millis() - mLastFailure < TELEMETRY_RETRY_PERIOD)
+    return false;
+  if (!mValid)
+    return true;
+
+  int32_t values[EFieldCount];
+  snapshot(az, el, values);
+  for (uint8_t i = 0; i < EFieldCount; i++)
+  {
+    if ((IMMEDIATE_FIELDS & (1 << i)) && values[i] != mPublished[i])
+      return true;
+  }
+  return false;
+}
+
+bool CTelemetry::update(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el)
+{
+  uint32_t now = millis();
+  if (mPublish == NULL || (mFailed && now - mLastFailure < TELEMETRY_RETRY_PERIOD))
+    return false;
+
+  int32_t values[EFieldCount];
+  snapshot(az, el, values);
+
+  uint8_t fields = 0;
+  bool full = !mValid || now - mLastFull >= TELEMETRY_HEARTBEAT_PERIOD;
+  if (full)
+  {
+    fields = ALL_FIELDS;
+  }
+  else
+  {
+    for (uint8_t i = 0; i < EFieldCount; i++)
+    {
+      if (values[i] != mPublished[i])
+        fields |= 1 << i;
+    }
+
+    // Positions alone are rate limited
+    if (fields == 0 || (!(fields & IMMEDIATE_FIELDS) && now - mLastPublish < TELEMETRY_MOVING_PERIOD))
+      return false;
+  }
+
+  char json[TELEMETRY_JSON_SIZE];
+  size_t len = format_json(values, fields, json, sizeof(json));
+  if (!mPublish(reinterpret_cast<const uint8_t*>(json), len, false))
+  {
+    mFailed = true;
+    mLastFailure = now;
+    return false;
+  }
+
+#ifdef USE_TELEMETRY_BINARY
+  uint8_t binary[TELEMETRY_BINARY_SIZE];
+  format_binary(values, now, binary);
+  mPublish(binary, sizeof(binary), true);
+#endif
+
+  memcpy(mPublished, values, sizeof(mPublished));
+  mValid = true;
+  mFailed = false;
+  mLastPublish = now;
+  if (full)
+    mLastFull = now;
+  return true;
+}
+
+size_t CTelemetry::format_json(const int32_t* values, uint8_t fields, char* buf, size_t size)
+{
+  size_t len = 0;
+  for (uint8_t i = 0; i < EFieldCount; i++)
+  {
+    if (!(fields & (1 << i)))
+      continue;
+
+    char value[DECIMAL_STRING_SIZE];
+    if (i == EFieldMoving)
+      strcpy(value, values[i] ? "true" : "false");
+    else
+      CDecimalCodec::format(values[i], 1, value, sizeof(value));
+
+    int written = snprintf(&(buf[len]), size - len, "%s\"%s\": %s", len == 0 ? "{" : ", ", FIELD_NAMES[i], value);
+    if (written < 0 || static_cast<size_t>(written) >= size - len)
+      return 0;
+    len += written;
+  }
+
+  if (len == 0)
+    len = snprintf(buf, size, "{");
+  if (len + 2 > size)
+    return 0;
+  buf[len++] = '}';
+  buf[len] = '\0';
+  return len;
+}
+
+void CTelemetry::format_binary(const int32_t* values, uint32_t time, uint8_t* buf)
+{
+  for (uint8_t i = 0; i < 4; i++)
+    buf[i] = time >> (8 * i);
+  for (uint8_t field = EFieldAzSetpoint; field <= EFieldElPosition; field++)
+  {
+    buf[4 + 2 * field] = values[field];
+    buf[5 + 2 * field] = values[field] >> 8;
+  }
+  buf[12] = values[EFieldMoving];
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "encoder_axis.h"
+
+// Publish timing in ms. Position changes go out at most every
+// TELEMETRY_MOVING_PERIOD; setpoint changes, starts and stops right away; the
+// full state every TELEMETRY_HEARTBEAT_PERIOD. After a failed publish nothing
+// is tried for TELEMETRY_RETRY_PERIOD.
+#define TELEMETRY_MOVING_PERIOD    200
+#define TELEMETRY_HEARTBEAT_PERIOD 30000
+#define TELEMETRY_RETRY_PERIOD     1000
+
+// Fits all fields
+#define TELEMETRY_JSON_SIZE 128
+
+// Binary payload, little endian: uint32 time (ms), int16 az setpoint, el
+// setpoint, az position, el position (1e-1 deg), uint8 flags
+#define TELEMETRY_BINARY_SIZE 13
+#define TELEMETRY_FLAG_AZ_MOVING 0x01
+#define TELEMETRY_FLAG_EL_MOVING 0x02
+
+// Decides when the axis state is worth publishing and formats it. The JSON
+// payload only carries the fields that changed since the last publish, except
+// for the first one and the heartbeat which carry all of them. With
+// -DUSE_TELEMETRY_BINARY every publish is followed by the complete state in the
+// binary layout above.
+class CTelemetry
+{
+public:
+  // Takes a payload for the measurements topic, or for its binary variant.
+  // Returns false when it could not be sent.
+  typedef bool (*publish_t)(const uint8_t* payload, size_t len, bool binary);
+
+  static void begin(publish_t publish);
+
+  // Publish whatever is due, returns whether anything was published
+  static bool update(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el);
+
+  // Whether a change must go out right away. Cheap, meant to trigger the
+  // publishing task from the control loop.
+  static bool has_event(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el);
+
+  // Returns the JSON length, or 0 if the buffer is too small
+  static size_t format_json(const int32_t* values, uint8_t fields, char* buf, size_t size);
+  static void format_binary(const int32_t* values, uint32_t time, uint8_t* buf);
+
+private:
+  enum EField
+  {
+    EFieldAzSetpoint = 0,
+    EFieldElSetpoint = 1,
+    EFieldAzPosition = 2,
+    EFieldElPosition = 3,
+    EFieldMoving     = 4,
+    EFieldCount      = 5,
+  };
+
+  CTelemetry() {}
+  static void snapshot(const CEncoderAxis::SSnapshot& az, const CEncoderAxis::SSnapshot& el, int32_t* values);
+
+  static publish_t mPublish;
+  static int32_t mPublished[EFieldCount];
+  static bool mValid;
+  static uint32_t mLastPublish; // ms
+  static uint32_t mLastFull;    // ms
+  static uint32_t mLastFailure; // ms
+  static bool mFailed;
+};
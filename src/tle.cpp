@@ -0,0 +1,139 @@
+#include "tle.h"
+
+#ifdef USE_SAT_TRACKING
+#include "decimal_codec.h"
+#include <string.h>
+
+#define DEG_TO_RAD_F (static_cast<float>(M_PI) / 180.0f)
+#define MINUTES_PER_DAY 1440.0f
+
+// Columns are 1-based as in the TLE format description
+#define COLUMN(n) ((n) - 1)
+
+bool CTle::parse_line1(const char* line, STleElements& elements, uint32_t& catalog_number)
+{
+  int32_t catalog = 0;
+  int32_t year = 0;
+  int32_t day = 0;
+  int32_t day_fraction = 0;
+  int32_t mantissa = 0;
+  int32_t exponent = 0;
+
+  if (!check_line(line, '1') ||
+      !parse_field(line, 3, 5, 0, catalog) ||
+      !parse_field(line, 19, 2, 0, year) ||
+      !parse_field(line, 21, 3, 0, day) ||
+      line[COLUMN(24)] != '.' ||
+      !parse_field(line, 25, 8, 0, day_fraction) ||
+      !parse_field(line, 55, 5, 0, mantissa) ||
+      !parse_field(line, 60, 2, 0, exponent))
+  {
+    return false;
+  }
+  catalog_number = catalog;
+
+  // Two digit years from 57 are 19xx (the first satellite), others 20xx
+  year += year < 57 ? 2000 : 1900;
+  uint32_t epoch = days_from_civil(year, 1, 1) + day - 1;
+
+  // 8 decimals of a day to ms, without overflowing 32 bits
+  uint32_t ms = static_cast<uint32_t>(day_fraction / 1000) * 864 + static_cast<uint32_t>(day_fraction % 1000) * 864 / 1000;
+  elements.epoch_time = epoch * 86400UL + ms / 1000;
+  elements.epoch_ms = ms % 1000;
+
+  // BSTAR with an implied leading decimal point and a power of ten exponent
+  float bstar = mantissa * 1.0e-5f;
+  for (; exponent < 0; exponent++)
+    bstar *= 0.1f;
+  for (; exponent > 0; exponent--)
+    bstar *= 10.0f;
+  elements.bstar = line[COLUMN(54)] == '-' ? -bstar : bstar;
+  return true;
+}
+
+bool CTle::parse_line2(const char* line, STleElements& elements, uint32_t& catalog_number)
+{
+  int32_t catalog = 0;
+  int32_t eccentricity = 0;
+  int32_t mean_motion = 0;
+  bool ok = check_line(line, '2') && parse_field(line, 3, 5, 0, catalog);
+
+  elements.inclination = parse_angle(line, 9, ok);
+  elements.raan = parse_angle(line, 18, ok);
+  elements.arg_perigee = parse_angle(line, 35, ok);
+  elements.mean_anomaly = parse_angle(line, 44, ok);
+
+  // Eccentricity has an implied leading decimal point
+  ok = ok && parse_field(line, 27, 7, 0, eccentricity);
+  ok = ok && parse_field(line, 53, 11, 8, mean_motion);
+  if (!ok)
+    return false;
+
+  catalog_number = catalog;
+  elements.eccentricity = eccentricity * 1.0e-7f;
+  // rev/day to rad/min
+  elements.mean_motion = mean_motion * 1.0e-8f * 2.0f * static_cast<float>(M_PI) / MINUTES_PER_DAY;
+  return true;
+}
+
+// Line number, length and modulo 10 checksum, where '-' counts as one
+bool CTle::check_line(const char* line, char number)
+{
+  if (strnlen(line, TLE_LINE_LENGTH) < TLE_LINE_LENGTH || line[0] != number || line[1] != ' ')
+    return false;
+
+  uint8_t sum = 0;
+  for (uint8_t i = 0; i < TLE_LINE_LENGTH - 1; i++)
+  {
+    if (line[i] >= '0' && line[i] <= '9')
+      sum += line[i] - '0';
+    else if (line[i] == '-')
+      sum += 1;
+  }
+  return line[TLE_LINE_LENGTH - 1] == '0' + sum % 10;
+}
+
+// Fixed width field, leading spaces allowed
+bool CTle::parse_field(const char* line, uint8_t column, uint8_t width, uint8_t decimals, int32_t& value)
+{
+  char field[DECIMAL_STRING_SIZE];
+  const char* start = &(line[COLUMN(column)]);
+  while (width > 0 && *start == ' ')
+  {
+    start++;
+    width--;
+  }
+  if (width == 0 || width >= sizeof(field))
+    return false;
+
+  memcpy(field, start, width);
+  field[width] = '\0';
+
+  const char* end = NULL;
+  return CDecimalCodec::parse(field, decimals, value, &end) == CDecimalCodec::EResultOk && *end == '\0';
+}
+
+// Angle in degrees with 4 decimals (8 columns) to rad
+float CTle::parse_angle(const char* line, uint8_t column, bool& ok)
+{
+  int32_t value = 0;
+  if (!ok || !parse_field(line, column, 8, 4, value))
+  {
+    ok = false;
+    return 0.0f;
+  }
+  return value * 1.0e-4f * DEG_TO_RAD_F;
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar
+uint32_t CTle::days_from_civil(int32_t year, uint8_t month, uint8_t day)
+{
+  year -= month <= 2;
+  int32_t era = year / 400;
+  uint32_t year_of_era = year - era * 400;
+  uint32_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "sgp4.h"
+
+// Length of a TLE line without line end
+#define TLE_LINE_LENGTH 69
+
+// Parser of the two lines of a NORAD two-line element set. Each line is
+// checked for its length and checksum; the fields of both go into the same
+// elements.
+class CTle
+{
+public:
+  static bool parse_line1(const char* line, STleElements& elements, uint32_t& catalog_number);
+  static bool parse_line2(const char* line, STleElements& elements, uint32_t& catalog_number);
+
+private:
+  CTle() {}
+  static bool check_line(const char* line, char number);
+  static bool parse_field(const char* line, uint8_t column, uint8_t width, uint8_t decimals, int32_t& value);
+  static float parse_angle(const char* line, uint8_t column, bool& ok);
+  static uint32_t days_from_civil(int32_t year, uint8_t month, uint8_t day);
+};
@@ -0,0 +1,139 @@
+#include "Arduino.h"
+#include "trajectory.h"
+
+#ifdef USE_TRAJECTORY
+#include "wall_clock.h"
+
+#define TRAJECTORY_UPDATE_PERIOD 250 // ms
+
+// The axes are fed the position this far ahead, which covers relay and
+// spin-up delay so the antenna is on target instead of trailing behind it
+#define TRAJECTORY_LOOKAHEAD 1000 // ms
+
+CEncoderAxis* CTrajectory::mAzimuthAxis = NULL;
+CEncoderAxis* CTrajectory::mElevationAxis = NULL;
+CTrajectory::SWaypoint CTrajectory::mWaypoints[TRAJECTORY_SIZE];
+uint8_t CTrajectory::mHead = 0;
+uint8_t CTrajectory::mCount = 0;
+uint32_t CTrajectory::mBaseTime = 0;
+uint32_t CTrajectory::mNextUpdateDue = 0;
+int32_t CTrajectory::mAzSetpoint = 0;
+int32_t CTrajectory::mElSetpoint = 0;
+bool CTrajectory::mSetpointFed = false;
+
+void CTrajectory::begin(CEncoderAxis& azimuth_axis, CEncoderAxis& elevation_axis)
+{
+  mAzimuthAxis = &azimuth_axis;
+  mElevationAxis = &elevation_axis;
+}
+
+void CTrajectory::set_base(uint32_t unix_time)
+{
+  clear();
+  mBaseTime = unix_time;
+}
+
+bool CTrajectory::add(int32_t time, int32_t az_position, int32_t el_position)
+{
+  if (mCount == TRAJECTORY_SIZE)
+    return false;
+  if (mCount > 0 && time <= waypoint(mCount - 1).time)
+    return false;
+
+  SWaypoint& point = mWaypoints[(mHead + mCount) % TRAJECTORY_SIZE];
+  point.time = time;
+  point.az_position = az_position;
+  point.el_position = el_position;
+
+  // Feed the new trajectory right away
+  if (mCount == 0)
+    mNextUpdateDue = millis();
+  mCount++;
+  return true;
+}
+
+void CTrajectory::clear()
+{
+  mHead = 0;
+  mCount = 0;
+  mSetpointFed = false;
+}
+
+uint8_t CTrajectory::size()
+{
+  return mCount;
+}
+
+const CTrajectory::SWaypoint& CTrajectory::waypoint(uint8_t index)
+{
+  return mWaypoints[(mHead + index) % TRAJECTORY_SIZE];
+}
+
+// Linear interpolation between the first two waypoints, holding the first or
+// last one outside of them
+void CTrajectory::interpolate(int32_t time, int32_t& az_position, int32_t& el_position)
+{
+  const SWaypoint& from = waypoint(0);
+  if (mCount == 1 || time <= from.time)
+  {
+    az_position = from.az_position;
+    el_position = from.el_position;
+    return;
+  }
+
+  const SWaypoint& to = waypoint(1);
+  if (time >= to.time)
+  {
+    az_position = to.az_position;
+    el_position = to.el_position;
+    return;
+  }
+
+  int32_t span = to.time - from.time;
+  int32_t elapsed = time - from.time;
+  az_position = from.az_position + static_cast<int32_t>(static_cast<int64_t>(to.az_position - from.az_position) * elapsed / span);
+  el_position = from.el_position + static_cast<int32_t>(static_cast<int64_t>(to.el_position - from.el_position) * elapsed / span);
+}
+
+void CTrajectory::update()
+{
+  if (mCount == 0 || !CWallClock::is_set())
+    return;
+
+  // Setpoints are ignored until the position is known
+  if (mAzimuthAxis->is_homing() || mElevationAxis->is_homing())
+    return;
+
+  if (static_cast<int32_t>(millis() - mNextUpdateDue) < 0)
+    return;
+  mNextUpdateDue = millis() + TRAJECTORY_UPDATE_PERIOD;
+
+  int32_t time = CWallClock::ms_since(mBaseTime) + TRAJECTORY_LOOKAHEAD;
+
+  // Waypoints are done with once the next one is reached
+  while (mCount > 1 && waypoint(1).time <= time)
+  {
+    mHead = (mHead + 1) % TRAJECTORY_SIZE;
+    mCount--;
+  }
+
+  int32_t az_position = 0;
+  int32_t el_position = 0;
+  interpolate(time, az_position, el_position);
+
+  // Before the first waypoint this moves the antenna there in advance
+  if (!mSetpointFed || az_position != mAzSetpoint || el_position != mElSetpoint)
+  {
+    mAzimuthAxis->move_to_position(az_position);
+    mElevationAxis->move_to_position(el_position);
+    mAzSetpoint = az_position;
+    mElSetpoint = el_position;
+    mSetpointFed = true;
+  }
+
+  // The last waypoint has been fed, the trajectory is done
+  if (mCount == 1 && time - TRAJECTORY_LOOKAHEAD >= waypoint(0).time)
+    clear();
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "encoder_axis.h"
+
+// Waypoints queued for the axes
+#ifdef ARDUINO_ARCH_AVR
+#define TRAJECTORY_SIZE 16
+#else
+#define TRAJECTORY_SIZE 64
+#endif
+
+// Queue of timestamped az/el waypoints uploaded ahead of time, e.g. a satellite
+// pass. update() interpolates between them on the wall clock and feeds the
+// axes, so tracking doesn't depend on a host sending every setpoint in time.
+// Built with USE_TRAJECTORY.
+class CTrajectory
+{
+public:
+  static void begin(CEncoderAxis& azimuth_axis, CEncoderAxis& elevation_axis);
+
+  // Unix time the waypoint times are relative to, clears the queue
+  static void set_base(uint32_t unix_time);
+
+  // Append a waypoint, time in ms since the base, positions in 1e-1 deg.
+  // Returns false when the queue is full or the time isn't after the last one.
+  static bool add(int32_t time, int32_t az_position, int32_t el_position);
+
+  static void clear();
+  static uint8_t size();
+
+  // Feed the axes, call once per loop iteration
+  static void update();
+
+private:
+  struct SWaypoint
+  {
+    int32_t time;        // ms since mBaseTime
+    int32_t az_position; // 1e-1 deg
+    int32_t el_position; // 1e-1 deg
+  };
+
+  CTrajectory() {}
+  static const SWaypoint& waypoint(uint8_t index);
+  static void interpolate(int32_t time, int32_t& az_position, int32_t& el_position);
+
+  static CEncoderAxis* mAzimuthAxis;
+  static CEncoderAxis* mElevationAxis;
+  static SWaypoint mWaypoints[TRAJECTORY_SIZE];
+  static uint8_t mHead;
+  static uint8_t mCount;
+  static uint32_t mBaseTime;
+  static uint32_t mNextUpdateDue;
+  static int32_t mAzSetpoint;
+  static int32_t mElSetpoint;
+  static bool mSetpointFed;
+};
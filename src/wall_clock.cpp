@@ -0,0 +1,33 @@
+#include "Arduino.h"
+#include "wall_clock.h"
+
+uint32_t CWallClock::mSyncTime = 0;
+uint32_t CWallClock::mSyncMillis = 0;
+bool CWallClock::mSet = false;
+
+void CWallClock::set(uint32_t unix_time, uint16_t ms)
+{
+  mSyncTime = unix_time;
+  mSyncMillis = millis() - ms;
+  mSet = true;
+}
+
+bool CWallClock::is_set()
+{
+  return mSet;
+}
+
+uint32_t CWallClock::now()
+{
+  // Move the sync point along whole seconds so millis() wrapping doesn't matter
+  uint32_t elapsed = millis() - mSyncMillis;
+  mSyncTime += elapsed / 1000;
+  mSyncMillis += elapsed - elapsed % 1000;
+  return mSyncTime;
+}
+
+int32_t CWallClock::ms_since(uint32_t unix_time)
+{
+  uint32_t seconds = now() - unix_time;
+  return static_cast<int32_t>(seconds * 1000 + (millis() - mSyncMillis));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wall clock kept as an offset to millis(). It is set by the host or from NTP,
+// until then is_set() is false.
+class CWallClock
+{
+public:
+  static void set(uint32_t unix_time, uint16_t ms);
+  static bool is_set();
+
+  // Unix time in seconds
+  static uint32_t now();
+
+  // Milliseconds since the given unix time, negative before it. Only valid
+  // within 24 days of it.
+  static int32_t ms_since(uint32_t unix_time);
+
+private:
+  CWallClock() {}
+
+  static uint32_t mSyncTime;   // unix time at mSyncMillis, seconds
+  static uint32_t mSyncMillis; // millis() at the last sync, minus the ms part
+  static bool mSet;
+};
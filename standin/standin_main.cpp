@@ -0,0 +1,245 @@
+// Host stand-in for the network side of the esp8266 firmware: the EasyComm TCP
+// server and the UDP endpoint on localhost, served by the same handlers from
+// axes that stand still. For round trip measurements without the hardware,
+// see tests/test_udp_latency.py. Like WiFiClient by default, the TCP side
+// leaves Nagle's algorithm on.
+//
+// Usage: standin [-p port]
+//   -p  TCP and UDP port, 4533 by default
+
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "easycomm_handler.h"
+#include "easycomm_udp.h"
+#include "encoder_axis.h"
+#include "pins.h"
+#include "sim_hal.h"
+
+#define STANDIN_PORT 4533
+#define STANDIN_MAX_CLIENTS 4
+#define STANDIN_POLL_TIMEOUT 10 // ms
+
+// WiFiClient on a connected socket, as far as handle_commands() uses it
+class CPosixClient
+{
+public:
+  CPosixClient() : mFd(-1), mLen(0), mPos(0) {}
+
+  bool connected() const { return mFd >= 0; }
+
+  int available()
+  {
+    if (mPos == mLen && mFd >= 0)
+    {
+      ssize_t n = recv(mFd, mBuffer, sizeof(mBuffer), MSG_DONTWAIT);
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        stop();
+      mLen = n > 0 ? n : 0;
+      mPos = 0;
+    }
+    return mLen - mPos;
+  }
+
+  int read() { return mPos < mLen ? mBuffer[mPos++] : -1; }
+
+  size_t write(const uint8_t* data, size_t len)
+  {
+    ssize_t n = mFd >= 0 ? send(mFd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL) : -1;
+    return n > 0 ? n : 0;
+  }
+
+  void stop()
+  {
+    if (mFd >= 0)
+      close(mFd);
+    mFd = -1;
+    mLen = 0;
+    mPos = 0;
+  }
+
+  int mFd;
+
+private:
+  uint8_t mBuffer[256];
+  size_t mLen;
+  size_t mPos;
+};
+
+// WiFiUDP on a bound socket, as far as CEasyCommUdp uses it
+class CPosixUdp
+{
+public:
+  CPosixUdp() : mFd(-1), mLen(0), mPos(0), mReplyLen(0) {}
+
+  int parsePacket()
+  {
+    socklen_t size = sizeof(mRemote);
+    ssize_t n = recvfrom(mFd, mBuffer, sizeof(mBuffer), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&mRemote), &size);
+    mLen = n > 0 ? n : 0;
+    mPos = 0;
+    return mLen;
+  }
+
+  int read(uint8_t* data, size_t len)
+  {
+    size_t n = mLen - mPos < len ? mLen - mPos : len;
+    memcpy(data, &(mBuffer[mPos]), n);
+    mPos += n;
+    return n;
+  }
+
+  uint32_t remoteIP() const { return mRemote.sin_addr.s_addr; }
+  uint16_t remotePort() const { return ntohs(mRemote.sin_port); }
+
+  int beginPacket(uint32_t address, uint16_t port)
+  {
+    mDestination.sin_family = AF_INET;
+    mDestination.sin_addr.s_addr = address;
+    mDestination.sin_port = htons(port);
+    mReplyLen = 0;
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t len)
+  {
+    size_t n = sizeof(mReply) - mReplyLen < len ? sizeof(mReply) - mReplyLen : len;
+    memcpy(&(mReply[mReplyLen]), data, n);
+    mReplyLen += n;
+    return n;
+  }
+
+  int endPacket()
+  {
+    return sendto(mFd, mReply, mReplyLen, 0, reinterpret_cast<sockaddr*>(&mDestination), sizeof(mDestination)) >= 0;
+  }
+
+  int mFd;
+
+private:
+  uint8_t mBuffer[UDP_REQUEST_SIZE];
+  size_t mLen;
+  size_t mPos;
+  sockaddr_in mRemote;
+  sockaddr_in mDestination;
+  uint8_t mReply[UDP_REPLY_SIZE];
+  size_t mReplyLen;
+};
+
+static CEncoderAxis   standin_azimuth_axis(ENC_AZ, MOT_AZ_POS, MOT_AZ_NEG);
+static CEncoderAxis standin_elevation_axis(ENC_EL, MOT_EL_POS, MOT_EL_NEG);
+
+static CPosixClient clients[STANDIN_MAX_CLIENTS];
+static CEasyCommSession sessions[STANDIN_MAX_CLIENTS];
+
+static int open_socket(int type, uint16_t port)
+{
+  int fd = socket(AF_INET, type, 0);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      (type == SOCK_STREAM && listen(fd, STANDIN_MAX_CLIENTS) < 0))
+  {
+    perror("bind");
+    exit(1);
+  }
+  return fd;
+}
+
+static void accept_client(int server)
+{
+  int fd = accept(server, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  for (uint8_t i = 0; i < STANDIN_MAX_CLIENTS; i++)
+  {
+    if (!clients[i].connected())
+    {
+      clients[i].mFd = fd;
+      sessions[i].reset();
+      return;
+    }
+  }
+  close(fd);
+}
+
+int main(int argc, char** argv)
+{
+  uint16_t port = STANDIN_PORT;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:")) != -1)
+  {
+    if (opt == 'p')
+    {
+      port = atoi(optarg);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-p port]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  standin_azimuth_axis.begin();
+  standin_elevation_axis.begin();
+  standin_azimuth_axis.set_current_position(1234);
+  standin_elevation_axis.set_current_position(456);
+  CEasyCommHandler::begin(standin_azimuth_axis, standin_elevation_axis);
+
+  int server = open_socket(SOCK_STREAM, port);
+  CPosixUdp udp;
+  udp.mFd = open_socket(SOCK_DGRAM, port);
+  printf("listening on 127.0.0.1:%u, TCP and UDP\n", port);
+  fflush(stdout);
+
+  // Virtual time follows the wall clock, for the push intervals
+  std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+
+  for (;;)
+  {
+    pollfd fds[STANDIN_MAX_CLIENTS + 2];
+    nfds_t count = 0;
+    fds[count++] = { server, POLLIN, 0 };
+    fds[count++] = { udp.mFd, POLLIN, 0 };
+    for (uint8_t i = 0; i < STANDIN_MAX_CLIENTS; i++)
+    {
+      if (clients[i].connected())
+        fds[count++] = { clients[i].mFd, POLLIN, 0 };
+    }
+    poll(fds, count, STANDIN_POLL_TIMEOUT);
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    CSimHal::advance_us(std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+    last = now;
+
+    // One pass of the control and comms tasks
+    CEncoderAxis::SSnapshot azimuth;
+    CEncoderAxis::SSnapshot elevation;
+    standin_azimuth_axis.update();
+    standin_elevation_axis.update();
+    standin_azimuth_axis.get_snapshot(azimuth);
+    standin_elevation_axis.get_snapshot(elevation);
+    CEasyCommHandler::update(azimuth, elevation);
+
+    if (fds[0].revents & POLLIN)
+      accept_client(server);
+    for (uint8_t i = 0; i < STANDIN_MAX_CLIENTS; i++)
+    {
+      if (clients[i].connected())
+        CEasyCommHandler::handle_commands(clients[i], sessions[i]);
+    }
+    CEasyCommUdp::handle_datagrams(udp);
+  }
+}
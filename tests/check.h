@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdio.h>
+
+// Harness of the host tests, each a program of its own: CHECK() reports and
+// counts a failed condition, check_result() prints the summary line that
+// tests/run.sh shows and returns the exit code for main().
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static inline int check_result()
+{
+  printf("%s (%d failures)\n", failures ? "FAIL" : "PASS", failures);
+  return failures ? 1 : 0;
+}
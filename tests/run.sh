@@ -0,0 +1,83 @@
+#!/bin/bash
+# Builds and runs the host tests: every tests/*.cpp with the g++ line in its
+# header, the replay cases in tests/replay/ against their .expected output and
+# the UDP reply checks of test_udp_latency.py against the stand-in. Prints a
+# line per test and exits non-zero when any of them failed to build or pass.
+#
+# Also builds the simulator in the feature configurations native doesn't
+# cover, so code behind a flag keeps compiling without the others.
+#
+# Usage: tests/run.sh [build dir]
+
+cd "$(dirname "$0")/.." || exit 1
+BUILD=${1:-${TMPDIR:-/tmp}/rotator-tests}
+mkdir -p "$BUILD" || exit 1
+
+# As the native environment in platformio.ini
+NATIVE_FLAGS="-O2 -DINTERRUPT_FUNC= -DUSE_PERF_COUNTERS -DUSE_MOTION_TRACE -DUSE_TRAJECTORY -DUSE_SAT_TRACKING -Isim -Isrc"
+NATIVE_SOURCES="$(ls src/*.cpp | grep -v rotator.cpp) $(ls sim/*.cpp | grep -v sim_main.cpp)"
+UDP_TEST_PORT=14533
+
+# Flags of the configurations only built, each next to -DINTERRUPT_FUNC=
+CONFIGURATIONS=(
+  ""                    # as the nano: no trajectories, no satellite tracking
+  "-DUSE_TRAJECTORY"    # trajectories without satellite tracking
+)
+
+failed=0
+
+# Run a built test, its output only shown when it fails
+run()
+{
+  local name=$1
+  shift
+  if "$@" > "$BUILD/$name.log" 2>&1; then
+    printf '%-32s PASS\n' "$name"
+  else
+    cat "$BUILD/$name.log"
+    printf '%-32s FAIL\n' "$name"
+    failed=$((failed + 1))
+  fi
+}
+
+build_failed()
+{
+  printf '%-32s FAIL (build)\n' "$1"
+  failed=$((failed + 1))
+}
+
+for test in tests/*.cpp; do
+  name=$(basename "$test" .cpp)
+  command=$(sed -n 's#^// g++ ##p' "$test" | head -n 1)
+  if g++ -Wall $command -o "$BUILD/$name"; then
+    run "$name" "$BUILD/$name"
+  else
+    build_failed "$name"
+  fi
+done
+
+if g++ $NATIVE_FLAGS -Ireplay $NATIVE_SOURCES replay/*.cpp -o "$BUILD/replay"; then
+  for script in tests/replay/*.txt; do
+    run "replay_$(basename "$script" .txt)" "$BUILD/replay" -q -e "${script%.txt}.expected" "$script"
+  done
+else
+  build_failed replay
+fi
+
+if g++ $NATIVE_FLAGS $NATIVE_SOURCES standin/*.cpp -o "$BUILD/standin"; then
+  run test_udp_latency python3 tests/test_udp_latency.py -s "$BUILD/standin" -p $UDP_TEST_PORT -n 200
+else
+  build_failed standin
+fi
+
+for flags in "${CONFIGURATIONS[@]}"; do
+  name="build ${flags:-without flags}"
+  if g++ -O2 -Wall -DINTERRUPT_FUNC= $flags -Isim -Isrc src/*.cpp sim/*.cpp -o "$BUILD/configuration"; then
+    printf '%-32s PASS\n' "$name"
+  else
+    build_failed "$name"
+  fi
+done
+
+echo "$([ $failed -eq 0 ] && echo PASS || echo FAIL) ($failed failed)"
+[ $failed -eq 0 ]
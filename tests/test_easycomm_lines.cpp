@@ -0,0 +1,112 @@
+// Host test of EasyComm lines with several commands: execution in order,
+// responses aggregated, commands that take the rest of the line, unknown
+// commands in between and position responses kept between polls.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_TRAJECTORY -DUSE_SAT_TRACKING -Isim -Isrc tests/test_easycomm_lines.cpp src/easycomm_handler.cpp src/decimal_codec.cpp src/encoder_axis.cpp src/log.cpp src/motion_trace.cpp src/sat_tracker.cpp src/scheduler.cpp src/tle.cpp src/trajectory.cpp src/wall_clock.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include <string>
+#include "easycomm_handler.h"
+#include "encoder_axis.h"
+#include "trajectory.h"
+#include "check.h"
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+// Stream with the interface handle_commands() uses
+class CTestClient
+{
+public:
+  CTestClient() : mRead(0) {}
+
+  int available() { return mInput.size() - mRead; }
+  char read() { return mInput[mRead++]; }
+  size_t write(const uint8_t* data, size_t len)
+  {
+    mOutput.append(reinterpret_cast<const char*>(data), len);
+    return len;
+  }
+
+  std::string mInput;
+  size_t mRead;
+  std::string mOutput;
+};
+
+static CEasyCommSession session;
+
+static void update_snapshots()
+{
+  CEncoderAxis::SSnapshot azimuth;
+  CEncoderAxis::SSnapshot elevation;
+  azimuth_axis.update();
+  elevation_axis.update();
+  azimuth_axis.get_snapshot(azimuth);
+  elevation_axis.get_snapshot(elevation);
+  CEasyCommHandler::update(azimuth, elevation);
+}
+
+// Send a line, returns what was written back
+static std::string send(const char* line)
+{
+  CTestClient client;
+  client.mInput = line;
+  update_snapshots();
+  CEasyCommHandler::handle_commands(client, session);
+  return client.mOutput;
+}
+
+int main()
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  azimuth_axis.set_current_position(1234);
+  elevation_axis.set_current_position(456);
+  CEasyCommHandler::begin(azimuth_axis, elevation_axis);
+
+  // Single commands answer as before
+  CHECK(send("AZ\n") == "AZ123.4\n");
+  CHECK(send("p\n") == "123.4\n45.6\n");
+
+  // hamlib's query, the trailing separator becomes the line end
+  CHECK(send("AZ EL \n") == "AZ123.4 EL45.6\n");
+  CHECK(send("AZ EL\n") == "AZ123.4 EL45.6\n");
+  CHECK(send("  AZ   EL\r") == "AZ123.4 EL45.6\r");
+
+  // Setpoints of both axes from one line. Queries answer from the snapshots
+  // taken before the line.
+  CHECK(send("AZ100.0 EL20.5 GS\n") == "GS1\n");
+  CHECK(azimuth_axis.get_position_setpoint() == 1000);
+  CHECK(elevation_axis.get_position_setpoint() == 205);
+  CHECK(send("SA SE GS\n") == "GS2\n");
+
+  // Unknown commands are skipped
+  CHECK(send("XY AZ QQ\n") == "AZ123.4\n");
+
+  // P takes the rest of the line, its arguments are separated by spaces
+  CHECK(send("P 12.3 4.5\n") == "RPRT 0\n");
+  CHECK(azimuth_axis.get_position_setpoint() == 123);
+  CHECK(elevation_axis.get_position_setpoint() == 45);
+  CHECK(send("SA SE\n") == "");
+  CHECK(send("p P 1.0 2.0\n") == "123.4\n45.6\nRPRT 0\n");
+
+  // Trajectory commands in order on one line
+  CHECK(send("TB1700000000 TA1.5 10.0 20.0\n") == "RPRT 0\nRPRT 0\n");
+  CHECK(CTrajectory::size() == 1);
+  CHECK(send("TC TQ\n").compare(0, 11, "RPRT 0\nTQ0 ") == 0);
+
+  // Responses of a line go out in one write
+  CHECK(send("VE AZ EL\n") == "PA3RVG Az/El rotor 0.0.1\nAZ123.4 EL45.6\n");
+
+  // Queries answer from the snapshots, the position text follows their
+  // generation
+  azimuth_axis.set_current_position(-50);
+  CHECK(send("AZ EL\n") == "AZ-5.0 EL45.6\n");
+  CHECK(send("p\n") == "-5.0\n45.6\n");
+  azimuth_axis.set_current_position(-50);
+  elevation_axis.set_current_position(900);
+  CHECK(send("AZ EL\n") == "AZ-5.0 EL90.0\n");
+  CHECK(send("p\n") == "-5.0\n90.0\n");
+
+  return check_result();
+}
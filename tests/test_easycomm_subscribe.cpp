@@ -0,0 +1,112 @@
+// Host test of EasyComm position pushes: SU/UN per connection, pushes on
+// moves by the delta and on status changes, the rate limit and defaults.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -Isim -Isrc tests/test_easycomm_subscribe.cpp src/easycomm_handler.cpp src/decimal_codec.cpp src/encoder_axis.cpp src/log.cpp src/motion_trace.cpp src/sat_tracker.cpp src/scheduler.cpp src/tle.cpp src/trajectory.cpp src/wall_clock.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include <string>
+#include "easycomm_handler.h"
+#include "encoder_axis.h"
+#include "check.h"
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+// Stream with the interface handle_commands() uses
+class CTestClient
+{
+public:
+  CTestClient() : mRead(0) {}
+
+  int available() { return mInput.size() - mRead; }
+  char read() { return mInput[mRead++]; }
+  size_t write(const uint8_t* data, size_t len)
+  {
+    mOutput.append(reinterpret_cast<const char*>(data), len);
+    return len;
+  }
+
+  std::string mInput;
+  size_t mRead;
+  std::string mOutput;
+};
+
+static CEasyCommSession session;
+static CEasyCommSession other_session;
+
+// One pass of the control and comms tasks after ms, returns what was written
+static std::string run(uint32_t ms, const char* line = "", CEasyCommSession& on = session)
+{
+  delay(ms);
+  CEncoderAxis::SSnapshot azimuth;
+  CEncoderAxis::SSnapshot elevation;
+  azimuth_axis.get_snapshot(azimuth);
+  elevation_axis.get_snapshot(elevation);
+  CEasyCommHandler::update(azimuth, elevation);
+
+  CTestClient client;
+  client.mInput = line;
+  CEasyCommHandler::handle_commands(client, on);
+  return client.mOutput;
+}
+
+int main()
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  azimuth_axis.set_current_position(1234);
+  elevation_axis.set_current_position(456);
+  CEasyCommHandler::begin(azimuth_axis, elevation_axis);
+
+  // Nothing without a subscription
+  CHECK(run(0) == "");
+
+  // The current state right after subscribing, then only on changes
+  CHECK(run(0, "SU\n") == "RPRT 0\nAZ123.4 EL45.6 GS1\n");
+  CHECK(run(200) == "");
+  CHECK(run(0, "p\n") == "123.4\n45.6\n");
+
+  // Moves of at least the delta, 0.1 deg by default, at most every 100 ms
+  azimuth_axis.set_current_position(1235);
+  CHECK(run(0) == "AZ123.5 EL45.6 GS1\n");
+  azimuth_axis.set_current_position(1236);
+  CHECK(run(50) == "");
+  CHECK(run(50) == "AZ123.6 EL45.6 GS1\n");
+
+  // Other connections aren't subscribed
+  elevation_axis.set_current_position(460);
+  CHECK(run(100, "", other_session) == "");
+  CHECK(run(0) == "AZ123.6 EL46.0 GS1\n");
+
+  // A larger delta and interval
+  CHECK(run(0, "SU1.0 500\n") == "RPRT 0\nAZ123.6 EL46.0 GS1\n");
+  azimuth_axis.set_current_position(1240);
+  CHECK(run(600) == "");
+  azimuth_axis.set_current_position(1246);
+  CHECK(run(0) == "AZ124.6 EL46.0 GS1\n");
+  azimuth_axis.set_current_position(1260);
+  CHECK(run(100) == "");
+  CHECK(run(400) == "AZ126.0 EL46.0 GS1\n");
+
+  // Status changes are pushed whatever the position
+  azimuth_axis.move_positive();
+  azimuth_axis.update();
+  CHECK(run(500) == "AZ126.0 EL46.0 GS2\n");
+  azimuth_axis.stop_moving();
+
+  // Invalid arguments leave the subscription as it was
+  CHECK(run(0, "SU0\n") == "RPRT -1\n");
+  CHECK(run(0, "SUx\n") == "RPRT -1\n");
+  CHECK(run(0, "SU1.0 -5\n") == "RPRT -1\n");
+
+  // No more pushes after UN, nor after the connection was reset
+  CHECK(run(0, "UN\n") == "RPRT 0\n");
+  azimuth_axis.set_current_position(0);
+  CHECK(run(1000) == "");
+  CHECK(run(0, "SU\n").compare(0, 7, "RPRT 0\n") == 0);
+  session.reset();
+  azimuth_axis.set_current_position(100);
+  CHECK(run(1000) == "");
+
+  return check_result();
+}
@@ -0,0 +1,132 @@
+// Host test of the EasyComm UDP endpoint: one reply per datagram, sequence
+// numbers and retransmissions answered from the reply cache per peer.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_TRAJECTORY -DUSE_SAT_TRACKING -Isim -Isrc tests/test_easycomm_udp.cpp src/easycomm_udp.cpp src/easycomm_handler.cpp src/decimal_codec.cpp src/encoder_axis.cpp src/log.cpp src/motion_trace.cpp src/sat_tracker.cpp src/scheduler.cpp src/tle.cpp src/trajectory.cpp src/wall_clock.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "easycomm_handler.h"
+#include "easycomm_udp.h"
+#include "encoder_axis.h"
+#include "trajectory.h"
+#include "check.h"
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+// Datagrams with the interface of WiFiUDP that handle_datagrams() uses
+class CTestUdp
+{
+public:
+  struct SDatagram
+  {
+    uint32_t address;
+    uint16_t port;
+    std::string data;
+  };
+
+  int parsePacket()
+  {
+    if (mInput.empty())
+      return 0;
+    mCurrent = mInput.front();
+    mInput.erase(mInput.begin());
+    return mCurrent.data.size();
+  }
+
+  int read(uint8_t* data, size_t len)
+  {
+    size_t n = mCurrent.data.size() < len ? mCurrent.data.size() : len;
+    memcpy(data, mCurrent.data.data(), n);
+    return n;
+  }
+
+  uint32_t remoteIP() { return mCurrent.address; }
+  uint16_t remotePort() { return mCurrent.port; }
+
+  int beginPacket(uint32_t address, uint16_t port)
+  {
+    SDatagram reply = { address, port, "" };
+    mOutput.push_back(reply);
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t len)
+  {
+    mOutput.back().data.append(reinterpret_cast<const char*>(data), len);
+    return len;
+  }
+
+  int endPacket() { return 1; }
+
+  std::vector<SDatagram> mInput;
+  std::vector<SDatagram> mOutput;
+
+private:
+  SDatagram mCurrent;
+};
+
+static CTestUdp udp;
+
+// Send a datagram, returns the reply or "none"
+static std::string send(const char* data, uint32_t address = 1, uint16_t port = 1000)
+{
+  CTestUdp::SDatagram datagram = { address, port, data };
+  udp.mInput.push_back(datagram);
+  udp.mOutput.clear();
+  CEasyCommUdp::handle_datagrams(udp);
+  if (udp.mOutput.empty())
+    return "none";
+  CHECK(udp.mOutput.size() == 1);
+  CHECK(udp.mOutput[0].address == address && udp.mOutput[0].port == port);
+  return udp.mOutput[0].data;
+}
+
+int main()
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  azimuth_axis.set_current_position(1234);
+  elevation_axis.set_current_position(456);
+  CEasyCommHandler::begin(azimuth_axis, elevation_axis);
+
+  // All responses of a datagram in one reply, with or without a line end
+  CHECK(send("p\n") == "123.4\n45.6\n");
+  CHECK(send("AZ EL") == "AZ123.4 EL45.6\n");
+  CHECK(send("VE\r\nAZ\r\n") == "PA3RVG Az/El rotor 0.0.1\nAZ123.4\r");
+
+  // Without a sequence number nothing answers a setpoint, with one the
+  // sequence number alone does
+  CHECK(send("AZ10.0") == "none");
+  CHECK(send("#1 AZ10.0") == "#1\n");
+  CHECK(send("#2 AZ EL\n") == "#2 AZ123.4 EL45.6\n");
+  CHECK(send("#x p") == "RPRT -1\n");
+  CHECK(send("#-1 p") == "RPRT -1\n");
+  CHECK(send("#+1 p") == "RPRT -1\n");
+  CHECK(send("#12.7 p") == "RPRT -1\n");
+  CHECK(send("#12. p") == "RPRT -1\n");
+  CHECK(send("# p") == "RPRT -1\n");
+  CHECK(send("#99999999999 p") == "RPRT -1\n");
+  CHECK(send("#2147483647 AZ10.0") == "#2147483647\n");
+
+  // A retransmission gets the first reply without running the command again
+  CHECK(send("#3 TB1700000000") == "#3 RPRT 0\n");
+  CHECK(send("#4 TA10.0 1.0 2.0") == "#4 RPRT 0\n");
+  CHECK(send("#4 TA10.0 1.0 2.0") == "#4 RPRT 0\n");
+  CHECK(CTrajectory::size() == 1);
+  CHECK(send("#5 TA10.0 1.0 2.0") == "#5 RPRT -9\n");
+
+  // Sequence numbers are per peer
+  CHECK(send("#5 TA20.0 1.0 2.0", 2) == "#5 RPRT 0\n");
+  CHECK(send("#5 TA20.0 1.0 2.0", 1, 1001) == "#5 RPRT -9\n");
+  CHECK(CTrajectory::size() == 2);
+  CHECK(send("#5 TA10.0 1.0 2.0") == "#5 RPRT -9\n");
+
+  // Only the last request of a peer is kept
+  CHECK(send("#6 TC") == "#6 RPRT 0\n");
+  CHECK(send("#4 TA10.0 1.0 2.0") == "#4 RPRT 0\n");
+  CHECK(CTrajectory::size() == 1);
+
+  return check_result();
+}
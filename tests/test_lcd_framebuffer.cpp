@@ -0,0 +1,100 @@
+// Host test of CLcdFramebuffer: first full redraw spread over budgeted
+// flushes, then only changed cells, with one setCursor per run of cells.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -Isim -Isrc tests/test_lcd_framebuffer.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "lcd_framebuffer.h"
+#include <string>
+#include "check.h"
+
+// Character write cost of a 4 bit HD44780 interface
+#define WRITE_TIME 40
+
+class CFakeDisplay
+{
+public:
+  CFakeDisplay() : col(0), row(0), cursor_moves(0), writes(0)
+  {
+    memset(cells, '?', sizeof(cells));
+  }
+
+  void setCursor(uint8_t c, uint8_t r)
+  {
+    col = c;
+    row = r;
+    cursor_moves++;
+    delayMicroseconds(WRITE_TIME);
+  }
+
+  void write(uint8_t ch)
+  {
+    CHECK(col < 16 && row < 2);
+    cells[row][col++] = ch;
+    writes++;
+    delayMicroseconds(WRITE_TIME);
+  }
+
+  std::string line(uint8_t r) const
+  {
+    return std::string(cells[r], 16);
+  }
+
+  char cells[2][16];
+  uint8_t col;
+  uint8_t row;
+  int cursor_moves;
+  int writes;
+};
+
+int main()
+{
+  CFakeDisplay display;
+  CLcdFramebuffer<CFakeDisplay, 16, 2> buffer(display);
+
+  buffer.set_row(0, "Set A 123 E 45");
+  buffer.set_row(1, "Cur A 120 E 45 and more");
+  CHECK(buffer.is_dirty());
+
+  // The first redraw writes every cell, a few per flush
+  int flushes = 1;
+  while (!buffer.flush(400))
+    flushes++;
+  CHECK(flushes > 3);
+  CHECK(display.writes == 32);
+  CHECK(display.line(0) == "Set A 123 E 45  ");
+  CHECK(display.line(1) == "Cur A 120 E 45 a");
+  CHECK(!buffer.is_dirty());
+
+  // Nothing changed, nothing written
+  display.writes = 0;
+  display.cursor_moves = 0;
+  CHECK(buffer.flush(400));
+  CHECK(display.writes == 0 && display.cursor_moves == 0);
+
+  // Only the changed cells, one cursor move per run
+  buffer.set_row(1, "Cur A 121 E 45");
+  CHECK(buffer.flush(1000));
+  CHECK(display.writes == 2);
+  CHECK(display.cursor_moves == 2);
+  CHECK(display.line(1) == "Cur A 121 E 45  ");
+
+  buffer.set_row(0, "Set A 200 E 10");
+  CHECK(buffer.flush(1000));
+  CHECK(display.writes == 2 + 5);
+  CHECK(display.cursor_moves == 2 + 2);
+
+  // A budget of zero still makes progress
+  buffer.set_row(0, "Set A 201 E 11");
+  CHECK(!buffer.flush(0));
+  CHECK(buffer.flush(0));
+  CHECK(display.line(0) == "Set A 201 E 11  ");
+
+  // After invalidate() everything is sent again
+  buffer.invalidate();
+  display.writes = 0;
+  while (!buffer.flush(1000000)) {}
+  CHECK(display.writes == 32);
+
+  return check_result();
+}
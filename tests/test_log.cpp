@@ -0,0 +1,99 @@
+// Host test of CLog: level stripping, whole lines through the ring, a sink
+// that refuses and drop counting.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -Isim -Isrc tests/test_log.cpp src/log.cpp sim/arduino_hal.cpp
+
+#define LOG_LEVEL LOG_LEVEL_WARN
+#include <Arduino.h>
+#include "log.h"
+#include <string>
+#include "check.h"
+
+static std::string output;
+static size_t sink_space = 0;
+static int sink_calls = 0;
+
+// Takes lines while there is room, like a transmit buffer
+static bool test_sink(const char* line, size_t len)
+{
+  sink_calls++;
+  if (len > sink_space)
+    return false;
+  output.append(line, len);
+  sink_space -= len;
+  return true;
+}
+
+static int evaluated = 0;
+
+static int side_effect()
+{
+  evaluated++;
+  return 0;
+}
+
+int main()
+{
+  // Disabled levels are compiled out, arguments are not evaluated
+  LOG_INFO("info %d", side_effect());
+  LOG_DEBUG("debug %d", side_effect());
+  CHECK(evaluated == 0);
+  CHECK(CLog::get_buffered() == 0);
+
+  // Nothing is lost while there is no sink
+  LOG_WARN("first %d", side_effect() + 1);
+  LOG_ERROR("second");
+  CHECK(evaluated == 1);
+  CLog::drain();
+  CHECK(CLog::get_buffered() == strlen("WRN first 1\r\nERR second\r\n"));
+
+  // A sink without room keeps the lines buffered, one line at a time
+  CLog::set_sink(test_sink);
+  sink_space = 5;
+  CLog::drain();
+  CHECK(output.empty());
+  CHECK(sink_calls == 1);
+
+  sink_space = strlen("WRN first 1\r\n");
+  CLog::drain();
+  CHECK(output == "WRN first 1\r\n");
+
+  sink_space = 1000;
+  CLog::drain();
+  CHECK(output == "WRN first 1\r\nERR second\r\n");
+  CHECK(CLog::get_buffered() == 0);
+
+  // Long messages are cut off but keep their line end
+  output.clear();
+  LOG_WARN("%s", std::string(2 * LOG_LINE_SIZE, 'x').c_str());
+  CLog::drain();
+  CHECK(output.size() == LOG_LINE_SIZE - 1);
+  CHECK(output.compare(0, 4, "WRN ") == 0);
+  CHECK(output.compare(output.size() - 2, 2, "\r\n") == 0);
+
+  // A full buffer drops whole lines and counts them, wrapping keeps lines intact
+  output.clear();
+  sink_space = 0;
+  uint32_t lines = 0;
+  while (CLog::get_dropped() == 0)
+  {
+    LOG_WARN("line %lu", static_cast<unsigned long>(lines));
+    lines++;
+  }
+  LOG_WARN("line %lu", static_cast<unsigned long>(lines));
+  CHECK(CLog::get_dropped() == 2);
+  CHECK(CLog::get_buffered() <= LOG_BUFFER_SIZE);
+
+  sink_space = 100000;
+  CLog::drain();
+  std::string expected;
+  char line[32];
+  for (uint32_t i = 0; i < lines - 1; i++)
+  {
+    snprintf(line, sizeof(line), "WRN line %lu\r\n", static_cast<unsigned long>(i));
+    expected += line;
+  }
+  CHECK(output == expected);
+
+  return check_result();
+}
@@ -0,0 +1,115 @@
+// Host test of CMotionTrace: record layout, wrapping and dumping in pieces
+// while recording goes on.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_MOTION_TRACE -Isim -Isrc tests/test_motion_trace.cpp src/motion_trace.cpp src/encoder_axis.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "motion_trace.h"
+#include <string>
+#include "check.h"
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+static std::string dump(uint32_t& first, uint8_t max_records)
+{
+  char buffer[2 * 8 * TRACE_DUMP_RECORDS + 1];
+  uint8_t count = CMotionTrace::dump(first, max_records, buffer, sizeof(buffer));
+  CHECK(strlen(buffer) == 16u * count);
+  return buffer;
+}
+
+static void test_records()
+{
+  uint32_t start = CMotionTrace::get_sequence();
+  CMotionTrace::record_edge(&azimuth_axis, 0x12345678, -1, -3);
+  CMotionTrace::record_edge(&elevation_axis, 0x100, 1, 400000);
+  CMotionTrace::record(&elevation_axis, CMotionTrace::ETypeSetpoint, 0, 900);
+  CMotionTrace::record(&azimuth_axis, CMotionTrace::ETypeMotor, CEncoderAxis::EMotorStateRunningNeg, 0);
+  CMotionTrace::record_command("AZ12.5\n");
+  CMotionTrace::record_command("p\n");
+  CHECK(CMotionTrace::get_sequence() == start + 6);
+
+  uint32_t first = start;
+  std::string hex = dump(first, 6);
+  CHECK(first == start);
+  // Little endian time, type with the elevation bit, arg, value
+  CHECK(hex.substr(0, 16) == "7856341201fffdff");
+  CHECK(hex.substr(16, 16) == "000100008101ff7f"); // position clamped
+  CHECK(hex.substr(32, 16).substr(8) == "83008403");
+  CHECK(hex.substr(48, 16).substr(8) == "0203" "0000");
+  CHECK(hex.substr(64, 16).substr(8) == "04415a31");
+  CHECK(hex.substr(80, 16).substr(8) == "04700000");
+}
+
+static void test_axis_hooks()
+{
+  azimuth_axis.set_current_position(0);
+  uint32_t first = CMotionTrace::get_sequence();
+  azimuth_axis.move_to_position(100);
+  azimuth_axis.move_to_position(100); // unchanged, not recorded again
+  delay(10);
+  azimuth_axis.enc_interrupt();
+  delay(10);
+  azimuth_axis.update();
+
+  std::string hex = dump(first, 6);
+  CHECK(hex.size() == 3 * 16);
+  CHECK(hex.substr(8, 8) == "03006400");   // setpoint 10.0 deg
+  CHECK(hex.substr(24, 8) == "02010000");  // running positive
+  CHECK(hex.substr(40, 8) == "01010000");  // edge, 0.0375 deg is still 0.0
+}
+
+static void test_wrap_and_follow()
+{
+  // A reader behind by more than the ring size restarts at the oldest record
+  uint32_t reader = CMotionTrace::get_sequence();
+  for (uint32_t i = 0; i < TRACE_SIZE + 10; i++)
+    CMotionTrace::record(&azimuth_axis, CMotionTrace::ETypeSetpoint, 0, i);
+
+  uint32_t first = reader;
+  std::string hex = dump(first, TRACE_DUMP_RECORDS);
+  CHECK(first == CMotionTrace::get_sequence() - TRACE_SIZE);
+  CHECK(hex.substr(8, 8) == "03000a00");
+
+  // Following the trace while recording goes on yields every record once
+  uint32_t next = first + TRACE_DUMP_RECORDS;
+  int32_t expected = 10 + TRACE_DUMP_RECORDS;
+  int32_t value = TRACE_SIZE + 10;
+  bool in_order = true;
+  while (true)
+  {
+    if (value < TRACE_SIZE + 100)
+      CMotionTrace::record(&azimuth_axis, CMotionTrace::ETypeSetpoint, 0, value++);
+    first = next;
+    hex = dump(first, TRACE_DUMP_RECORDS);
+    if (hex.empty())
+      break;
+    in_order = in_order && first == next;
+    for (size_t i = 0; i < hex.size(); i += 16)
+    {
+      int32_t recorded = strtol(hex.substr(i + 14, 2).c_str(), NULL, 16) << 8 | strtol(hex.substr(i + 12, 2).c_str(), NULL, 16);
+      if (recorded != expected)
+        in_order = false;
+      expected++;
+    }
+    next = first + hex.size() / 16;
+  }
+  CHECK(in_order);
+  CHECK(expected == TRACE_SIZE + 100);
+  CHECK(next == CMotionTrace::get_sequence());
+}
+
+int main()
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  CMotionTrace::begin(azimuth_axis, elevation_axis);
+
+  test_records();
+  test_axis_hooks();
+  test_wrap_and_follow();
+
+  return check_result();
+}
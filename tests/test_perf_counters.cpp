@@ -0,0 +1,110 @@
+// Host test of CPerfCounters: loop period bins, command classification and
+// timing, and the per axis interrupt and relay counters.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_PERF_COUNTERS -Isim -Isrc tests/test_perf_counters.cpp src/perf_counters.cpp src/encoder_axis.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "perf_counters.h"
+#include <string>
+#include "check.h"
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+static std::string section(char name)
+{
+  char buffer[128];
+  size_t len = CPerfCounters::format_section(name, buffer, sizeof(buffer));
+  CHECK(len == strlen(buffer));
+  return buffer;
+}
+
+static void test_loop_bins()
+{
+  uint32_t now = micros();
+  CPerfCounters::record_loop(now += 100);   // < 256 us
+  CPerfCounters::record_loop(now += 1000);  // 512..1023 us
+  CPerfCounters::record_loop(now += 1023);
+  CPerfCounters::record_loop(now += 1024);  // 1024..2047 us
+  CPerfCounters::record_loop(now += 50000); // longer than the last bin start
+  CHECK(section('L') == "1,0,2,1,0,0,0,1");
+}
+
+static void test_commands()
+{
+  CHECK(PERF_COMMAND_TYPES[CPerfCounters::command_type("p\n")] == 'p');
+  CHECK(PERF_COMMAND_TYPES[CPerfCounters::command_type("\\get_pos\n")] == 'p');
+  CHECK(PERF_COMMAND_TYPES[CPerfCounters::command_type("\\set_pos 1 2\n")] == 'P');
+  CHECK(PERF_COMMAND_TYPES[CPerfCounters::command_type("AZ\n")] == 'A');
+  CHECK(PERF_COMMAND_TYPES[CPerfCounters::command_type("\\dump_caps\n")] == '?');
+  CHECK(PERF_COMMAND_TYPES[CPerfCounters::command_type("x\n")] == '?');
+
+  CHECK(section('C') == "");
+  CPerfCounters::record_command("p\n", 100);
+  CPerfCounters::record_command("\\get_pos\n", 300);
+  CPerfCounters::record_command("P 1 2\n", 50);
+  CHECK(section('C') == "p:2/200/300 P:1/50/50");
+
+  // Items that don't fit are left out whole
+  char buffer[16];
+  CPerfCounters::format_section('C', buffer, sizeof(buffer));
+  CHECK(std::string(buffer) == "p:2/200/300");
+}
+
+static void test_axes()
+{
+  // The last edge comes within the 2 ms dead time and is rejected
+  delay(10);
+  azimuth_axis.enc_interrupt();
+  delayMicroseconds(3000);
+  azimuth_axis.enc_interrupt();
+  delayMicroseconds(100);
+  azimuth_axis.enc_interrupt();
+
+  CEncoderAxis::SPerfCounters counters;
+  azimuth_axis.get_perf_counters(counters);
+  CHECK(counters.interrupts == 3);
+  CHECK(counters.rejected == 1);
+
+  // A move switches a relay on and off again
+  azimuth_axis.set_current_position(0);
+  azimuth_axis.move_positive();
+  for (int i = 0; i < 10; i++)
+  {
+    azimuth_axis.update();
+    delay(10);
+  }
+  azimuth_axis.stop_moving();
+  for (int i = 0; i < 200; i++)
+  {
+    azimuth_axis.update();
+    delay(10);
+  }
+  azimuth_axis.get_perf_counters(counters);
+  CHECK(counters.relay_transitions == 2);
+  CHECK(section('A') == "az:3/1/2 el:0/0/0");
+
+  char json[512];
+  size_t len = CPerfCounters::format_json(json, sizeof(json));
+  CHECK(len == strlen(json));
+  CHECK(json[0] == '{' && json[len - 1] == '}');
+  CHECK(strstr(json, "\"az\": {\"interrupts\": 3, \"rejected\": 1, \"relay_transitions\": 2}") != NULL);
+
+  // Truncated output stays terminated within the buffer
+  len = CPerfCounters::format_json(json, 40);
+  CHECK(len == 39 && strlen(json) == 39);
+}
+
+int main()
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  CPerfCounters::begin(azimuth_axis, elevation_axis);
+
+  test_loop_bins();
+  test_commands();
+  test_axes();
+
+  return check_result();
+}
@@ -0,0 +1,224 @@
+// Host test of CPositionStore against the simulated flash, including power
+// loss in the middle of writing a record, erases per save, the rest delay and
+// homing aborted before a reboot.
+//
+// g++ -DINTERRUPT_FUNC= -Isim -Isrc tests/test_position_store.cpp src/position_store.cpp src/encoder_axis.cpp src/log.cpp src/motion_trace.cpp sim/arduino_hal.cpp sim/flash_hal.cpp
+
+#include <Arduino.h>
+#include <flash_hal.h>
+#include "encoder_axis.h"
+#include "position_store.h"
+#include "check.h"
+
+// Bytes per record written by CPositionStore, the part covered by the CRC,
+// and records per flash sector
+#define RECORD_SIZE 20
+#define RECORD_CRC_END 14
+#define RECORDS_PER_SECTOR (4096 / RECORD_SIZE)
+
+// Simulate a reboot and return whether a position was restored
+static bool reboot_and_load(int32_t& az, int32_t& el)
+{
+  CSimFlash::set_write_budget(-1);
+  CPositionStore::begin();
+  return CPositionStore::load(az, el);
+}
+
+static void test_empty()
+{
+  int32_t az = 0, el = 0;
+  CSimFlash::erase_all();
+  CHECK(!reboot_and_load(az, el));
+}
+
+static void test_clean_and_dirty()
+{
+  int32_t az = 0, el = 0;
+  CSimFlash::erase_all();
+  CPositionStore::begin();
+
+  CPositionStore::save(1234, -56, true);
+  CHECK(reboot_and_load(az, el));
+  CHECK(az == 1234 && el == -56);
+
+  // Moving when power was lost, position can't be trusted. The record is
+  // invalidated in place.
+  uint32_t writes = CSimFlash::get_write_count();
+  CPositionStore::save(1234, -56, false);
+  CHECK(CSimFlash::get_write_count() - writes == 4);
+  CHECK(!reboot_and_load(az, el));
+
+  CPositionStore::save(3599, 900, true);
+  CHECK(reboot_and_load(az, el));
+  CHECK(az == 3599 && el == 900);
+}
+
+static void test_power_loss(int32_t records_before)
+{
+  // Cut the power after every possible number of written bytes
+  for (int32_t budget = 0; budget <= RECORD_SIZE; budget++)
+  {
+    int32_t az = 0, el = 0;
+    CSimFlash::erase_all();
+    CPositionStore::begin();
+
+    // Fill slots first, so the torn write may start a new sector
+    for (int32_t i = 0; i < records_before; i++)
+      CPositionStore::save(i, -i, true);
+    CPositionStore::save(111, 222, true);
+
+    CSimFlash::set_write_budget(budget);
+    CPositionStore::save(333, 444, true);
+
+    CHECK(reboot_and_load(az, el));
+    if (budget < RECORD_CRC_END)
+      CHECK(az == 111 && el == 222);
+    else
+      CHECK(az == 333 && el == 444);
+
+    // The store keeps working after the power loss, past the torn slot
+    CPositionStore::save(555, 666, true);
+    CHECK(reboot_and_load(az, el));
+    CHECK(az == 555 && el == 666);
+  }
+}
+
+// A sector erase per RECORDS_PER_SECTOR saves, invalidations erase nothing
+static void test_wear_leveling()
+{
+  int32_t az = 0, el = 0;
+  CSimFlash::erase_all();
+  CPositionStore::begin();
+
+  const int32_t saves = 2000;
+  for (int32_t i = 0; i < saves; i++)
+  {
+    CPositionStore::save(i, i, true);
+    CPositionStore::save(i, i, false);
+  }
+  CHECK(CSimFlash::get_erase_count() <= saves / RECORDS_PER_SECTOR + 1);
+
+  CPositionStore::save(saves, saves, true);
+  CHECK(reboot_and_load(az, el));
+  CHECK(az == saves && el == saves);
+}
+
+static void test_sequence_wrap()
+{
+  int32_t az = 0, el = 0;
+  CSimFlash::erase_all();
+  CPositionStore::begin();
+
+  for (int32_t i = 0; i < 70000; i++)
+  {
+    CPositionStore::save(i, 0, true);
+    if (i % 9999 == 0)
+    {
+      CHECK(reboot_and_load(az, el));
+      CHECK(az == i);
+    }
+  }
+  CHECK(reboot_and_load(az, el));
+  CHECK(az == 69999);
+}
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+// Housekeeping runs for a while
+static void run_housekeeping(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; i += 10)
+  {
+    delay(10);
+    azimuth_axis.update();
+    elevation_axis.update();
+    CEncoderAxis::SSnapshot az;
+    CEncoderAxis::SSnapshot el;
+    azimuth_axis.get_snapshot(az);
+    elevation_axis.get_snapshot(el);
+    CPositionStore::update(az, el);
+  }
+}
+
+static void test_homing_aborted()
+{
+  int32_t az = 0, el = 0;
+  CSimFlash::erase_all();
+  CPositionStore::begin();
+  azimuth_axis.begin();
+  elevation_axis.begin();
+
+  // Homed and at rest, the position is stored
+  azimuth_axis.start_homing();
+  elevation_axis.start_homing();
+  run_housekeeping(STORE_REST_DELAY + 2000);
+  CHECK(azimuth_axis.is_calibrated() && elevation_axis.is_calibrated());
+  CHECK(reboot_and_load(az, el));
+  CHECK(az == 0 && el == 0);
+
+  // Homing again and stopped by SA/SE before it finished: at rest, but the
+  // position is unknown, so the next boot homes again
+  azimuth_axis.start_homing();
+  elevation_axis.start_homing();
+  run_housekeeping(100);
+  azimuth_axis.stop_moving();
+  elevation_axis.stop_moving();
+  run_housekeeping(STORE_REST_DELAY + 2000);
+  CHECK(!azimuth_axis.is_calibrated() && !elevation_axis.is_calibrated());
+  CHECK(!reboot_and_load(az, el));
+
+  // Also when the stored record was at rest before
+  azimuth_axis.set_current_position(1200);
+  elevation_axis.set_current_position(300);
+  run_housekeeping(STORE_REST_DELAY + 100);
+  CHECK(reboot_and_load(az, el));
+  CHECK(az == 1200 && el == 300);
+  azimuth_axis.start_homing();
+  run_housekeeping(100);
+  azimuth_axis.stop_moving();
+  run_housekeeping(STORE_REST_DELAY + 2000);
+  CHECK(!reboot_and_load(az, el));
+}
+
+// Short stops, as while tracking, write nothing
+static void test_rest_delay()
+{
+  int32_t az = 0, el = 0;
+  CSimFlash::erase_all();
+  CPositionStore::begin();
+  azimuth_axis.set_current_position(100);
+  elevation_axis.set_current_position(200);
+  run_housekeeping(STORE_REST_DELAY + 100);
+  CHECK(reboot_and_load(az, el));
+
+  uint32_t writes = CSimFlash::get_write_count();
+  for (int i = 0; i < 20; i++)
+  {
+    azimuth_axis.move_positive();
+    run_housekeeping(1000);
+    azimuth_axis.stop_moving();
+    run_housekeeping(STORE_REST_DELAY / 2);
+  }
+  // The record was invalidated once, nothing else written
+  CHECK(CSimFlash::get_write_count() - writes == 4);
+  CHECK(!reboot_and_load(az, el));
+
+  run_housekeeping(STORE_REST_DELAY + 100);
+  CHECK(reboot_and_load(az, el));
+}
+
+int main()
+{
+  test_empty();
+  test_clean_and_dirty();
+  test_power_loss(0);
+  test_power_loss(5);
+  test_power_loss(40);
+  test_wear_leveling();
+  test_sequence_wrap();
+  test_homing_aborted();
+  test_rest_delay();
+
+  return check_result();
+}
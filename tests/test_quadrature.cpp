@@ -0,0 +1,108 @@
+// Host test of the quadrature decoder of CEncoderAxis: counts in both
+// directions whatever the motor does, bounce cancelling out, invalid
+// transitions, exact half counts and the velocity from the edge rate.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DENC_QUADRATURE -Isim -Isrc tests/test_quadrature.cpp src/encoder_axis.cpp src/motion_trace.cpp sim/arduino_hal.cpp
+
+#ifndef ENC_QUADRATURE
+#error build with -DENC_QUADRATURE
+#endif
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "sim_hal.h"
+#include "check.h"
+
+#define PIN_A 4
+#define PIN_B 6
+
+static CEncoderAxis axis(PIN_A, PIN_B, 3, 2);
+
+static void axis_interrupt()
+{
+  axis.enc_interrupt();
+}
+
+static const uint8_t GRAY[4] = { 0, 1, 3, 2 };
+static int32_t encoder_index = 0;
+
+static void set_channels(uint8_t state)
+{
+  CSimHal::set_input(PIN_A, state >> 1);
+  CSimHal::set_input(PIN_B, state & 1);
+}
+
+// Turn the encoder by a number of edges, 1 ms apart
+static void turn(int32_t edges)
+{
+  for (; edges != 0; edges += edges > 0 ? -1 : 1)
+  {
+    encoder_index += edges > 0 ? 1 : -1;
+    CSimHal::advance_us(1000);
+    set_channels(GRAY[encoder_index & 3]);
+  }
+  axis.update();
+}
+
+int main()
+{
+  set_channels(GRAY[0]);
+  axis.begin();
+  attachInterrupt(PIN_A, axis_interrupt, CHANGE);
+  attachInterrupt(PIN_B, axis_interrupt, CHANGE);
+  axis.set_current_position(0);
+
+  // Turned by hand while stopped, both ways. 80 counts per 3 deg.
+  turn(80);
+  CHECK(axis.get_current_position() == 15);
+  turn(-160);
+  CHECK(axis.get_current_position() == -15);
+  CHECK(axis.get_pulse_stats().edges + axis.get_pulse_stats().overflows == 240);
+
+  // Odd counts are rounded, the running total stays exact
+  turn(1);
+  turn(1);
+  turn(1);
+  turn(-2);
+  turn(79);
+  CHECK(axis.get_current_position() == 0);
+
+  // An edge per ms is half a count per ms: 187.5e-4 deg/ms, 18.7 deg/s
+  turn(20);
+  CEncoderAxis::SSnapshot snapshot;
+  axis.get_snapshot(snapshot);
+  CHECK(axis.get_velocity() == 187);
+  CHECK(snapshot.velocity == 187);
+  turn(-20);
+  CHECK(axis.get_velocity() == -187);
+  CHECK(axis.get_current_position() == 0);
+
+  // Bounce on one channel goes back and forth
+  uint8_t state = GRAY[encoder_index & 3];
+  for (int i = 0; i < 5; i++)
+  {
+    set_channels(state ^ 1);
+    set_channels(state);
+  }
+  axis.update();
+  CHECK(axis.get_current_position() == 0);
+
+  // Against the running motor the count still goes the right way
+  axis.move_positive();
+  turn(-80);
+  CHECK(axis.get_current_position() == -15);
+  axis.stop_moving();
+
+  // Both channels changed before the interrupt ran is invalid and counted
+  CHECK(axis.get_pulse_stats().invalid == 0);
+  state = GRAY[encoder_index & 3];
+  encoder_index += 2;
+  detachInterrupt(PIN_A);
+  CSimHal::set_input(PIN_A, !(state >> 1));
+  attachInterrupt(PIN_A, axis_interrupt, CHANGE);
+  CSimHal::set_input(PIN_B, !(state & 1));
+  axis.update();
+  CHECK(axis.get_pulse_stats().invalid == 1);
+
+  return check_result();
+}
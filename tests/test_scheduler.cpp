@@ -0,0 +1,94 @@
+// Host test of CScheduler on the simulated clock: priorities, triggered
+// tasks, skipped releases and overrun counting.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -Isim -Isrc tests/test_scheduler.cpp src/scheduler.cpp src/log.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "scheduler.h"
+#include "sim_hal.h"
+#include <string>
+#include "check.h"
+
+static std::string order;
+static uint32_t slow_runtime = 0;
+static uint8_t control = SCHEDULER_NO_TASK;
+static uint32_t control_latency = 0;
+static uint32_t edge_time = 0;
+
+static void control_task()
+{
+  order += 'c';
+  control_latency = micros() - edge_time;
+}
+
+static void comms_task()
+{
+  order += 'm';
+}
+
+static void display_task()
+{
+  order += 'd';
+  if (slow_runtime > 0)
+  {
+    // An encoder edge while the display is busy
+    edge_time = micros();
+    CScheduler::trigger(control);
+    delayMicroseconds(slow_runtime);
+  }
+}
+
+static void run_for(uint32_t us)
+{
+  uint32_t start = micros();
+  while (micros() - start < us)
+    CScheduler::run();
+}
+
+int main()
+{
+  // Added lowest priority first, so the order isn't the table order
+  uint8_t display = CScheduler::add("display", display_task, 10000, 10000, 3);
+  uint8_t comms = CScheduler::add("comms", comms_task, 2000, 5000, 1);
+  control = CScheduler::add("control", control_task, 0, 2000, 0);
+  CHECK(CScheduler::task_count() == 3);
+
+  // All periodic tasks are released at once, by priority
+  run_for(1);
+  CHECK(order == "md");
+
+  // Periods are kept, idling advances time
+  order.clear();
+  run_for(20000);
+  CHECK(CScheduler::get_stats(comms).runs == 11);
+  CHECK(CScheduler::get_stats(display).runs == 3);
+  CHECK(CScheduler::get_stats(control).runs == 0);
+
+  // A trigger runs the control task right away
+  order.clear();
+  edge_time = micros();
+  CScheduler::trigger(control);
+  CScheduler::run();
+  CHECK(order == "c");
+  CHECK(control_latency == 0);
+
+  // A slow display task delays the control task past its deadline, but it
+  // still runs before the comms task that became due meanwhile
+  slow_runtime = 3000;
+  order.clear();
+  run_for(15000);
+  CHECK(order.find("dcm") != std::string::npos);
+  CHECK(control_latency == 3000);
+  CHECK(CScheduler::get_stats(display).max_runtime == 3000);
+  CHECK(CScheduler::get_stats(control).overruns == 1);
+  CHECK(CScheduler::get_stats(display).overruns == 0);
+
+  // Runs missed while blocked are skipped, not caught up
+  slow_runtime = 0;
+  uint32_t comms_runs = CScheduler::get_stats(comms).runs;
+  delay(50);
+  run_for(1000);
+  CHECK(CScheduler::get_stats(comms).runs == comms_runs + 1);
+
+  return check_result();
+}
@@ -0,0 +1,117 @@
+// Host stress test of CSeqLock with a writer and a reader thread, and of the
+// CEncoderAxis snapshot matching its getters.
+//
+// g++ -O2 -pthread -DINTERRUPT_FUNC= -Isim -Isrc tests/test_seqlock.cpp src/encoder_axis.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "seqlock.h"
+#include "sim_hal.h"
+#include <atomic>
+#include <thread>
+#include "check.h"
+
+#define STRESS_WRITES 2000000UL
+
+// Large enough that copying it is never a single store
+struct SValue
+{
+  uint32_t sequence;
+  uint32_t words[7];
+};
+
+static void test_threads()
+{
+  static CSeqLock<SValue> lock;
+  std::atomic<bool> done(false);
+
+  std::thread writer([&]()
+  {
+    SValue value;
+    for (uint32_t i = 1; i <= STRESS_WRITES; i++)
+    {
+      value.sequence = i;
+      for (int w = 0; w < 7; w++)
+        value.words[w] = i * (w + 1);
+      lock.write(value);
+      if ((i & 0xff) == 0)
+        std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  uint32_t reads = 0;
+  uint32_t last_sequence = 0;
+  bool intact = true;
+  bool monotonic = true;
+
+  for (;;)
+  {
+    bool finished = done;
+    SValue value;
+    lock.read(value);
+    reads++;
+
+    for (int w = 0; w < 7; w++)
+    {
+      if (value.words[w] != value.sequence * (w + 1))
+        intact = false;
+    }
+    if (value.sequence < last_sequence)
+      monotonic = false;
+    last_sequence = value.sequence;
+
+    if (finished)
+      break;
+  }
+  writer.join();
+
+  CHECK(intact);
+  CHECK(monotonic);
+  CHECK(last_sequence == STRESS_WRITES);
+  printf("%lu reads\n", static_cast<unsigned long>(reads));
+}
+
+static void test_axis_snapshot()
+{
+  CEncoderAxis axis(4, 3, 2);
+  axis.begin();
+  axis.set_current_position(100);
+  axis.move_to_position(200);
+
+  CEncoderAxis::SSnapshot snapshot;
+  axis.get_snapshot(snapshot);
+  CHECK(snapshot.position == 100);
+  CHECK(snapshot.setpoint == 200);
+  CHECK(snapshot.motor_state == CEncoderAxis::EMotorStateRunningPos);
+  CHECK(!snapshot.homing);
+
+  // Edges only show up once update() published them
+  for (int i = 0; i < 10; i++)
+  {
+    CSimHal::advance_us(5000);
+    axis.enc_interrupt();
+  }
+  axis.get_snapshot(snapshot);
+  CHECK(snapshot.position == 100);
+
+  axis.update();
+  axis.get_snapshot(snapshot);
+  CHECK(snapshot.position == axis.get_current_position());
+  CHECK(snapshot.position == 103);
+  CHECK(snapshot.last_edge_time == micros());
+  CHECK(snapshot.velocity == 75);
+
+  axis.stop_moving();
+  axis.update();
+  axis.get_snapshot(snapshot);
+  CHECK(snapshot.motor_state == CEncoderAxis::EMotorStateStoppingPos);
+}
+
+int main()
+{
+  test_threads();
+  test_axis_snapshot();
+
+  return check_result();
+}
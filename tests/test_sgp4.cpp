@@ -0,0 +1,193 @@
+// Host accuracy test of the SGP4 propagator: the double model against the
+// Spacetrack Report #3 test case, the float model used on the targets against
+// the double one, and TLE parsing and look angles.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_SAT_TRACKING -Isim -Isrc tests/test_sgp4.cpp src/tle.cpp src/decimal_codec.cpp
+
+#include "observer.h"
+#include "sgp4.h"
+#include "tle.h"
+#include <math.h>
+#include <stdio.h>
+#include "check.h"
+
+// Spacetrack Report #3 test satellite, checksums added
+static const char* STR3_LINE1 = "1 88888U          80275.98708465  .00073094  13844-3  66816-4 0    87";
+static const char* STR3_LINE2 = "2 88888  72.8435 115.9689 0086731  52.6988 110.5714 16.05824518  1058";
+
+struct SReference
+{
+  double tsince; // min
+  double position[3]; // km
+};
+
+// SGP4 results of the report
+static const SReference STR3_REFERENCE[] =
+{
+  {    0.0, { 2328.97048951, -5995.22076416, 1719.97067261 } },
+  {  360.0, { 2456.10705566, -6071.93853760, 1222.89727783 } },
+  {  720.0, { 2567.56195068, -6112.50384522,  713.96397400 } },
+  { 1080.0, { 2663.09078980, -6115.48229980,  196.39640427 } },
+};
+
+static double distance(const double a[3], const double b[3])
+{
+  double dx = a[0] - b[0];
+  double dy = a[1] - b[1];
+  double dz = a[2] - b[2];
+  return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static bool parse(const char* line1, const char* line2, STleElements& elements)
+{
+  uint32_t catalog1 = 0;
+  uint32_t catalog2 = 0;
+  return CTle::parse_line1(line1, elements, catalog1) &&
+         CTle::parse_line2(line2, elements, catalog2) &&
+         catalog1 == catalog2;
+}
+
+static void test_tle()
+{
+  STleElements elements;
+  CHECK(parse(STR3_LINE1, STR3_LINE2, elements));
+
+  // 1980 day 275.98708465 is 1980-10-01 23:41:24.114 UTC
+  CHECK(elements.epoch_time == 339291684UL);
+  CHECK(elements.epoch_ms == 113 || elements.epoch_ms == 114);
+  CHECK(fabs(elements.bstar - 0.66816e-4) < 1e-9);
+  CHECK(fabs(elements.eccentricity - 0.0086731) < 1e-7);
+  CHECK(fabs(elements.inclination * 180.0 / M_PI - 72.8435) < 1e-4);
+  CHECK(fabs(elements.mean_motion * 1440.0 / (2.0 * M_PI) - 16.05824518) < 1e-5);
+
+  // Checksum, length and line number are verified
+  char line[TLE_LINE_LENGTH + 1];
+  uint32_t catalog = 0;
+  snprintf(line, sizeof(line), "%s", STR3_LINE1);
+  line[TLE_LINE_LENGTH - 1] = '0';
+  CHECK(!CTle::parse_line1(line, elements, catalog));
+  CHECK(!CTle::parse_line1("1 88888U", elements, catalog));
+  CHECK(!CTle::parse_line1(STR3_LINE2, elements, catalog));
+}
+
+static void test_reference()
+{
+  STleElements elements;
+  parse(STR3_LINE1, STR3_LINE2, elements);
+
+  CSgp4<double> model;
+  CHECK(model.init(elements));
+
+  double worst = 0.0;
+  for (size_t i = 0; i < sizeof(STR3_REFERENCE) / sizeof(STR3_REFERENCE[0]); i++)
+  {
+    double position[3];
+    double velocity[3];
+    CHECK(model.propagate(STR3_REFERENCE[i].tsince, position, velocity));
+    double error = distance(position, STR3_REFERENCE[i].position);
+    if (error > worst)
+      worst = error;
+  }
+  printf("double vs report: %.3f km\n", worst);
+  // The elements are parsed to float, which alone is a few 100 m after 18 h
+  CHECK(worst < 1.0);
+}
+
+static void test_float()
+{
+  STleElements elements;
+  parse(STR3_LINE1, STR3_LINE2, elements);
+
+  CSgp4<double> reference;
+  CSgp4<float> model;
+  CHECK(reference.init(elements));
+  CHECK(model.init(elements));
+
+  // Pointing from a station in the Netherlands over one day
+  CObserver<double> reference_observer;
+  CObserver<float> observer;
+  reference_observer.set(52.0 * M_PI / 180.0, 5.0 * M_PI / 180.0, 0.01);
+  observer.set(52.0f * static_cast<float>(M_PI) / 180.0f, 5.0f * static_cast<float>(M_PI) / 180.0f, 0.01f);
+
+  double worst_position = 0.0;
+  double worst_angle = 0.0;
+  for (int minute = 0; minute <= 1440; minute += 5)
+  {
+    double position[3];
+    double velocity[3];
+    float float_position[3];
+    float float_velocity[3];
+    CHECK(reference.propagate(minute, position, velocity));
+    CHECK(model.propagate(static_cast<float>(minute), float_position, float_velocity));
+
+    double converted[3] = { float_position[0], float_position[1], float_position[2] };
+    double error = distance(position, converted);
+    if (error > worst_position)
+      worst_position = error;
+
+    uint32_t time = elements.epoch_time + minute * 60;
+    double az = 0.0;
+    double el = 0.0;
+    double range = 0.0;
+    float float_az = 0.0f;
+    float float_el = 0.0f;
+    float float_range = 0.0f;
+    reference_observer.look_angles(position, time, elements.epoch_ms, az, el, range);
+    observer.look_angles(float_position, time, elements.epoch_ms, float_az, float_el, float_range);
+
+    // Only the angles above the horizon matter
+    if (el > 0.0)
+    {
+      double az_error = fabs(az - float_az);
+      if (az_error > M_PI)
+        az_error = 2.0 * M_PI - az_error;
+      double angle = fmax(az_error * cos(el), fabs(el - float_el)) * 180.0 / M_PI;
+      if (angle > worst_angle)
+        worst_angle = angle;
+    }
+  }
+  printf("float vs double: %.3f km, %.4f deg\n", worst_position, worst_angle);
+  CHECK(worst_position < 2.0);
+  CHECK(worst_angle < 0.1);
+}
+
+static void test_gmst()
+{
+  // At J2000 the mean sidereal time is 280.46061837 deg
+  CHECK(fabs(CObserver<double>::gmst(946728000UL, 0) * 180.0 / M_PI - 280.46061837) < 1e-6);
+  // 2024-03-20 00:00 UTC, 11h 52m 04.5s
+  double degrees = CObserver<double>::gmst(1710892800UL, 0) * 180.0 / M_PI;
+  CHECK(fabs(degrees - (11.0 + 52.0 / 60.0 + 4.5 / 3600.0) * 15.0) < 0.01);
+  CHECK(fabs(CObserver<float>::gmst(1710892800UL, 0) * 180.0 / M_PI - degrees) < 0.01);
+}
+
+static void test_look_angles()
+{
+  // Straight above a station on the equator at 0 deg longitude at J2000
+  CObserver<double> observer;
+  observer.set(0.0, -280.46061837 * M_PI / 180.0, 0.0);
+  double position[3] = { 7000.0, 0.0, 0.0 };
+  double az = 0.0;
+  double el = 0.0;
+  double range = 0.0;
+  observer.look_angles(position, 946728000UL, 0, az, el, range);
+  CHECK(fabs(el - M_PI / 2.0) < 1e-6);
+  CHECK(fabs(range - (7000.0 - 6378.135)) < 1e-3);
+
+  // Somewhat north of it the satellite is due north
+  position[2] = 1000.0;
+  observer.look_angles(position, 946728000UL, 0, az, el, range);
+  CHECK(fabs(az) < 1e-6 || fabs(az - 2.0 * M_PI) < 1e-6);
+  CHECK(el > 0.0 && el < M_PI / 2.0);
+}
+
+int main()
+{
+  test_tle();
+  test_reference();
+  test_float();
+  test_gmst();
+  test_look_angles();
+
+  return check_result();
+}
@@ -0,0 +1,149 @@
+// Host stress test of CSpscRing with a producer and a consumer thread, and of
+// CEncoderAxis keeping its position when the encoder event ring overflows and
+// its velocity across micros() wrapping.
+//
+// g++ -O2 -pthread -DINTERRUPT_FUNC= -Isim -Isrc tests/test_spsc_ring.cpp src/encoder_axis.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "sim_hal.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <thread>
+#include "check.h"
+
+#define STRESS_ITEMS 2000000UL
+
+struct SItem
+{
+  uint32_t sequence;
+  uint32_t check;
+};
+
+static void test_threads()
+{
+  static CSpscRing<SItem, 16> ring;
+  std::atomic<bool> done(false);
+  uint32_t pushed = 0;
+  uint32_t rejected = 0;
+
+  std::thread producer([&]()
+  {
+    for (uint32_t i = 0; i < STRESS_ITEMS; i++)
+    {
+      SItem item = { i, ~i };
+      if (ring.push(item))
+      {
+        pushed++;
+      }
+      else
+      {
+        rejected++;
+        std::this_thread::yield();
+      }
+    }
+    done = true;
+  });
+
+  uint32_t popped = 0;
+  uint32_t overflows = 0;
+  uint8_t overflow_seen = 0;
+  uint32_t last_sequence = 0;
+  bool in_order = true;
+  bool intact = true;
+
+  for (;;)
+  {
+    bool finished = done;
+    bool any = false;
+    SItem item;
+    while (ring.pop(item))
+    {
+      any = true;
+      if (popped > 0 && item.sequence <= last_sequence)
+        in_order = false;
+      if (item.check != ~item.sequence)
+        intact = false;
+      last_sequence = item.sequence;
+      popped++;
+    }
+    uint8_t overflow_count = ring.overflow_count();
+    overflows += static_cast<uint8_t>(overflow_count - overflow_seen);
+    overflow_seen = overflow_count;
+    if (finished)
+      break;
+    if (!any)
+      std::this_thread::yield();
+  }
+  producer.join();
+
+  printf("threads: pushed %u, popped %u, overflows %u\n", pushed, popped, overflows);
+  CHECK(in_order);
+  CHECK(intact);
+  CHECK(popped == pushed);
+  CHECK(pushed + rejected == STRESS_ITEMS);
+  CHECK(ring.overflow_count() == static_cast<uint8_t>(rejected));
+  CHECK(overflows % 256 == rejected % 256);
+}
+
+static void test_axis_overflow()
+{
+  CEncoderAxis axis(4, 3, 2);
+  axis.begin();
+  axis.set_current_position(0);
+  axis.move_positive();
+
+  // Many more edges than the ring holds before update() runs
+  const int edges = 100;
+  for (int i = 0; i < edges; i++)
+  {
+    CSimHal::advance_us(5000);
+    axis.enc_interrupt();
+  }
+  axis.update();
+
+  // 100 edges of 0.0375 deg
+  CHECK(axis.get_current_position() == 37);
+  CHECK(axis.get_pulse_stats().overflows == edges - ENC_EVENT_RING_SIZE);
+  CHECK(axis.get_pulse_stats().edges == ENC_EVENT_RING_SIZE);
+
+  // Edges within the dead time are rejected
+  CSimHal::advance_us(5000);
+  axis.enc_interrupt();
+  CSimHal::advance_us(1000);
+  axis.enc_interrupt();
+  axis.update();
+  CHECK(axis.get_pulse_stats().edges == ENC_EVENT_RING_SIZE + 1);
+
+  // 7.5 deg/s with an edge every 5 ms
+  CSimHal::advance_us(4000);
+  axis.enc_interrupt();
+  axis.update();
+  CHECK(axis.get_pulse_stats().last_interval == 5000);
+  CHECK(axis.get_velocity() == 75);
+
+  // Still for 71.6 minutes, until micros() wrapped to 1 ms after the last
+  // edge: the old interval is no speed, nor is the first edge after it
+  CSimHal::advance_us(1000000);
+  axis.update();
+  CHECK(axis.get_velocity() == 0);
+  CSimHal::advance_us(0xFFFFFFFFUL - 1000000 + 1001);
+  axis.update();
+  CHECK(axis.get_velocity() == 0);
+  axis.move_positive();
+  axis.enc_interrupt();
+  axis.update();
+  CHECK(axis.get_velocity() == 0);
+  CSimHal::advance_us(5000);
+  axis.enc_interrupt();
+  axis.update();
+  CHECK(axis.get_velocity() == 75);
+}
+
+int main()
+{
+  test_threads();
+  test_axis_overflow();
+
+  return check_result();
+}
@@ -0,0 +1,131 @@
+// Host test of CTelemetry: full state first, then only changed fields, rate
+// limited positions, immediate setpoint changes and stops, heartbeat, retry
+// back off and the binary layout.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_TELEMETRY_BINARY -Isim -Isrc tests/test_telemetry.cpp src/telemetry.cpp src/decimal_codec.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "telemetry.h"
+#include <string>
+#include <vector>
+#include "check.h"
+
+static std::vector<std::string> published;
+static std::vector<std::string> published_binary;
+static bool accept = true;
+
+static bool test_publish(const uint8_t* payload, size_t len, bool binary)
+{
+  if (!accept)
+    return false;
+  std::string data(reinterpret_cast<const char*>(payload), len);
+  if (binary)
+    published_binary.push_back(data);
+  else
+    published.push_back(data);
+  return true;
+}
+
+static CEncoderAxis::SSnapshot az;
+static CEncoderAxis::SSnapshot el;
+
+// Runs the telemetry like the mqtt task does, returns the JSON payloads
+static std::vector<std::string> run(uint32_t ms)
+{
+  published.clear();
+  for (uint32_t i = 0; i < ms; i += 10)
+  {
+    delay(10);
+    CTelemetry::update(az, el);
+  }
+  return published;
+}
+
+int main()
+{
+  az.position = 1234;
+  az.setpoint = 1234;
+  az.motor_state = CEncoderAxis::EMotorStateStopped;
+  el.position = -5;
+  el.setpoint = 0;
+  el.motor_state = CEncoderAxis::EMotorStateStopped;
+
+  CTelemetry::begin(test_publish);
+  CHECK(CTelemetry::has_event(az, el));
+
+  // Everything at the start, nothing more while idle
+  std::vector<std::string> out = run(1000);
+  CHECK(out.size() == 1);
+  CHECK(out[0] == "{\"az_setpoint\": 123.4, \"el_setpoint\": 0.0, \"az_position\": 123.4, "
+                  "\"el_position\": -0.5, \"moving\": false}");
+  CHECK(!CTelemetry::has_event(az, el));
+
+  // A setpoint change and the start go out right away
+  az.setpoint = 1500;
+  az.motor_state = CEncoderAxis::EMotorStateRunningPos;
+  CHECK(CTelemetry::has_event(az, el));
+  CHECK(CTelemetry::update(az, el));
+  CHECK(published.back() == "{\"az_setpoint\": 150.0, \"moving\": true}");
+
+  // Positions while moving are limited to the moving period
+  published.clear();
+  for (int i = 0; i < 100; i++)
+  {
+    az.position++;
+    CHECK(!CTelemetry::has_event(az, el));
+    delay(10);
+    CTelemetry::update(az, el);
+  }
+  CHECK(published.size() == 1000 / TELEMETRY_MOVING_PERIOD);
+  CHECK(published.back() == "{\"az_position\": 133.4}");
+
+  // The stop doesn't wait
+  az.position++;
+  az.motor_state = CEncoderAxis::EMotorStateStopped;
+  CHECK(CTelemetry::has_event(az, el));
+  CHECK(CTelemetry::update(az, el));
+  CHECK(published.back() == "{\"az_position\": 133.5, \"moving\": false}");
+
+  // Heartbeat with all fields
+  out = run(TELEMETRY_HEARTBEAT_PERIOD);
+  CHECK(out.size() == 1);
+  CHECK(out[0].find("\"el_position\": -0.5") != std::string::npos);
+
+  // Failures back off, then the change is sent once accepted again
+  accept = false;
+  el.setpoint = 450;
+  CHECK(!CTelemetry::update(az, el));
+  CHECK(!CTelemetry::has_event(az, el));
+  accept = true;
+  delay(TELEMETRY_RETRY_PERIOD / 2);
+  CHECK(!CTelemetry::update(az, el));
+  delay(TELEMETRY_RETRY_PERIOD / 2);
+  CHECK(CTelemetry::has_event(az, el));
+  CHECK(CTelemetry::update(az, el));
+  CHECK(published.back() == "{\"el_setpoint\": 45.0}");
+
+#ifdef USE_TELEMETRY_BINARY
+  // Binary payload follows each publish with the complete state
+  CHECK(published_binary.size() == 10);
+  const std::string& binary = published_binary.back();
+  CHECK(binary.size() == TELEMETRY_BINARY_SIZE);
+  uint32_t time = 0;
+  for (int i = 0; i < 4; i++)
+    time |= static_cast<uint32_t>(static_cast<uint8_t>(binary[i])) << (8 * i);
+  CHECK(time == millis());
+  CHECK(static_cast<uint8_t>(binary[4]) == (1500 & 0xff) && static_cast<uint8_t>(binary[5]) == (1500 >> 8));
+  CHECK(static_cast<uint8_t>(binary[6]) == 450 % 256 && binary[7] == 1);
+  CHECK(static_cast<uint8_t>(binary[10]) == 0xfb && static_cast<uint8_t>(binary[11]) == 0xff);
+  CHECK(binary[12] == 0);
+#else
+  CHECK(published_binary.empty());
+#endif
+
+  // Too small a buffer
+  int32_t values[5] = { 0, 0, 0, 0, 0 };
+  char small[16];
+  CHECK(CTelemetry::format_json(values, 0x1f, small, sizeof(small)) == 0);
+  CHECK(CTelemetry::format_json(values, 0, small, sizeof(small)) == 2 && strcmp(small, "{}") == 0);
+
+  return check_result();
+}
@@ -0,0 +1,102 @@
+// Host test of CTrajectory interpolation, lookahead and queue handling on the
+// simulated clock, and of CWallClock.
+//
+// g++ -O2 -DINTERRUPT_FUNC= -DUSE_TRAJECTORY -Isim -Isrc tests/test_trajectory.cpp src/trajectory.cpp src/wall_clock.cpp src/encoder_axis.cpp sim/arduino_hal.cpp
+
+#include <Arduino.h>
+#include "encoder_axis.h"
+#include "sim_hal.h"
+#include "trajectory.h"
+#include "wall_clock.h"
+#include "check.h"
+
+#define BASE_TIME 1700000000UL
+
+static CEncoderAxis azimuth_axis(4, 3, 2);
+static CEncoderAxis elevation_axis(5, 1, 0);
+
+static void run_for(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; i++)
+  {
+    CTrajectory::update();
+    delay(1);
+  }
+}
+
+static void test_wall_clock()
+{
+  CHECK(!CWallClock::is_set());
+  CWallClock::set(BASE_TIME, 500);
+  CHECK(CWallClock::is_set());
+  CHECK(CWallClock::now() == BASE_TIME);
+  CHECK(CWallClock::ms_since(BASE_TIME) == 500);
+
+  delay(1700);
+  CHECK(CWallClock::now() == BASE_TIME + 2);
+  CHECK(CWallClock::ms_since(BASE_TIME) == 2200);
+  CHECK(CWallClock::ms_since(BASE_TIME + 10) == -7800);
+}
+
+static void test_queue()
+{
+  CTrajectory::set_base(BASE_TIME);
+  CHECK(CTrajectory::add(1000, 0, 0));
+  CHECK(!CTrajectory::add(1000, 0, 0));
+  CHECK(!CTrajectory::add(500, 0, 0));
+  for (int32_t i = 1; i < TRAJECTORY_SIZE; i++)
+    CHECK(CTrajectory::add(1000 + i * 1000, 0, 0));
+  CHECK(CTrajectory::size() == TRAJECTORY_SIZE);
+  CHECK(!CTrajectory::add(1000000, 0, 0));
+
+  CTrajectory::set_base(BASE_TIME);
+  CHECK(CTrajectory::size() == 0);
+}
+
+static void test_tracking()
+{
+  // Clock at base + 0 s, a pass from base + 10 s to base + 30 s
+  CWallClock::set(BASE_TIME, 0);
+  CTrajectory::set_base(BASE_TIME);
+  CHECK(CTrajectory::add(10000, 1000, 100));
+  CHECK(CTrajectory::add(20000, 1200, 300));
+  CHECK(CTrajectory::add(30000, 1300, 200));
+
+  // Before the pass the axes move to its start
+  run_for(1);
+  CHECK(azimuth_axis.get_position_setpoint() == 1000);
+  CHECK(elevation_axis.get_position_setpoint() == 100);
+
+  // Half way between the first waypoints, one second of lookahead
+  CWallClock::set(BASE_TIME + 14, 0);
+  run_for(300);
+  CHECK(azimuth_axis.get_position_setpoint() >= 1100 && azimuth_axis.get_position_setpoint() <= 1106);
+  CHECK(elevation_axis.get_position_setpoint() >= 200 && elevation_axis.get_position_setpoint() <= 206);
+  CHECK(CTrajectory::size() == 3);
+
+  // Past the second waypoint it is dropped
+  CWallClock::set(BASE_TIME + 24, 0);
+  run_for(300);
+  CHECK(CTrajectory::size() == 2);
+  CHECK(azimuth_axis.get_position_setpoint() >= 1250 && azimuth_axis.get_position_setpoint() <= 1253);
+
+  // After the end the last waypoint stays and the queue is empty
+  CWallClock::set(BASE_TIME + 31, 0);
+  run_for(300);
+  CHECK(CTrajectory::size() == 0);
+  CHECK(azimuth_axis.get_position_setpoint() == 1300);
+  CHECK(elevation_axis.get_position_setpoint() == 200);
+}
+
+int main()
+{
+  azimuth_axis.begin();
+  elevation_axis.begin();
+  CTrajectory::begin(azimuth_axis, elevation_axis);
+
+  test_wall_clock();
+  test_queue();
+  test_tracking();
+
+  return check_result();
+}
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+# Round trip times of position polls over the EasyComm TCP server and the UDP
+# endpoint, and the UDP reply checks: sequence numbers, aggregated responses
+# and retransmitted requests answered without running them twice.
+#
+# Runs against the host stand-in (pio run -e native_standin, or -s to start
+# it) or, with -H, against the rotator itself.
+
+import argparse
+import socket
+import subprocess
+import sys
+import time
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+def report(name, times):
+    us = [t * 1e6 for t in times]
+    print('%-4s n %5d  p50 %8.1f  p95 %8.1f  p99 %8.1f  max %8.1f us' %
+          (name, len(us), percentile(us, 50), percentile(us, 95), percentile(us, 99), max(us)))
+
+def tcp_round_trips(host, port, count):
+    times = []
+    with socket.create_connection((host, port)) as sock:
+        for _ in range(count):
+            start = time.perf_counter()
+            sock.sendall(b'p\n')
+            reply = b''
+            while reply.count(b'\n') < 2:
+                reply += sock.recv(256)
+            times.append(time.perf_counter() - start)
+    return times
+
+def udp_request(sock, request, timeout=1.0):
+    sock.settimeout(timeout)
+    sock.send(request)
+    return sock.recv(256)
+
+def udp_round_trips(sock, count):
+    times = []
+    for i in range(count):
+        start = time.perf_counter()
+        reply = udp_request(sock, b'#%d p\n' % i)
+        times.append(time.perf_counter() - start)
+        if not reply.startswith(b'#%d ' % i):
+            raise RuntimeError('reply %r out of sequence' % reply)
+    return times
+
+def check(failures, name, value, expected):
+    if value != expected:
+        print('FAIL %s: %r, expected %r' % (name, value, expected))
+        failures.append(name)
+
+def check_replies(sock):
+    failures = []
+    # Both responses in one line, also without a line end in the request
+    reply = udp_request(sock, b'#900001 AZ EL')
+    check(failures, 'aggregated', (reply.split(b' ')[0], reply.count(b' EL'), reply.count(b'\n')), (b'#900001', 1, 1))
+
+    # The same waypoint twice would be out of order, a retransmission isn't
+    udp_request(sock, b'#900002 TB1700000000\n')
+    first = udp_request(sock, b'#900003 TA10.0 1.0 2.0\n')
+    check(failures, 'waypoint', first, b'#900003 RPRT 0\n')
+    check(failures, 'retransmission', udp_request(sock, b'#900003 TA10.0 1.0 2.0\n'), first)
+    check(failures, 'executed once', udp_request(sock, b'#900004 TQ\n').split(b' ')[1], b'TQ1')
+    check(failures, 'new sequence', udp_request(sock, b'#900005 TA10.0 1.0 2.0\n'), b'#900005 RPRT -9\n')
+    check(failures, 'acknowledge', udp_request(sock, b'#900006 TC\n'), b'#900006 RPRT 0\n')
+    check(failures, 'no response', udp_request(sock, b'#900007 AZ123.4\n'), b'#900007\n')
+    check(failures, 'no sequence', udp_request(sock, b'VE'), b'PA3RVG Az/El rotor 0.0.1\n')
+    check(failures, 'fraction', udp_request(sock, b'#12.7 VE\n'), b'RPRT -1\n')
+    return failures
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-H', '--host', default='127.0.0.1')
+    parser.add_argument('-p', '--port', type=int, default=4533)
+    parser.add_argument('-n', '--count', type=int, default=2000)
+    parser.add_argument('-s', '--standin', help='start this stand-in binary first')
+    args = parser.parse_args()
+
+    standin = None
+    if args.standin:
+        standin = subprocess.Popen([args.standin, '-p', str(args.port)], stdout=subprocess.PIPE)
+        standin.stdout.readline()
+
+    try:
+        udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        udp.connect((args.host, args.port))
+        failures = check_replies(udp)
+        report('tcp', tcp_round_trips(args.host, args.port, args.count))
+        report('udp', udp_round_trips(udp, args.count))
+    finally:
+        if standin:
+            standin.terminate()
+            standin.wait()
+
+    print('%s (%d failures)' % ('FAIL' if failures else 'PASS', len(failures)))
+    return 1 if failures else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
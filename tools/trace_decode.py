@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+#
+# Fetch the motion trace of the rotator with DT commands and write it as CSV,
+# or plot it. Reads from TCP, a serial port, or a file of saved DT responses.
+#
+#   trace_decode.py --host rotator.local > trace.csv
+#   trace_decode.py --serial /dev/ttyUSB0 --plot
+#   trace_decode.py --file dump.txt
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+RECORD_SIZE = 8
+TYPE_EDGE = 1
+TYPE_MOTOR = 2
+TYPE_SETPOINT = 3
+TYPE_COMMAND = 4
+TYPE_HOMING = 5
+ELEVATION = 0x80
+
+MOTOR_STATES = {0: 'stopped', 1: 'running_pos', 2: 'stopping_pos', 3: 'running_neg', 4: 'stopping_neg'}
+
+
+class TcpLink:
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+        self.sock.settimeout(1.0)
+        self.buffer = b''
+
+    def command(self, command):
+        self.sock.sendall(("%s\n" % command).encode('ascii'))
+        while b'\n' not in self.buffer:
+            self.buffer += self.sock.recv(1024)
+        line, self.buffer = self.buffer.split(b'\n', 1)
+        return line.decode('ascii').strip()
+
+
+class SerialLink:
+    def __init__(self, device, baud):
+        import serial
+        self.port = serial.Serial(device, baud, timeout=1.0)
+
+    def command(self, command):
+        self.port.write(("%s\n" % command).encode('ascii'))
+        # Log lines may be in between on the nano
+        while True:
+            line = self.port.readline().decode('ascii', 'replace').strip()
+            if not line or line.startswith('DT') or line.startswith('RPRT'):
+                return line
+
+
+def parse_response(line):
+    """Returns the sequence of the first record and the raw records of a DT response."""
+    if not line.startswith('DT'):
+        raise ValueError("not a trace dump: %r" % line)
+    parts = line[2:].split(' ')
+    first = int(parts[0])
+    data = bytes.fromhex(parts[1]) if len(parts) > 1 else b''
+    return first, [data[i:i + RECORD_SIZE] for i in range(0, len(data), RECORD_SIZE)]
+
+
+def fetch(link, follow):
+    """Yields (sequence, raw record) from the oldest record on, reporting gaps."""
+    sequence = 0
+    while True:
+        first, records = parse_response(link.command("DT%d" % sequence))
+        if first != sequence and sequence != 0:
+            print("lost %d records" % (first - sequence), file=sys.stderr)
+        for i, record in enumerate(records):
+            yield first + i, record
+        sequence = first + len(records)
+        if not records:
+            if not follow:
+                return
+            time.sleep(0.5)
+
+
+def read_file(stream):
+    for line in stream:
+        line = line.strip()
+        if line.startswith('DT'):
+            first, records = parse_response(line)
+            for i, record in enumerate(records):
+                yield first + i, record
+
+
+def decode(records):
+    """Yields dicts with the time unwrapped to us since the first record."""
+    start = None
+    last = None
+    elapsed = 0
+    for sequence, raw in records:
+        timestamp, type_axis, arg, value = struct.unpack('<IBBh', raw)
+        if last is None:
+            start = timestamp
+        else:
+            # Edges carry their interrupt time and may be slightly older
+            delta = (timestamp - last) & 0xffffffff
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            elapsed += delta
+        last = timestamp
+
+        event = {
+            'sequence': sequence,
+            'time_us': elapsed,
+            'axis': 'el' if type_axis & ELEVATION else 'az',
+            'event': '',
+            'value': '',
+        }
+        record_type = type_axis & 0x7f
+        if record_type == TYPE_EDGE:
+            direction = struct.unpack('b', bytes([arg]))[0]
+            event['event'] = 'edge%+d' % direction if direction else 'edge'
+            event['value'] = value / 10.0
+        elif record_type == TYPE_MOTOR:
+            event['event'] = MOTOR_STATES.get(arg, 'state%d' % arg)
+        elif record_type == TYPE_SETPOINT:
+            event['event'] = 'setpoint'
+            event['value'] = value / 10.0
+        elif record_type == TYPE_HOMING:
+            event['event'] = 'homing'
+        elif record_type == TYPE_COMMAND:
+            chars = bytes([arg, value & 0xff, (value >> 8) & 0xff]).rstrip(b'\0')
+            event['axis'] = ''
+            event['event'] = 'command'
+            event['value'] = chars.decode('ascii', 'replace')
+        else:
+            event['event'] = 'type%d' % record_type
+        yield event
+
+
+def write_csv(events):
+    print("sequence,time_us,axis,event,value")
+    for e in events:
+        print("%d,%d,%s,%s,%s" % (e['sequence'], e['time_us'], e['axis'], e['event'], e['value']))
+
+
+def plot(events):
+    import matplotlib.pyplot as plt
+
+    events = list(events)
+    fig, axes = plt.subplots(2, 1, sharex=True)
+    for ax, name in zip(axes, ('az', 'el')):
+        edges = [e for e in events if e['axis'] == name and e['event'].startswith('edge')]
+        setpoints = [e for e in events if e['axis'] == name and e['event'] == 'setpoint']
+        ax.plot([e['time_us'] / 1e6 for e in edges], [e['value'] for e in edges], '.-', label='position')
+        if setpoints:
+            ax.step([e['time_us'] / 1e6 for e in setpoints], [e['value'] for e in setpoints],
+                    where='post', label='setpoint')
+        for e in events:
+            if e['axis'] == name and e['event'] in ('running_pos', 'running_neg', 'stopping_pos', 'stopping_neg', 'stopped'):
+                ax.axvline(e['time_us'] / 1e6, color='gray', alpha=0.3)
+        ax.set_ylabel('%s (deg)' % name)
+        ax.legend()
+    for e in events:
+        if e['event'] == 'command':
+            axes[0].annotate(e['value'], (e['time_us'] / 1e6, 1.0), xycoords=('data', 'axes fraction'), fontsize=7)
+    axes[-1].set_xlabel('time (s)')
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fetch and decode the rotator motion trace.')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--host', type=str, help='hostname or ip')
+    source.add_argument('--serial', type=str, help='serial device')
+    source.add_argument('--file', type=str, help='file with DT responses, - for stdin')
+    parser.add_argument('--port', type=int, help='TCP port', default=4533)
+    parser.add_argument('--baud', type=int, help='serial baud rate', default=9600)
+    parser.add_argument('--follow', action='store_true', help='keep fetching new records')
+    parser.add_argument('--plot', action='store_true', help='plot instead of writing CSV')
+    args = parser.parse_args()
+
+    if args.file:
+        stream = sys.stdin if args.file == '-' else open(args.file)
+        records = read_file(stream)
+    elif args.host:
+        records = fetch(TcpLink(args.host, args.port), args.follow)
+    else:
+        records = fetch(SerialLink(args.serial, args.baud), args.follow)
+
+    events = decode(records)
+    if args.plot:
+        plot(events)
+    else:
+        write_csv(events)
+
+
+if __name__ == '__main__':
+    main()